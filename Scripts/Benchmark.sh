@@ -0,0 +1,87 @@
+#!/usr/bin/env bash
+# Headless benchmark: runs the scripted scenarios of UShooterBenchmarkSubsystem in one game process and writes JSON.
+# Given a baseline, exits with status 1 when a metric regressed by more than the tolerance, so CI can fail the build.
+#
+# Usage: Scripts/Benchmark.sh [options]
+#   -s, --scenarios LIST   Scenario[:Count] list, or All (default All)
+#                          EnemiesChasing, AutoFireCrowd, LootField, BarrelField
+#   -f, --frames N         Frames sampled per scenario (default 600)
+#   -w, --warmup N         Frames before sampling starts (default 60)
+#   -m, --map MAP          Map to load (default DefaultMap)
+#   -B, --baseline FILE    Earlier results to compare against
+#   -t, --tolerance PCT    Percent a metric may grow by (default 10)
+#   -b, --binaries DIR     Folder with Shooter (default Binaries/Linux)
+#   -o, --out FILE         Results (default Saved/Benchmarks/<date>.json)
+#   Extra arguments after -- are passed to the game
+
+set -euo pipefail
+
+ProjectDir="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+
+Scenarios=All
+Frames=600
+Warmup=60
+Map=DefaultMap
+Baseline=
+Tolerance=10
+BinariesDir="$ProjectDir/Binaries/Linux"
+Out="$ProjectDir/Saved/Benchmarks/$(date +%Y%m%d-%H%M%S).json"
+GameArgs=()
+
+while [[ $# -gt 0 ]]; do
+	case "$1" in
+		-s|--scenarios) Scenarios="$2"; shift 2 ;;
+		-f|--frames) Frames="$2"; shift 2 ;;
+		-w|--warmup) Warmup="$2"; shift 2 ;;
+		-m|--map) Map="$2"; shift 2 ;;
+		-B|--baseline) Baseline="$2"; shift 2 ;;
+		-t|--tolerance) Tolerance="$2"; shift 2 ;;
+		-b|--binaries) BinariesDir="$2"; shift 2 ;;
+		-o|--out) Out="$2"; shift 2 ;;
+		--) shift; GameArgs=("$@"); break ;;
+		-h|--help) sed -n '2,16p' "$0" | sed 's/^# \{0,1\}//'; exit 0 ;;
+		*) echo "Unknown option $1" >&2; exit 1 ;;
+	esac
+done
+
+Game="$BinariesDir/Shooter"
+
+if [[ ! -x "$Game" ]]; then
+	echo "Missing $Game; build the Shooter target for Linux first" >&2
+	exit 1
+fi
+
+mkdir -p "$(dirname "$Out")"
+
+Args=(
+	"$Map" -nullrhi -nosound -unattended -nosplash
+	-ShooterBenchmark="$Scenarios"
+	-BenchmarkFrames="$Frames"
+	-BenchmarkWarmup="$Warmup"
+	-BenchmarkTolerance="$Tolerance"
+	-BenchmarkOut="$Out"
+	# Same random numbers and frame length on every run, so results compare
+	-ShooterSeed=1
+	-ShooterFixedStep=30
+	-abslog="${Out%.json}.log"
+)
+
+if [[ -n "$Baseline" ]]; then
+	Args+=(-BenchmarkBaseline="$(cd "$(dirname "$Baseline")" && pwd)/$(basename "$Baseline")")
+fi
+
+Status=0
+"$Game" "${Args[@]}" "${GameArgs[@]}" || Status=$?
+
+if [[ -f "$Out" ]]; then
+	echo "Results: $Out"
+else
+	echo "No results written; see ${Out%.json}.log" >&2
+	[[ $Status -ne 0 ]] || Status=1
+fi
+
+if [[ $Status -ne 0 && -n "$Baseline" ]]; then
+	echo "Regressed against $Baseline" >&2
+fi
+
+exit $Status
@@ -0,0 +1,90 @@
+#!/usr/bin/env bash
+# Load test on one Linux machine: one dedicated server and N headless bot clients on localhost.
+# The server samples frame time, bandwidth and hit-validation latency, writes the report and exits.
+#
+# Usage: Scripts/LoadTest.sh [options]
+#   -c, --clients N        Bot clients (default 8)
+#   -s, --seconds S        Seconds sampled once every client connected (default 120)
+#   -w, --warmup S         Seconds after which sampling starts anyway (default 60)
+#   -p, --port P           Server port (default 7777)
+#   -m, --map MAP          Map to load (default DefaultMap)
+#   -b, --binaries DIR     Folder with ShooterServer and Shooter (default Binaries/Linux)
+#   -o, --out DIR          Report and logs (default Saved/LoadTest/<date>)
+#   Extra arguments after -- are passed to the server, like -- -KeepCosmetics
+
+set -euo pipefail
+
+ProjectDir="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+
+Clients=8
+Seconds=120
+Warmup=60
+Port=7777
+Map=DefaultMap
+BinariesDir="$ProjectDir/Binaries/Linux"
+OutDir="$ProjectDir/Saved/LoadTest/$(date +%Y%m%d-%H%M%S)"
+ServerArgs=()
+
+while [[ $# -gt 0 ]]; do
+	case "$1" in
+		-c|--clients) Clients="$2"; shift 2 ;;
+		-s|--seconds) Seconds="$2"; shift 2 ;;
+		-w|--warmup) Warmup="$2"; shift 2 ;;
+		-p|--port) Port="$2"; shift 2 ;;
+		-m|--map) Map="$2"; shift 2 ;;
+		-b|--binaries) BinariesDir="$2"; shift 2 ;;
+		-o|--out) OutDir="$2"; shift 2 ;;
+		--) shift; ServerArgs=("$@"); break ;;
+		-h|--help) sed -n '2,14p' "$0" | sed 's/^# \{0,1\}//'; exit 0 ;;
+		*) echo "Unknown option $1" >&2; exit 1 ;;
+	esac
+done
+
+Server="$BinariesDir/ShooterServer"
+Client="$BinariesDir/Shooter"
+
+for Binary in "$Server" "$Client"; do
+	if [[ ! -x "$Binary" ]]; then
+		echo "Missing $Binary; build the ShooterServer and Shooter targets for Linux first" >&2
+		exit 1
+	fi
+done
+
+mkdir -p "$OutDir"
+Report="$OutDir/report.txt"
+ClientPids=()
+
+StopClients()
+{
+	for Pid in "${ClientPids[@]:-}"; do
+		kill "$Pid" 2>/dev/null || true
+	done
+	wait 2>/dev/null || true
+}
+trap StopClients EXIT
+
+echo "Server on port $Port, $Clients clients, $Seconds s; output in $OutDir"
+
+"$Server" "$Map" -port="$Port" -unattended -nosound -log -abslog="$OutDir/server.log" \
+	-LoadTestReport="$Report" -LoadTestClients="$Clients" -LoadTestSeconds="$Seconds" -LoadTestWarmup="$Warmup" \
+	"${ServerArgs[@]}" > /dev/null 2>&1 &
+ServerPid=$!
+
+# Give the server time to load the map before clients connect
+sleep 5
+
+for ((Index = 0; Index < Clients; Index++)); do
+	"$Client" "127.0.0.1:$Port" -nullrhi -nosound -unattended -LoadTestBot -LoadTestSeed="$Index" \
+		-ExecCmds="t.MaxFPS 30" -log -abslog="$OutDir/client$Index.log" > /dev/null 2>&1 &
+	ClientPids+=($!)
+done
+
+# The server exits by itself once the report is written
+wait "$ServerPid" || true
+
+if [[ -f "$Report" ]]; then
+	cat "$Report"
+else
+	echo "No report; see $OutDir/server.log" >&2
+	exit 1
+fi
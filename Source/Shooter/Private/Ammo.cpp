@@ -14,7 +14,10 @@ AAmmo::AAmmo()
 	SetRootComponent(AmmoMesh);
 
 	GetCollisionBox()->SetupAttachment(GetRootComponent());
-	GetPickupWidget()->SetupAttachment(GetRootComponent());
+	if (GetPickupWidget())
+	{
+		GetPickupWidget()->SetupAttachment(GetRootComponent());
+	}
 	GetAreaSphere()->SetupAttachment(GetRootComponent());
 
 	AmmoCollisionSphere = CreateDefaultSubobject<USphereComponent>(TEXT("AmmoCollisionSphere"));
@@ -86,7 +89,8 @@ void AAmmo::AmmoSphereOverlap(UPrimitiveComponent* OverlappedComponent, AActor*
 	{
 		auto OverlappedCharacter = Cast<AShooterCharacter>(OtherActor);
 
-		if (OverlappedCharacter)
+		// The server picks the ammo up; its position and state replicate to clients
+		if (OverlappedCharacter && HasAuthority())
 		{
 			StartItemCurve(OverlappedCharacter);
 			AmmoCollisionSphere->SetCollisionEnabled(ECollisionEnabled::NoCollision);
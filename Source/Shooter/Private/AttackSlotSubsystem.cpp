@@ -0,0 +1,379 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AttackSlotSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "NavigationSystem.h"
+#include "HAL/IConsoleManager.h"
+#include "../Shooter.h"
+
+DECLARE_CYCLE_STAT(TEXT("Attack Slots Tick"), STAT_AttackSlotsTick, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Attack Slot Queries"), STAT_AttackSlotQueries, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Attack Slot Rings"), STAT_AttackSlotRings, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Assigned Attack Slots"), STAT_AssignedAttackSlots, STATGROUP_Shooter);
+
+static TAutoConsoleVariable<int32> CVarAttackSlotCount(
+	TEXT("Shooter.AttackSlots.Count"),
+	8,
+	TEXT("Slots in the ring around each target."));
+
+static TAutoConsoleVariable<float> CVarAttackSlotRadius(
+	TEXT("Shooter.AttackSlots.Radius"),
+	120.f,
+	TEXT("Distance of the slots from the target. Keep it below the enemies' combat range."));
+
+static TAutoConsoleVariable<float> CVarAttackSlotRate(
+	TEXT("Shooter.AttackSlots.Rate"),
+	5.f,
+	TEXT("Slot assignments per second."));
+
+static TAutoConsoleVariable<int32> CVarAttackSlotQueriesPerFrame(
+	TEXT("Shooter.AttackSlots.QueriesPerFrame"),
+	16,
+	TEXT("Slots checked against the navmesh and traced per frame."));
+
+static TAutoConsoleVariable<float> CVarAttackSlotMoveDistance(
+	TEXT("Shooter.AttackSlots.MoveDistance"),
+	100.f,
+	TEXT("Distance the target moves before its ring is placed and scored again."));
+
+namespace
+{
+	/** Requests not renewed for this long are dropped; long enough to hold the slot through an attack */
+	constexpr float RequestTimeout{ 2.f };
+
+	/** Vertical extent of the navmesh check of a slot */
+	constexpr float SlotProjectionHeight{ 150.f };
+}
+
+void UAttackSlotSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	SlotTraceDelegate.BindUObject(this, &UAttackSlotSubsystem::OnSlotTraceDone);
+}
+
+void UAttackSlotSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AttackSlotsTick);
+
+	if (Requests.Num() == 0 && Rings.Num() == 0)
+	{
+		return;
+	}
+
+	UpdateRings();
+	ScoreSlots();
+
+	const float Rate{ CVarAttackSlotRate.GetValueOnGameThread() };
+
+	TimeSinceAssign += DeltaTime;
+
+	if (Rate <= 0.f || TimeSinceAssign >= 1.f / Rate)
+	{
+		TimeSinceAssign = 0.f;
+		AssignSlots();
+	}
+}
+
+TStatId UAttackSlotSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAttackSlotSubsystem, STATGROUP_Tickables);
+}
+
+bool UAttackSlotSubsystem::RequestSlot(APawn* Pawn, AActor* Target, FVector& OutLocation)
+{
+	if (Pawn == nullptr || Target == nullptr)
+	{
+		return false;
+	}
+
+	FAttackSlotRequest& Request{ Requests.FindOrAdd(Pawn) };
+
+	// Switching targets gives up the old slot at the next assignment
+	Request.Target = Target;
+	Request.LastRequestTime = GetWorld()->GetTimeSeconds();
+
+	const FAttackRing* Ring{ FindRing(Target) };
+
+	if (Ring == nullptr)
+	{
+		return false;
+	}
+
+	for (const FAttackSlot& Slot : Ring->Slots)
+	{
+		if (Slot.bValid && Slot.Occupant == Pawn)
+		{
+			OutLocation = Slot.Location;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void UAttackSlotSubsystem::ReleaseSlot(APawn* Pawn)
+{
+	const FAttackSlotRequest* Request{ Requests.Find(Pawn) };
+
+	if (Request == nullptr)
+	{
+		return;
+	}
+
+	if (FAttackRing* Ring = FindRing(Request->Target.Get()))
+	{
+		for (FAttackSlot& Slot : Ring->Slots)
+		{
+			if (Slot.Occupant == Pawn)
+			{
+				Slot.Occupant = nullptr;
+			}
+		}
+	}
+
+	Requests.Remove(Pawn);
+}
+
+void UAttackSlotSubsystem::UpdateRings()
+{
+	const float Now{ GetWorld()->GetTimeSeconds() };
+
+	for (auto It = Requests.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid() || !It.Value().Target.IsValid() || Now - It.Value().LastRequestTime > RequestTimeout)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	// Rings nobody asks for any more
+	Rings.RemoveAllSwap([this](const FAttackRing& Ring)
+		{
+			if (!Ring.Target.IsValid())
+			{
+				return true;
+			}
+
+			for (const auto& Request : Requests)
+			{
+				if (Request.Value.Target == Ring.Target)
+				{
+					return false;
+				}
+			}
+
+			return true;
+		});
+
+	for (const auto& Request : Requests)
+	{
+		if (FindRing(Request.Value.Target.Get()) == nullptr)
+		{
+			FAttackRing& Ring{ Rings.AddDefaulted_GetRef() };
+			Ring.Target = Request.Value.Target;
+
+			PlaceSlots(Ring, Ring.Target->GetActorLocation());
+		}
+	}
+
+	const float MoveDistanceSquared{ FMath::Square(CVarAttackSlotMoveDistance.GetValueOnGameThread()) };
+	const int32 NumSlots{ FMath::Max(CVarAttackSlotCount.GetValueOnGameThread(), 1) };
+
+	for (FAttackRing& Ring : Rings)
+	{
+		const FVector TargetLocation{ Ring.Target->GetActorLocation() };
+
+		if (Ring.Slots.Num() != NumSlots || FVector::DistSquared(Ring.Center, TargetLocation) > MoveDistanceSquared)
+		{
+			PlaceSlots(Ring, TargetLocation);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_AttackSlotRings, Rings.Num());
+}
+
+void UAttackSlotSubsystem::PlaceSlots(FAttackRing& Ring, const FVector& Center) const
+{
+	const int32 NumSlots{ FMath::Max(CVarAttackSlotCount.GetValueOnGameThread(), 1) };
+	const float Radius{ CVarAttackSlotRadius.GetValueOnGameThread() };
+
+	// Occupants keep the slot with the same index, so enemies do not swap places as the target moves
+	TArray<TWeakObjectPtr<APawn>> Occupants;
+	for (const FAttackSlot& Slot : Ring.Slots)
+	{
+		Occupants.Add(Slot.Occupant);
+	}
+
+	Ring.Center = Center;
+	Ring.Slots.SetNum(NumSlots);
+
+	for (int32 i = 0; i < NumSlots; i++)
+	{
+		const float Angle{ 2.f * PI * i / NumSlots };
+
+		FAttackSlot& Slot{ Ring.Slots[i] };
+		Slot.Location = Center + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.f) * Radius;
+		Slot.bScored = false;
+		Slot.Occupant = Occupants.IsValidIndex(i) ? Occupants[i] : nullptr;
+	}
+}
+
+void UAttackSlotSubsystem::ScoreSlots()
+{
+	UNavigationSystemV1* NavSys{ FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()) };
+
+	int32 Budget{ CVarAttackSlotQueriesPerFrame.GetValueOnGameThread() };
+
+	for (FAttackRing& Ring : Rings)
+	{
+		AActor* Target{ Ring.Target.Get() };
+
+		for (int32 i = 0; i < Ring.Slots.Num() && Budget > 0; i++)
+		{
+			FAttackSlot& Slot{ Ring.Slots[i] };
+
+			if (Slot.bScored)
+			{
+				continue;
+			}
+
+			// Marked scored now so the slot is not queried again while its trace is in flight.
+			// It keeps its last validity until the trace is back, so its occupant is not dropped meanwhile
+			Slot.bScored = true;
+			Budget--;
+			INC_DWORD_STAT(STAT_AttackSlotQueries);
+
+			FNavLocation NavLocation;
+			const FVector Extent{ CVarAttackSlotRadius.GetValueOnGameThread() * .5f, CVarAttackSlotRadius.GetValueOnGameThread() * .5f, SlotProjectionHeight };
+
+			if (NavSys == nullptr || !NavSys->ProjectPointToNavigation(Slot.Location, NavLocation, Extent))
+			{
+				Slot.bValid = false;
+				continue;
+			}
+
+			Slot.Location = NavLocation.Location;
+
+			// The slot is only valid once the trace finds a clear line from the target
+			FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(AttackSlot), false, Target);
+
+			const uint32 TraceId{ NextSlotTraceId++ };
+			GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, Ring.Center, Slot.Location + FVector(0.f, 0.f, SlotProjectionHeight * .5f),
+				ECollisionChannel::ECC_Visibility, QueryParams, FCollisionResponseParams::DefaultResponseParam, &SlotTraceDelegate, TraceId);
+
+			PendingSlotTraces.Add(TraceId, { Ring.Target, i, Slot.Location });
+		}
+	}
+}
+
+void UAttackSlotSubsystem::OnSlotTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum)
+{
+	FPendingSlotTrace SlotTrace;
+	if (!PendingSlotTraces.RemoveAndCopyValue(Datum.UserData, SlotTrace))
+	{
+		return;
+	}
+
+	FAttackRing* Ring{ FindRing(SlotTrace.Target.Get()) };
+
+	// The ring may have moved on since the trace started
+	if (Ring == nullptr || !Ring->Slots.IsValidIndex(SlotTrace.SlotIndex) || !Ring->Slots[SlotTrace.SlotIndex].Location.Equals(SlotTrace.Location))
+	{
+		return;
+	}
+
+	Ring->Slots[SlotTrace.SlotIndex].bValid = FHitResult::GetFirstBlockingHit(Datum.OutHits) == nullptr;
+}
+
+void UAttackSlotSubsystem::AssignSlots()
+{
+	int32 NumAssigned{ 0 };
+
+	for (FAttackRing& Ring : Rings)
+	{
+		// Enemies asking for this ring, nearest to the target first
+		TArray<APawn*> Attackers;
+		for (const auto& Request : Requests)
+		{
+			if (Request.Value.Target == Ring.Target)
+			{
+				Attackers.Add(Request.Key.Get());
+			}
+		}
+
+		const FVector Center{ Ring.Center };
+		Attackers.Sort([Center](const APawn& A, const APawn& B)
+			{
+				return FVector::DistSquared(A.GetActorLocation(), Center) < FVector::DistSquared(B.GetActorLocation(), Center);
+			});
+
+		// Keep occupants still asking for a valid slot; free the rest
+		TArray<APawn*> Unassigned;
+		for (FAttackSlot& Slot : Ring.Slots)
+		{
+			if (!Slot.bValid || !Attackers.Contains(Slot.Occupant.Get()))
+			{
+				Slot.Occupant = nullptr;
+			}
+		}
+
+		for (APawn* Attacker : Attackers)
+		{
+			const bool bHasSlot = Ring.Slots.ContainsByPredicate([Attacker](const FAttackSlot& Slot) { return Slot.Occupant == Attacker; });
+
+			if (!bHasSlot)
+			{
+				Unassigned.Add(Attacker);
+			}
+		}
+
+		// Nearest free slot for each enemy in turn; enemies left over wait behind the others
+		for (APawn* Attacker : Unassigned)
+		{
+			int32 BestSlot{ INDEX_NONE };
+			float BestDistanceSquared{ MAX_flt };
+
+			for (int32 i = 0; i < Ring.Slots.Num(); i++)
+			{
+				const FAttackSlot& Slot{ Ring.Slots[i] };
+				const float DistanceSquared{ FVector::DistSquared(Attacker->GetActorLocation(), Slot.Location) };
+
+				if (Slot.bValid && !Slot.Occupant.IsValid() && DistanceSquared < BestDistanceSquared)
+				{
+					BestSlot = i;
+					BestDistanceSquared = DistanceSquared;
+				}
+			}
+
+			if (BestSlot == INDEX_NONE)
+			{
+				break;
+			}
+
+			Ring.Slots[BestSlot].Occupant = Attacker;
+		}
+
+		for (const FAttackSlot& Slot : Ring.Slots)
+		{
+			if (Slot.Occupant.IsValid())
+			{
+				NumAssigned++;
+			}
+		}
+	}
+
+	SET_DWORD_STAT(STAT_AssignedAttackSlots, NumAssigned);
+}
+
+FAttackRing* UAttackSlotSubsystem::FindRing(const AActor* Target)
+{
+	if (Target == nullptr)
+	{
+		return nullptr;
+	}
+
+	return Rings.FindByPredicate([Target](const FAttackRing& Ring) { return Ring.Target.Get() == Target; });
+}
@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BTService_GruxCombat.h"
+#include "AIController.h"
+#include "BehaviorTree/BehaviorTree.h"
+#include "BehaviorTree/BehaviorTreeComponent.h"
+#include "BehaviorTree/Blackboard/BlackboardKeyType_Bool.h"
+#include "BehaviorTree/Blackboard/BlackboardKeyType_Object.h"
+
+UBTService_GruxCombat::UBTService_GruxCombat()
+{
+	NodeName = TEXT("Grux Combat");
+
+	// Everything happens in the blackboard observers
+	bNotifyTick = false;
+	bNotifyOnSearch = false;
+	bNotifyBecomeRelevant = true;
+	bNotifyCeaseRelevant = true;
+
+	TargetKey.SelectedKeyName = TEXT("Target");
+	TargetKey.AddObjectFilter(this, GET_MEMBER_NAME_CHECKED(UBTService_GruxCombat, TargetKey), AActor::StaticClass());
+
+	StunnedKey.SelectedKeyName = TEXT("Stunned");
+	StunnedKey.AddBoolFilter(this, GET_MEMBER_NAME_CHECKED(UBTService_GruxCombat, StunnedKey));
+
+	DeadKey.SelectedKeyName = TEXT("Dead");
+	DeadKey.AddBoolFilter(this, GET_MEMBER_NAME_CHECKED(UBTService_GruxCombat, DeadKey));
+}
+
+void UBTService_GruxCombat::InitializeFromAsset(UBehaviorTree& Asset)
+{
+	Super::InitializeFromAsset(Asset);
+
+	if (UBlackboardData* BlackboardAsset = GetBlackboardAsset())
+	{
+		TargetKey.ResolveSelectedKey(*BlackboardAsset);
+		StunnedKey.ResolveSelectedKey(*BlackboardAsset);
+		DeadKey.ResolveSelectedKey(*BlackboardAsset);
+	}
+}
+
+void UBTService_GruxCombat::OnBecomeRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	Super::OnBecomeRelevant(OwnerComp, NodeMemory);
+
+	UBlackboardComponent* Blackboard{ OwnerComp.GetBlackboardComponent() };
+
+	if (Blackboard == nullptr)
+	{
+		return;
+	}
+
+	for (const FBlackboardKeySelector* Key : { &TargetKey, &StunnedKey, &DeadKey })
+	{
+		Blackboard->RegisterObserver(Key->GetSelectedKeyID(), this,
+			FOnBlackboardChangeNotification::CreateUObject(this, &UBTService_GruxCombat::OnBlackboardKeyChanged));
+	}
+
+	UpdateFocus(*Blackboard);
+}
+
+void UBTService_GruxCombat::OnCeaseRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	if (UBlackboardComponent* Blackboard = OwnerComp.GetBlackboardComponent())
+	{
+		Blackboard->UnregisterObserversFrom(this);
+	}
+
+	if (AAIController* AIController = OwnerComp.GetAIOwner())
+	{
+		AIController->ClearFocus(EAIFocusPriority::Gameplay);
+	}
+
+	Super::OnCeaseRelevant(OwnerComp, NodeMemory);
+}
+
+EBlackboardNotificationResult UBTService_GruxCombat::OnBlackboardKeyChanged(const UBlackboardComponent& Blackboard, FBlackboard::FKey ChangedKeyID)
+{
+	if (Blackboard.GetBrainComponent() == nullptr)
+	{
+		return EBlackboardNotificationResult::RemoveObserver;
+	}
+
+	UpdateFocus(Blackboard);
+
+	return EBlackboardNotificationResult::ContinueObserving;
+}
+
+void UBTService_GruxCombat::UpdateFocus(const UBlackboardComponent& Blackboard) const
+{
+	AAIController* AIController{ Blackboard.GetBrainComponent() ? Blackboard.GetBrainComponent()->GetAIOwner() : nullptr };
+
+	if (AIController == nullptr)
+	{
+		return;
+	}
+
+	const bool bStunned{ Blackboard.GetValue<UBlackboardKeyType_Bool>(StunnedKey.GetSelectedKeyID()) };
+	const bool bDead{ Blackboard.GetValue<UBlackboardKeyType_Bool>(DeadKey.GetSelectedKeyID()) };
+	AActor* Target{ Cast<AActor>(Blackboard.GetValue<UBlackboardKeyType_Object>(TargetKey.GetSelectedKeyID())) };
+
+	if (bStunned || bDead)
+	{
+		AIController->StopMovement();
+		AIController->ClearFocus(EAIFocusPriority::Gameplay);
+	}
+	else if (Target)
+	{
+		AIController->SetFocus(Target);
+	}
+	else
+	{
+		AIController->ClearFocus(EAIFocusPriority::Gameplay);
+	}
+}
@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BTTask_GruxAttack.h"
+#include "AIController.h"
+#include "BehaviorTree/BlackboardComponent.h"
+#include "BehaviorTree/BehaviorTree.h"
+#include "BehaviorTree/Blackboard/BlackboardKeyType_Bool.h"
+#include "Enemy.h"
+
+UBTTask_GruxAttack::UBTTask_GruxAttack() :
+	PlayRate(1.f)
+{
+	NodeName = TEXT("Grux Attack");
+
+	InAttackRangeKey.SelectedKeyName = TEXT("InAttackRange");
+	InAttackRangeKey.AddBoolFilter(this, GET_MEMBER_NAME_CHECKED(UBTTask_GruxAttack, InAttackRangeKey));
+
+	CanAttackKey.SelectedKeyName = TEXT("CanAttack");
+	CanAttackKey.AddBoolFilter(this, GET_MEMBER_NAME_CHECKED(UBTTask_GruxAttack, CanAttackKey));
+}
+
+void UBTTask_GruxAttack::InitializeFromAsset(UBehaviorTree& Asset)
+{
+	Super::InitializeFromAsset(Asset);
+
+	if (UBlackboardData* BlackboardAsset = GetBlackboardAsset())
+	{
+		InAttackRangeKey.ResolveSelectedKey(*BlackboardAsset);
+		CanAttackKey.ResolveSelectedKey(*BlackboardAsset);
+	}
+}
+
+EBTNodeResult::Type UBTTask_GruxAttack::ExecuteTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	AAIController* AIController{ OwnerComp.GetAIOwner() };
+	const UBlackboardComponent* Blackboard{ OwnerComp.GetBlackboardComponent() };
+	AEnemy* Enemy{ AIController ? Cast<AEnemy>(AIController->GetPawn()) : nullptr };
+
+	if (Enemy == nullptr || Blackboard == nullptr)
+	{
+		return EBTNodeResult::Failed;
+	}
+
+	const bool bInAttackRange{ Blackboard->GetValue<UBlackboardKeyType_Bool>(InAttackRangeKey.GetSelectedKeyID()) };
+	const bool bCanAttack{ Blackboard->GetValue<UBlackboardKeyType_Bool>(CanAttackKey.GetSelectedKeyID()) };
+
+	if (!bInAttackRange || !bCanAttack)
+	{
+		return EBTNodeResult::Failed;
+	}
+
+	Enemy->PlayAttackMontage(Enemy->GetAttackSectionName(), PlayRate);
+
+	return EBTNodeResult::Succeeded;
+}
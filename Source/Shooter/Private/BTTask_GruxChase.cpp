@@ -0,0 +1,214 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BTTask_GruxChase.h"
+#include "AIController.h"
+#include "BehaviorTree/BlackboardComponent.h"
+#include "BehaviorTree/BehaviorTree.h"
+#include "BehaviorTree/Blackboard/BlackboardKeyType_Object.h"
+#include "GameFramework/Pawn.h"
+#include "FlowFieldSubsystem.h"
+#include "AttackSlotSubsystem.h"
+
+UBTTask_GruxChase::UBTTask_GruxChase() :
+	AcceptanceRadius(100.f),
+	bUseFlowField(true),
+	bUseAttackSlots(true),
+	SlotApproachDistance(600.f),
+	SlotAcceptanceRadius(40.f)
+{
+	NodeName = TEXT("Grux Chase");
+
+	// Steering with the flow field happens in TickTask
+	bNotifyTick = true;
+
+	TargetKey.SelectedKeyName = TEXT("Target");
+	TargetKey.AddObjectFilter(this, GET_MEMBER_NAME_CHECKED(UBTTask_GruxChase, TargetKey), AActor::StaticClass());
+}
+
+void UBTTask_GruxChase::InitializeFromAsset(UBehaviorTree& Asset)
+{
+	Super::InitializeFromAsset(Asset);
+
+	if (UBlackboardData* BlackboardAsset = GetBlackboardAsset())
+	{
+		TargetKey.ResolveSelectedKey(*BlackboardAsset);
+	}
+}
+
+EBTNodeResult::Type UBTTask_GruxChase::ExecuteTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	AAIController* AIController{ OwnerComp.GetAIOwner() };
+	APawn* Pawn{ AIController ? AIController->GetPawn() : nullptr };
+	AActor* Target{ GetTarget(OwnerComp) };
+
+	if (Pawn == nullptr || Target == nullptr)
+	{
+		return EBTNodeResult::Failed;
+	}
+
+	FBTGruxChaseMemory* Memory{ reinterpret_cast<FBTGruxChaseMemory*>(NodeMemory) };
+	Memory->bSteering = false;
+
+	if (FVector::Dist2D(Pawn->GetActorLocation(), Target->GetActorLocation()) <= AcceptanceRadius)
+	{
+		return EBTNodeResult::Succeeded;
+	}
+
+	const UFlowFieldSubsystem* FlowField{ bUseFlowField ? OwnerComp.GetWorld()->GetSubsystem<UFlowFieldSubsystem>() : nullptr };
+
+	FVector Direction;
+	if (FlowField && FlowField->SampleDirection(Target, Pawn->GetActorLocation(), Direction))
+	{
+		Memory->bSteering = true;
+		Pawn->AddMovementInput(Direction);
+
+		return EBTNodeResult::InProgress;
+	}
+
+	return StartPathFollowing(OwnerComp, Memory, Target);
+}
+
+void UBTTask_GruxChase::TickTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, float DeltaSeconds)
+{
+	FBTGruxChaseMemory* Memory{ reinterpret_cast<FBTGruxChaseMemory*>(NodeMemory) };
+
+	AAIController* AIController{ OwnerComp.GetAIOwner() };
+	APawn* Pawn{ AIController ? AIController->GetPawn() : nullptr };
+	AActor* Target{ GetTarget(OwnerComp) };
+
+	if (Pawn == nullptr || Target == nullptr)
+	{
+		FinishLatentTask(OwnerComp, EBTNodeResult::Failed);
+		return;
+	}
+
+	FVector SlotLocation;
+	if (GetAttackSlot(OwnerComp, Pawn, Target, SlotLocation))
+	{
+		if (!Memory->bSteering)
+		{
+			StopWaitingForMessages(OwnerComp);
+			AIController->StopMovement();
+
+			Memory->bSteering = true;
+		}
+
+		// Slots are close to the target with a clear line to it; steer straight there
+		const FVector ToSlot{ SlotLocation - Pawn->GetActorLocation() };
+
+		if (ToSlot.Size2D() <= SlotAcceptanceRadius)
+		{
+			FinishLatentTask(OwnerComp, EBTNodeResult::Succeeded);
+		}
+		else
+		{
+			Pawn->AddMovementInput(ToSlot.GetSafeNormal2D());
+		}
+
+		return;
+	}
+
+	const UFlowFieldSubsystem* FlowField{ bUseFlowField ? OwnerComp.GetWorld()->GetSubsystem<UFlowFieldSubsystem>() : nullptr };
+
+	FVector Direction;
+	const bool bInFlowField{ FlowField && FlowField->SampleDirection(Target, Pawn->GetActorLocation(), Direction) };
+
+	if (Memory->bSteering)
+	{
+		if (FVector::Dist2D(Pawn->GetActorLocation(), Target->GetActorLocation()) <= AcceptanceRadius)
+		{
+			FinishLatentTask(OwnerComp, EBTNodeResult::Succeeded);
+		}
+		else if (bInFlowField)
+		{
+			Pawn->AddMovementInput(Direction);
+		}
+		else
+		{
+			// Left the field; find a regular path
+			const EBTNodeResult::Type Result{ StartPathFollowing(OwnerComp, Memory, Target) };
+
+			if (Result != EBTNodeResult::InProgress)
+			{
+				FinishLatentTask(OwnerComp, Result);
+			}
+		}
+	}
+	else if (bInFlowField)
+	{
+		// Back inside the field; drop the path without finishing the task
+		StopWaitingForMessages(OwnerComp);
+		AIController->StopMovement();
+
+		Memory->bSteering = true;
+		Pawn->AddMovementInput(Direction);
+	}
+}
+
+EBTNodeResult::Type UBTTask_GruxChase::StartPathFollowing(UBehaviorTreeComponent& OwnerComp, FBTGruxChaseMemory* Memory, AActor* Target)
+{
+	AAIController* AIController{ OwnerComp.GetAIOwner() };
+	Memory->bSteering = false;
+
+	const EPathFollowingRequestResult::Type Result{ AIController->MoveToActor(Target, AcceptanceRadius) };
+
+	if (Result == EPathFollowingRequestResult::Failed)
+	{
+		return EBTNodeResult::Failed;
+	}
+
+	if (Result == EPathFollowingRequestResult::AlreadyAtGoal)
+	{
+		return EBTNodeResult::Succeeded;
+	}
+
+	// The default OnMessage finishes the task when the move is done
+	WaitForMessage(OwnerComp, UBrainComponent::AIMessage_MoveFinished, AIController->GetCurrentMoveRequestID());
+
+	return EBTNodeResult::InProgress;
+}
+
+AActor* UBTTask_GruxChase::GetTarget(const UBehaviorTreeComponent& OwnerComp) const
+{
+	const UBlackboardComponent* Blackboard{ OwnerComp.GetBlackboardComponent() };
+
+	return Blackboard ? Cast<AActor>(Blackboard->GetValue<UBlackboardKeyType_Object>(TargetKey.GetSelectedKeyID())) : nullptr;
+}
+
+bool UBTTask_GruxChase::GetAttackSlot(const UBehaviorTreeComponent& OwnerComp, APawn* Pawn, AActor* Target, FVector& OutLocation) const
+{
+	if (!bUseAttackSlots || FVector::Dist2D(Pawn->GetActorLocation(), Target->GetActorLocation()) > SlotApproachDistance)
+	{
+		return false;
+	}
+
+	UAttackSlotSubsystem* AttackSlots{ OwnerComp.GetWorld()->GetSubsystem<UAttackSlotSubsystem>() };
+
+	return AttackSlots && AttackSlots->RequestSlot(Pawn, Target, OutLocation);
+}
+
+EBTNodeResult::Type UBTTask_GruxChase::AbortTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	if (AAIController* AIController = OwnerComp.GetAIOwner())
+	{
+		AIController->StopMovement();
+
+		if (UAttackSlotSubsystem* AttackSlots = OwnerComp.GetWorld()->GetSubsystem<UAttackSlotSubsystem>())
+		{
+			AttackSlots->ReleaseSlot(AIController->GetPawn());
+		}
+	}
+
+	return Super::AbortTask(OwnerComp, NodeMemory);
+}
+
+uint16 UBTTask_GruxChase::GetInstanceMemorySize() const
+{
+	return sizeof(FBTGruxChaseMemory);
+}
+
+FString UBTTask_GruxChase::GetStaticDescription() const
+{
+	return FString::Printf(TEXT("%s: %s"), *Super::GetStaticDescription(), *TargetKey.SelectedKeyName.ToString());
+}
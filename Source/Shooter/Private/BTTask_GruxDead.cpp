@@ -0,0 +1,21 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BTTask_GruxDead.h"
+#include "AIController.h"
+
+UBTTask_GruxDead::UBTTask_GruxDead()
+{
+	NodeName = TEXT("Grux Dead");
+}
+
+EBTNodeResult::Type UBTTask_GruxDead::ExecuteTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	if (AAIController* AIController = OwnerComp.GetAIOwner())
+	{
+		AIController->StopMovement();
+		AIController->ClearFocus(EAIFocusPriority::Gameplay);
+	}
+
+	return EBTNodeResult::InProgress;
+}
@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BTTask_GruxPatrol.h"
+#include "AIController.h"
+#include "BehaviorTree/BlackboardComponent.h"
+#include "BehaviorTree/BehaviorTree.h"
+#include "BehaviorTree/Blackboard/BlackboardKeyType_Vector.h"
+#include "GameFramework/Pawn.h"
+#include "PatrolRouteSubsystem.h"
+
+UBTTask_GruxPatrol::UBTTask_GruxPatrol() :
+	AcceptanceRadius(50.f),
+	RouteStartTolerance(150.f)
+{
+	NodeName = TEXT("Grux Patrol");
+
+	PatrolPointKey.SelectedKeyName = TEXT("PatrolPoint");
+	PatrolPointKey.AddVectorFilter(this, GET_MEMBER_NAME_CHECKED(UBTTask_GruxPatrol, PatrolPointKey));
+
+	PatrolPoint2Key.SelectedKeyName = TEXT("PatrolPoint2");
+	PatrolPoint2Key.AddVectorFilter(this, GET_MEMBER_NAME_CHECKED(UBTTask_GruxPatrol, PatrolPoint2Key));
+}
+
+void UBTTask_GruxPatrol::InitializeFromAsset(UBehaviorTree& Asset)
+{
+	Super::InitializeFromAsset(Asset);
+
+	if (UBlackboardData* BlackboardAsset = GetBlackboardAsset())
+	{
+		PatrolPointKey.ResolveSelectedKey(*BlackboardAsset);
+		PatrolPoint2Key.ResolveSelectedKey(*BlackboardAsset);
+	}
+}
+
+EBTNodeResult::Type UBTTask_GruxPatrol::ExecuteTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	AAIController* AIController{ OwnerComp.GetAIOwner() };
+	const UBlackboardComponent* Blackboard{ OwnerComp.GetBlackboardComponent() };
+
+	if (AIController == nullptr || Blackboard == nullptr)
+	{
+		return EBTNodeResult::Failed;
+	}
+
+	FBTGruxPatrolMemory* Memory{ reinterpret_cast<FBTGruxPatrolMemory*>(NodeMemory) };
+
+	const FBlackboardKeySelector& Key{ Memory->bToSecondPoint ? PatrolPoint2Key : PatrolPointKey };
+	const FBlackboardKeySelector& OtherKey{ Memory->bToSecondPoint ? PatrolPointKey : PatrolPoint2Key };
+	const FVector Destination{ Blackboard->GetValue<UBlackboardKeyType_Vector>(Key.GetSelectedKeyID()) };
+	const FVector Origin{ Blackboard->GetValue<UBlackboardKeyType_Vector>(OtherKey.GetSelectedKeyID()) };
+
+	Memory->bToSecondPoint = !Memory->bToSecondPoint;
+
+	// Walking the loop from the other patrol point follows the cached route without a path query
+	UPatrolRouteSubsystem* PatrolRoutes{ OwnerComp.GetWorld()->GetSubsystem<UPatrolRouteSubsystem>() };
+	APawn* Pawn{ AIController->GetPawn() };
+
+	if (PatrolRoutes && Pawn && FVector::Dist2D(Pawn->GetActorLocation(), Origin) <= RouteStartTolerance)
+	{
+		if (FNavPathSharedPtr RoutePath = PatrolRoutes->MakeRoutePath(Origin, Destination))
+		{
+			FAIMoveRequest MoveRequest(Destination);
+			MoveRequest.SetAcceptanceRadius(AcceptanceRadius);
+
+			const FAIRequestID RequestID{ AIController->RequestMove(MoveRequest, RoutePath) };
+
+			if (RequestID.IsValid())
+			{
+				PatrolRoutes->NotifyQueryAvoided();
+				WaitForMessage(OwnerComp, UBrainComponent::AIMessage_MoveFinished, RequestID);
+
+				return EBTNodeResult::InProgress;
+			}
+		}
+		else
+		{
+			// Not cached yet, or dropped after a navmesh change
+			PatrolRoutes->RequestRoute(Origin, Destination, Pawn);
+		}
+	}
+
+	const EPathFollowingRequestResult::Type Result{ AIController->MoveToLocation(Destination, AcceptanceRadius) };
+
+	if (Result == EPathFollowingRequestResult::Failed)
+	{
+		return EBTNodeResult::Failed;
+	}
+
+	if (Result == EPathFollowingRequestResult::AlreadyAtGoal)
+	{
+		return EBTNodeResult::Succeeded;
+	}
+
+	// The default OnMessage finishes the task when the move is done
+	WaitForMessage(OwnerComp, UBrainComponent::AIMessage_MoveFinished, AIController->GetCurrentMoveRequestID());
+
+	return EBTNodeResult::InProgress;
+}
+
+EBTNodeResult::Type UBTTask_GruxPatrol::AbortTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	if (AAIController* AIController = OwnerComp.GetAIOwner())
+	{
+		AIController->StopMovement();
+	}
+
+	return Super::AbortTask(OwnerComp, NodeMemory);
+}
+
+uint16 UBTTask_GruxPatrol::GetInstanceMemorySize() const
+{
+	return sizeof(FBTGruxPatrolMemory);
+}
+
+FString UBTTask_GruxPatrol::GetStaticDescription() const
+{
+	return FString::Printf(TEXT("%s: %s <-> %s"), *Super::GetStaticDescription(), *PatrolPointKey.SelectedKeyName.ToString(), *PatrolPoint2Key.SelectedKeyName.ToString());
+}
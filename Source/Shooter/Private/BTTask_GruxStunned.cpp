@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BTTask_GruxStunned.h"
+#include "AIController.h"
+#include "BehaviorTree/BehaviorTree.h"
+#include "BehaviorTree/BehaviorTreeComponent.h"
+#include "BehaviorTree/Blackboard/BlackboardKeyType_Bool.h"
+#include "Enemy.h"
+
+UBTTask_GruxStunned::UBTTask_GruxStunned() :
+	MaxStunTime(1.5f)
+{
+	NodeName = TEXT("Grux Stunned");
+
+	// Finished from the blackboard observer
+	bNotifyTaskFinished = true;
+
+	StunnedKey.SelectedKeyName = TEXT("Stunned");
+	StunnedKey.AddBoolFilter(this, GET_MEMBER_NAME_CHECKED(UBTTask_GruxStunned, StunnedKey));
+}
+
+void UBTTask_GruxStunned::InitializeFromAsset(UBehaviorTree& Asset)
+{
+	Super::InitializeFromAsset(Asset);
+
+	if (UBlackboardData* BlackboardAsset = GetBlackboardAsset())
+	{
+		StunnedKey.ResolveSelectedKey(*BlackboardAsset);
+	}
+}
+
+EBTNodeResult::Type UBTTask_GruxStunned::ExecuteTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory)
+{
+	AAIController* AIController{ OwnerComp.GetAIOwner() };
+	UBlackboardComponent* Blackboard{ OwnerComp.GetBlackboardComponent() };
+
+	if (AIController == nullptr || Blackboard == nullptr)
+	{
+		return EBTNodeResult::Failed;
+	}
+
+	if (!Blackboard->GetValue<UBlackboardKeyType_Bool>(StunnedKey.GetSelectedKeyID()))
+	{
+		return EBTNodeResult::Succeeded;
+	}
+
+	AIController->StopMovement();
+
+	Blackboard->RegisterObserver(StunnedKey.GetSelectedKeyID(), this,
+		FOnBlackboardChangeNotification::CreateUObject(this, &UBTTask_GruxStunned::OnStunnedChanged));
+
+	AEnemy* Enemy{ Cast<AEnemy>(AIController->GetPawn()) };
+
+	if (Enemy && MaxStunTime > 0.f)
+	{
+		FBTGruxStunnedMemory* Memory{ reinterpret_cast<FBTGruxStunnedMemory*>(NodeMemory) };
+
+		const FTimerDelegate StunDelegate{ FTimerDelegate::CreateUObject(this, &UBTTask_GruxStunned::OnStunTimeElapsed, TWeakObjectPtr<AEnemy>(Enemy)) };
+		Enemy->GetWorldTimerManager().SetTimer(Memory->StunTimer, StunDelegate, MaxStunTime, false);
+	}
+
+	return EBTNodeResult::InProgress;
+}
+
+void UBTTask_GruxStunned::OnTaskFinished(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, EBTNodeResult::Type TaskResult)
+{
+	if (UBlackboardComponent* Blackboard = OwnerComp.GetBlackboardComponent())
+	{
+		Blackboard->UnregisterObserversFrom(this);
+	}
+
+	FBTGruxStunnedMemory* Memory{ reinterpret_cast<FBTGruxStunnedMemory*>(NodeMemory) };
+
+	if (UWorld* World = OwnerComp.GetWorld())
+	{
+		World->GetTimerManager().ClearTimer(Memory->StunTimer);
+	}
+
+	Super::OnTaskFinished(OwnerComp, NodeMemory, TaskResult);
+}
+
+uint16 UBTTask_GruxStunned::GetInstanceMemorySize() const
+{
+	return sizeof(FBTGruxStunnedMemory);
+}
+
+EBlackboardNotificationResult UBTTask_GruxStunned::OnStunnedChanged(const UBlackboardComponent& Blackboard, FBlackboard::FKey ChangedKeyID)
+{
+	UBehaviorTreeComponent* OwnerComp{ Cast<UBehaviorTreeComponent>(Blackboard.GetBrainComponent()) };
+
+	if (OwnerComp == nullptr)
+	{
+		return EBlackboardNotificationResult::RemoveObserver;
+	}
+
+	if (Blackboard.GetValue<UBlackboardKeyType_Bool>(ChangedKeyID))
+	{
+		return EBlackboardNotificationResult::ContinueObserving;
+	}
+
+	// OnTaskFinished removes the observer and the timer
+	FinishLatentTask(*OwnerComp, EBTNodeResult::Succeeded);
+
+	return EBlackboardNotificationResult::RemoveObserver;
+}
+
+void UBTTask_GruxStunned::OnStunTimeElapsed(TWeakObjectPtr<AEnemy> Enemy)
+{
+	if (Enemy.IsValid())
+	{
+		Enemy->SetStunned(false);
+	}
+}
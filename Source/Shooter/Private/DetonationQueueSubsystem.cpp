@@ -0,0 +1,268 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DetonationQueueSubsystem.h"
+#include "Explosive.h"
+#include "ExplosiveField.h"
+#include "Kismet/GameplayStatics.h"
+#include "Particles/ParticleSystem.h"
+#include "HAL/IConsoleManager.h"
+#include "../Shooter.h"
+
+DECLARE_CYCLE_STAT(TEXT("Detonation Queue"), STAT_DetonationQueue, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Detonations"), STAT_QueuedDetonations, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Detonation Traces"), STAT_QueuedDetonationTraces, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Explosion VFX Spawns"), STAT_ExplosionVFXSpawns, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Detonation Backlog"), STAT_DetonationBacklog, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Explosion VFX Backlog"), STAT_ExplosionVFXBacklog, STATGROUP_Shooter);
+
+static TAutoConsoleVariable<int32> CVarMaxDetonationsPerFrame(
+	TEXT("Shooter.Explosives.MaxDetonationsPerFrame"),
+	4,
+	TEXT("Maximum number of chained detonations resolved in one frame."));
+
+static TAutoConsoleVariable<int32> CVarMaxTracesPerFrame(
+	TEXT("Shooter.Explosives.MaxTracesPerFrame"),
+	96,
+	TEXT("Occlusion traces explosions may use in one frame before remaining detonations wait for the next frame."));
+
+static TAutoConsoleVariable<int32> CVarMaxVFXPerFrame(
+	TEXT("Shooter.Explosives.MaxVFXPerFrame"),
+	6,
+	TEXT("Maximum number of explosion emitters spawned in one frame. Extra emitters are spawned on later frames."));
+
+static TAutoConsoleVariable<float> CVarChainDelayMin(
+	TEXT("Shooter.Explosives.ChainDelayMin"),
+	0.05f,
+	TEXT("Delay in seconds before an explosive set off by another explosion goes off."));
+
+static TAutoConsoleVariable<float> CVarChainDelayPerMeter(
+	TEXT("Shooter.Explosives.ChainDelayPerMeter"),
+	0.02f,
+	TEXT("Extra chain delay in seconds per meter between the two explosives."));
+
+void UDetonationQueueSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DetonationQueue);
+
+	const uint64 StartCycles{ FPlatformTime::Cycles64() };
+	const float Now{ GetWorld()->GetTimeSeconds() };
+
+	const int32 MaxDetonations{ FMath::Max(CVarMaxDetonationsPerFrame.GetValueOnGameThread(), 1) };
+	const int32 MaxTraces{ CVarMaxTracesPerFrame.GetValueOnGameThread() };
+
+	SpawnPendingVFX();
+
+	while (PendingDetonations.Num() > 0 && PendingDetonations.HeapTop().DetonateTime <= Now)
+	{
+		// Always make progress on at least one detonation per frame
+		const bool bHasDoneWork{ FrameStats.Detonations > 0 };
+		if (bHasDoneWork && (FrameStats.Detonations >= MaxDetonations || FrameStats.Traces >= MaxTraces))
+		{
+			break;
+		}
+
+		FPendingDetonation Detonation;
+		PendingDetonations.HeapPop(Detonation, false);
+
+		AActor* Owner{ Detonation.Target.Owner.Get() };
+
+		if (AExplosiveField* Field = Cast<AExplosiveField>(Owner))
+		{
+			Field->DetonateFromChain(Detonation.Target.InstanceId, Detonation.Shooter.Get(), Detonation.ShooterController.Get());
+		}
+		else if (AExplosive* Explosive = Cast<AExplosive>(Owner))
+		{
+			Explosive->DetonateFromChain(Detonation.Shooter.Get(), Detonation.ShooterController.Get());
+		}
+	}
+
+	FrameStats.Backlog = PendingDetonations.Num();
+	FrameStats.VFXBacklog = PendingVFX.Num();
+	FrameStats.TimeMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+
+	SET_DWORD_STAT(STAT_DetonationBacklog, FrameStats.Backlog);
+	SET_DWORD_STAT(STAT_ExplosionVFXBacklog, FrameStats.VFXBacklog);
+
+	ResetFrameStats();
+}
+
+TStatId UDetonationQueueSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDetonationQueueSubsystem, STATGROUP_Tickables);
+}
+
+void UDetonationQueueSubsystem::RegisterExplosive(AExplosive* Explosive)
+{
+	Explosives.AddUnique(Explosive);
+}
+
+void UDetonationQueueSubsystem::UnregisterExplosive(AExplosive* Explosive)
+{
+	Explosives.RemoveSwap(Explosive);
+}
+
+void UDetonationQueueSubsystem::RegisterExplosiveField(AExplosiveField* Field)
+{
+	ExplosiveFields.AddUnique(Field);
+}
+
+void UDetonationQueueSubsystem::UnregisterExplosiveField(AExplosiveField* Field)
+{
+	ExplosiveFields.RemoveSwap(Field);
+}
+
+void UDetonationQueueSubsystem::GatherChainTargets(const FVector& Origin, float Radius, TArray<FDetonationTarget>& OutTargets) const
+{
+	const float RadiusSquared{ Radius * Radius };
+
+	for (const TWeakObjectPtr<AExplosive>& WeakExplosive : Explosives)
+	{
+		AExplosive* Explosive{ WeakExplosive.Get() };
+
+		if (Explosive && !Explosive->IsDetonating())
+		{
+			const FVector Location{ Explosive->GetActorLocation() };
+
+			if (FVector::DistSquared(Origin, Location) <= RadiusSquared)
+			{
+				FDetonationTarget Target;
+				Target.Owner = Explosive;
+				Target.Location = Location;
+
+				OutTargets.Add(Target);
+			}
+		}
+	}
+
+	for (const TWeakObjectPtr<AExplosiveField>& WeakField : ExplosiveFields)
+	{
+		if (const AExplosiveField* Field = WeakField.Get())
+		{
+			Field->GatherInstancesInRadius(Origin, Radius, OutTargets);
+		}
+	}
+}
+
+void UDetonationQueueSubsystem::ScheduleDetonation(const FDetonationTarget& Target, float Distance, AActor* Shooter, AController* ShooterController)
+{
+	AActor* Owner{ Target.Owner.Get() };
+
+	if (AExplosiveField* Field = Cast<AExplosiveField>(Owner))
+	{
+		if (!Field->MarkInstancePending(Target.InstanceId))
+		{
+			return;
+		}
+	}
+	else if (AExplosive* Explosive = Cast<AExplosive>(Owner))
+	{
+		if (Explosive->IsDetonating())
+		{
+			return;
+		}
+
+		Explosive->SetDetonating(true);
+	}
+	else
+	{
+		return;
+	}
+
+	// The blast reaches farther barrels a little later, which also spreads the work
+	const float Delay{ CVarChainDelayMin.GetValueOnGameThread() + CVarChainDelayPerMeter.GetValueOnGameThread() * Distance / 100.f };
+
+	FPendingDetonation Detonation;
+	Detonation.Target = Target;
+	Detonation.DetonateTime = GetWorld()->GetTimeSeconds() + Delay;
+	Detonation.Shooter = Shooter;
+	Detonation.ShooterController = ShooterController;
+
+	PendingDetonations.HeapPush(Detonation);
+}
+
+void UDetonationQueueSubsystem::RequestVFX(UParticleSystem* Template, const FVector& Location)
+{
+	if (Template == nullptr)
+	{
+		return;
+	}
+
+	// Keep the order of effects when there is already a backlog
+	if (PendingVFX.Num() == 0 && FrameStats.VFXSpawns < CVarMaxVFXPerFrame.GetValueOnGameThread())
+	{
+		UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), Template, Location, FRotator(0.f), true);
+		FrameStats.VFXSpawns++;
+		INC_DWORD_STAT(STAT_ExplosionVFXSpawns);
+	}
+	else
+	{
+		PendingVFX.Add({ Template, Location });
+	}
+}
+
+void UDetonationQueueSubsystem::ChargeDetonation(int32 NumTraces)
+{
+	FrameStats.Detonations++;
+	FrameStats.Traces += NumTraces;
+
+	INC_DWORD_STAT(STAT_QueuedDetonations);
+	INC_DWORD_STAT_BY(STAT_QueuedDetonationTraces, NumTraces);
+}
+
+void UDetonationQueueSubsystem::SpawnPendingVFX()
+{
+	const int32 MaxVFX{ CVarMaxVFXPerFrame.GetValueOnGameThread() };
+
+	int32 NumSpawned{ 0 };
+	while (NumSpawned < PendingVFX.Num() && FrameStats.VFXSpawns < MaxVFX)
+	{
+		const FPendingExplosionVFX& VFX{ PendingVFX[NumSpawned] };
+		UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), VFX.Template.Get(), VFX.Location, FRotator(0.f), true);
+
+		FrameStats.VFXSpawns++;
+		NumSpawned++;
+	}
+
+	INC_DWORD_STAT_BY(STAT_ExplosionVFXSpawns, NumSpawned);
+	PendingVFX.RemoveAt(0, NumSpawned, false);
+}
+
+void UDetonationQueueSubsystem::ResetFrameStats()
+{
+	LastFrameStats = FrameStats;
+
+	PeakFrameStats.Detonations = FMath::Max(PeakFrameStats.Detonations, FrameStats.Detonations);
+	PeakFrameStats.Traces = FMath::Max(PeakFrameStats.Traces, FrameStats.Traces);
+	PeakFrameStats.VFXSpawns = FMath::Max(PeakFrameStats.VFXSpawns, FrameStats.VFXSpawns);
+	PeakFrameStats.Backlog = FMath::Max(PeakFrameStats.Backlog, FrameStats.Backlog);
+	PeakFrameStats.VFXBacklog = FMath::Max(PeakFrameStats.VFXBacklog, FrameStats.VFXBacklog);
+	PeakFrameStats.TimeMs = FMath::Max(PeakFrameStats.TimeMs, FrameStats.TimeMs);
+
+	FrameStats = FDetonationFrameStats();
+}
+
+namespace
+{
+	void LogDetonationQueueStats(const TArray<FString>& Args, UWorld* World)
+	{
+		const UDetonationQueueSubsystem* Queue{ World ? World->GetSubsystem<UDetonationQueueSubsystem>() : nullptr };
+
+		if (Queue == nullptr)
+		{
+			return;
+		}
+
+		const FDetonationFrameStats& Last{ Queue->GetLastFrameStats() };
+		const FDetonationFrameStats& Peak{ Queue->GetPeakFrameStats() };
+
+		UE_LOG(LogShooter, Log, TEXT("Detonation queue: backlog %d (vfx %d)"), Queue->GetBacklog(), Queue->GetVFXBacklog());
+		UE_LOG(LogShooter, Log, TEXT("  last frame: %d detonations, %d traces, %d vfx, %.3f ms"), Last.Detonations, Last.Traces, Last.VFXSpawns, Last.TimeMs);
+		UE_LOG(LogShooter, Log, TEXT("  peak frame: %d detonations, %d traces, %d vfx, %.3f ms, backlog %d (vfx %d)"), Peak.Detonations, Peak.Traces, Peak.VFXSpawns, Peak.TimeMs, Peak.Backlog, Peak.VFXBacklog);
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs DetonationQueueStatsCommand(
+		TEXT("Shooter.Explosives.QueueStats"),
+		TEXT("Logs the backlog and the per-frame cost of the explosive detonation queue."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&LogDetonationQueueStats));
+}
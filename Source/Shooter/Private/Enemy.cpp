@@ -7,13 +7,37 @@
 #include "Particles/ParticleSystemComponent.h"
 #include "Blueprint/UserWidget.h"
 #include "Kismet/KismetMathLibrary.h"
-#include "DrawDebugHelpers.h"
 #include "EnemyController.h"
 #include "BehaviorTree/BlackboardComponent.h"
-#include "Components/SphereComponent.h"
 #include "ShooterCharacter.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/BoxComponent.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "PatrolRouteSubsystem.h"
+#include "EnemyPerceptionSubsystem.h"
+#include "EnemyPoolSubsystem.h"
+#include "EnemySquadSubsystem.h"
+#include "LagCompensationSubsystem.h"
+#include "ShooterReplicationGraph.h"
+#include "ShooterCosmetics.h"
+#include "ShooterRandomSubsystem.h"
+#include "GameFramework/GameStateBase.h"
+#include "HAL/IConsoleManager.h"
+#include "Net/UnrealNetwork.h"
+
+static TAutoConsoleVariable<float> CVarEnemyInterpDelay(
+	TEXT("Shooter.Net.EnemyInterpDelay"),
+	0.1f,
+	TEXT("Least time clients show enemies behind the server. Grows to 1.5 snapshot intervals for enemies sending few."));
+
+namespace
+{
+	/** Snapshots a client keeps per enemy */
+	constexpr int32 MaxMovementSamples{ 8 };
+
+	/** A longer gap between snapshots means the enemy stood still in between */
+	constexpr float MaxSnapshotGap{ 0.5f };
+}
 
 // Sets default values
 AEnemy::AEnemy() :
@@ -24,8 +48,13 @@ AEnemy::AEnemy() :
 	HitReactTimeMin(.65f),
 	HitReactTimeMax(1.5f),
 	HitNumberDestroyTime(.5f),
+	AgroRadius(1'000.f),
 	bIsStunned(false),
 	StunChance(.1f),
+	bIsInRange(false),
+	CombatRange(150.f),
+	bHasAttackToken(true),
+	bAttackRangeKey(false),
 	AttackLFast(TEXT("AttackLFast")),
 	AttackRFast(TEXT("AttackRFast")),
 	AttackL(TEXT("AttackL")),
@@ -34,18 +63,21 @@ AEnemy::AEnemy() :
 	bCanAttack(true),
 	AttackWaitTime(1.f),
 	bIsDying(false),
-	DeathTime(4.f)
+	DeathTime(4.f),
+	ReducedMovementTickInterval(.2f),
+	bReducedMovement(false),
+	FullNetUpdateFrequency(20.f),
+	ReducedNetUpdateFrequency(4.f),
+	SnapshotInterval(.05f),
+	LastTeleportCount(0)
 {
  	// Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
 
-	/** Create the agro sphere */
-	AgroSphere = CreateDefaultSubobject<USphereComponent>(TEXT("AgroSphere"));
-	AgroSphere->SetupAttachment(GetRootComponent());
-
-	/** Create the attack sphere */
-	CombatRangeSphere = CreateDefaultSubobject<USphereComponent>(TEXT("CombatRange"));
-	CombatRangeSphere->SetupAttachment(GetRootComponent());
+	// Movement goes out as compact snapshots instead; see MovementSnapshot
+	SetReplicateMovement(false);
+	NetUpdateFrequency = FullNetUpdateFrequency;
+	MinNetUpdateFrequency = ReducedNetUpdateFrequency;
 
 	// Construct collision for left and right weapons
 	LeftWeaponCollision = CreateDefaultSubobject<UBoxComponent>(TEXT("LeftWeaponBox"));
@@ -59,11 +91,6 @@ void AEnemy::BeginPlay()
 {
 	Super::BeginPlay();
 
-	AgroSphere->OnComponentBeginOverlap.AddDynamic(this, &AEnemy::AgroSphereOverlap);
-
-	CombatRangeSphere->OnComponentBeginOverlap.AddDynamic(this, &AEnemy::CombatSphereOverlap);
-	CombatRangeSphere->OnComponentEndOverlap.AddDynamic(this, &AEnemy::CombatSphereEndOverlap);
-
 	// Bind functions to weapons overlap
 	LeftWeaponCollision->OnComponentBeginOverlap.AddDynamic(this, &AEnemy::OnLeftWeaponOverlap);
 	RightWeaponCollision->OnComponentBeginOverlap.AddDynamic(this, &AEnemy::OnRightWeaponOverlap);
@@ -88,24 +115,116 @@ void AEnemy::BeginPlay()
 	// Get the AI controller
 	EnemyController = Cast<AEnemyController>(GetController());
 
+	// AI only runs on the server; clients get the enemy through replication
+	if (HasAuthority())
+	{
+		UpdateNetUpdateFrequency();
+		UpdateMovementSnapshot();
+		StartBehavior();
+	}
+	else
+	{
+		// Clients only place the enemy between snapshots. The AI controller is never spawned on them
+		GetCharacterMovement()->SetComponentTickEnabled(false);
+		GetCharacterMovement()->NetworkSmoothingMode = ENetworkSmoothingMode::Disabled;
+	}
+}
+
+void AEnemy::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(AEnemy, bIsDying);
+	DOREPLIFETIME(AEnemy, MovementSnapshot);
+}
+
+void AEnemy::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	// Only simulated proxies use it to smooth movement, and it changes on every movement update
+	DOREPLIFETIME_ACTIVE_OVERRIDE(ACharacter, ReplicatedServerLastTransformUpdateTimeStamp, false);
+}
+
+void AEnemy::StartBehavior()
+{
 	if (EnemyController)
 	{
-		EnemyController->GetBlackboardComponent()->SetValueAsBool(TEXT("CanAttack"), true);
+		UBlackboardComponent* Blackboard{ EnemyController->GetBlackboardComponent() };
+
+		// Pooled enemies come back with the blackboard of their last life
+		Blackboard->SetValueAsBool(TEXT("CanAttack"), true);
+		Blackboard->SetValueAsBool(TEXT("Dead"), false);
+		Blackboard->SetValueAsBool(TEXT("Stunned"), false);
+		Blackboard->SetValueAsBool(TEXT("InAttackRange"), false);
+		Blackboard->SetValueAsBool(TEXT("CharacterDead"), false);
+		Blackboard->ClearValue(TEXT("Target"));
 	}
 
 	const FVector WorldPatrolPoint = UKismetMathLibrary::TransformLocation(GetActorTransform(), PatrolPoint);
 	const FVector WorldPatrolPoint2 = UKismetMathLibrary::TransformLocation(GetActorTransform(), PatrolPoint2);
 
-	DrawDebugSphere(GetWorld(), WorldPatrolPoint, 24.f, 12, FColor::Cyan, true);
-	DrawDebugSphere(GetWorld(), WorldPatrolPoint2, 24.f, 12, FColor::Green, true);
-
 	if (EnemyController)
 	{
 		EnemyController->GetBlackboardComponent()->SetValueAsVector(TEXT("PatrolPoint"), WorldPatrolPoint);
 		EnemyController->GetBlackboardComponent()->SetValueAsVector(TEXT("PatrolPoint2"), WorldPatrolPoint2);
 
+		// Find both directions of the patrol loop once, off the game thread
+		if (UPatrolRouteSubsystem* PatrolRoutes = GetWorld()->GetSubsystem<UPatrolRouteSubsystem>())
+		{
+			PatrolRoutes->RequestRoute(WorldPatrolPoint, WorldPatrolPoint2, this);
+			PatrolRoutes->RequestRoute(WorldPatrolPoint2, WorldPatrolPoint, this);
+		}
+
 		EnemyController->RunBehaviorTree(BehaviorTree);
 	}
+
+	if (UEnemyPerceptionSubsystem* Perception = GetWorld()->GetSubsystem<UEnemyPerceptionSubsystem>())
+	{
+		Perception->RegisterEnemy(this);
+	}
+
+	if (UEnemySquadSubsystem* Squads = GetWorld()->GetSubsystem<UEnemySquadSubsystem>())
+	{
+		Squads->JoinSquad(this);
+	}
+
+	if (ULagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>())
+	{
+		LagCompensation->RegisterCharacter(this, FName(*HeadBone));
+	}
+}
+
+void AEnemy::StopBehavior()
+{
+	if (UEnemyPerceptionSubsystem* Perception = GetWorld()->GetSubsystem<UEnemyPerceptionSubsystem>())
+	{
+		Perception->UnregisterEnemy(this);
+	}
+
+	if (UEnemySquadSubsystem* Squads = GetWorld()->GetSubsystem<UEnemySquadSubsystem>())
+	{
+		Squads->LeaveSquad(this);
+	}
+
+	if (ULagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>())
+	{
+		LagCompensation->UnregisterCharacter(this);
+	}
+}
+
+void AEnemy::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	StopBehavior();
+
+	// Die unpossesses the controller, so destroying the corpse no longer takes the controller with it
+	if (EndPlayReason == EEndPlayReason::Destroyed && EnemyController && EnemyController->GetPawn() == nullptr)
+	{
+		EnemyController->Destroy();
+		EnemyController = nullptr;
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void AEnemy::ShowHealthBar_Implementation()
@@ -123,6 +242,27 @@ void AEnemy::Die()
 
 	bIsDying = true;
 
+	PlayDeathVisuals();
+
+	if (EnemyController)
+	{
+		EnemyController->GetBlackboardComponent()->SetValueAsBool(TEXT("Dead"), true);
+		EnemyController->StopMovement();
+
+		// Stops the behavior tree; the controller is kept to possess the enemy again if it is reused
+		EnemyController->UnPossess();
+	}
+
+	// Corpses do not move; only the death montage keeps playing
+	GetCharacterMovement()->StopMovementImmediately();
+	GetCharacterMovement()->DisableMovement();
+	GetCharacterMovement()->SetComponentTickEnabled(false);
+
+	StopBehavior();
+}
+
+void AEnemy::PlayDeathVisuals()
+{
 	HideHealthBar();
 
 	UAnimInstance* AnimInstance = GetMesh()->GetAnimInstance();
@@ -132,10 +272,34 @@ void AEnemy::Die()
 		AnimInstance->Montage_Play(DeathMontage);
 	}
 
-	if (EnemyController)
+	// Corpses block nothing
+	SetActorEnableCollision(false);
+}
+
+void AEnemy::ResetDeathVisuals()
+{
+	GetMesh()->bPauseAnims = false;
+	GetMesh()->bNoSkeletonUpdate = false;
+	GetMesh()->SetComponentTickEnabled(true);
+
+	if (UAnimInstance* AnimInstance = GetMesh()->GetAnimInstance())
 	{
-		EnemyController->GetBlackboardComponent()->SetValueAsBool(TEXT("Dead"), true);
-		EnemyController->StopMovement();
+		AnimInstance->StopAllMontages(0.f);
+	}
+
+	SetActorEnableCollision(true);
+	SetActorTickEnabled(true);
+}
+
+void AEnemy::OnRep_IsDying()
+{
+	if (bIsDying)
+	{
+		PlayDeathVisuals();
+	}
+	else
+	{
+		ResetDeathVisuals();
 	}
 }
 
@@ -152,7 +316,7 @@ void AEnemy::PlayHitMontage(FName Section, float PlayRate /*= 1.f*/)
 		}
 
 		bCanHitReact = false;
-		const float HitReactTime{ FMath::FRandRange(HitReactTimeMin, HitReactTimeMax) };
+		const float HitReactTime{ UShooterRandomSubsystem::GetStream(this, EShooterRandomStream::HitReact).FRandRange(HitReactTimeMin, HitReactTimeMax) };
 		GetWorldTimerManager().SetTimer(HitReactTimer, this, &AEnemy::ResetHitReactTimer, HitReactTime);
 	}
 }
@@ -192,75 +356,235 @@ void AEnemy::UpdateHitNumbers()
 	}
 }
 
-void AEnemy::AgroSphereOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+void AEnemy::SetStunned(bool Stunned)
 {
-	if (OtherActor == nullptr)
+	bIsStunned = Stunned;
+
+	if (EnemyController)
+	{
+		EnemyController->GetBlackboardComponent()->SetValueAsBool(TEXT("Stunned"), Stunned);
+	}
+}
+
+void AEnemy::SetTarget(AActor* NewTarget)
+{
+	if (Target.Get() == NewTarget)
 	{
 		return;
 	}
 
-	auto Character = Cast<AShooterCharacter>(OtherActor);
-	if (Character)
+	Target = NewTarget;
+
+	if (EnemyController)
 	{
-		if (EnemyController)
-		{
-			if (EnemyController->GetBlackboardComponent())
-			{
-				// Set the value of the target blackboard key 
-				EnemyController->GetBlackboardComponent()->SetValueAsObject(TEXT("Target"), Character);
-			}
-		}
+		EnemyController->GetBlackboardComponent()->SetValueAsObject(TEXT("Target"), NewTarget);
 	}
 }
 
-void AEnemy::SetStunned(bool Stunned)
+void AEnemy::ReportTarget(AActor* NewTarget)
 {
-	bIsStunned = Stunned;
+	if (UEnemySquadSubsystem* Squads = GetWorld()->GetSubsystem<UEnemySquadSubsystem>())
+	{
+		Squads->ReportTarget(this, NewTarget);
+	}
+	else
+	{
+		SetTarget(NewTarget);
+	}
+}
+
+void AEnemy::NotifyTargetDied()
+{
+	SetTarget(nullptr);
 
 	if (EnemyController)
 	{
-		EnemyController->GetBlackboardComponent()->SetValueAsBool(TEXT("Stunned"), Stunned);
+		EnemyController->GetBlackboardComponent()->SetValueAsBool(TEXT("CharacterDead"), true);
 	}
 }
 
-void AEnemy::CombatSphereOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+void AEnemy::SetInAttackRange(bool bInRange)
+{
+	bIsInRange = bInRange;
+
+	UpdateAttackRangeKey();
+}
+
+void AEnemy::SetAttackToken(bool bHasToken)
 {
-	if (OtherActor == nullptr)
+	bHasAttackToken = bHasToken;
+
+	UpdateAttackRangeKey();
+}
+
+void AEnemy::UpdateAttackRangeKey()
+{
+	const bool bMayAttack{ bIsInRange && bHasAttackToken };
+
+	if (bAttackRangeKey == bMayAttack)
 	{
 		return;
 	}
 
-	auto ShooterCharacter = Cast<AShooterCharacter>(OtherActor);
+	bAttackRangeKey = bMayAttack;
+
+	if (EnemyController)
+	{
+		EnemyController->GetBlackboardComponent()->SetValueAsBool(TEXT("InAttackRange"), bMayAttack);
+	}
+}
+
+void AEnemy::UpdateNetUpdateFrequency()
+{
+	// Far enemies nobody sees send fewer snapshots
+	NetUpdateFrequency = bReducedMovement ? ReducedNetUpdateFrequency : FullNetUpdateFrequency;
+
+	UShooterReplicationGraph::NotifyUpdateFrequencyChanged(this);
+}
 
-	if (ShooterCharacter)
+float AEnemy::GetServerTime() const
+{
+	const AGameStateBase* GameState{ GetWorld()->GetGameState() };
+
+	return GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+}
+
+void AEnemy::UpdateMovementSnapshot()
+{
+	FEnemyMovementSnapshot Snapshot{ MovementSnapshot };
+	Snapshot.Set(GetActorLocation(), GetActorRotation().Yaw, GetServerTime());
+
+	// Enemies standing still send nothing
+	if (!Snapshot.HasSameMovement(MovementSnapshot))
 	{
-		bIsInRange = true;
+		MovementSnapshot = Snapshot;
+	}
+}
 
-		if (EnemyController)
-		{
-			EnemyController->GetBlackboardComponent()->SetValueAsBool(TEXT("InAttackRange"), true);
-		}
+void AEnemy::OnRep_MovementSnapshot()
+{
+	FEnemyMovementSample Sample;
+	Sample.Time = MovementSnapshot.GetTime(GetServerTime());
+	Sample.Location = MovementSnapshot.GetLocation();
+	Sample.Yaw = MovementSnapshot.GetYaw();
+
+	// First snapshot or a teleport: go there right away
+	if (MovementSamples.Num() == 0 || MovementSnapshot.TeleportCount != LastTeleportCount)
+	{
+		LastTeleportCount = MovementSnapshot.TeleportCount;
+
+		MovementSamples.Reset();
+		MovementSamples.Add(Sample);
+
+		SetActorLocationAndRotation(Sample.Location, FRotator(0.f, Sample.Yaw, 0.f), false, nullptr, ETeleportType::TeleportPhysics);
+		return;
 	}
+
+	const FEnemyMovementSample& LastSample{ MovementSamples.Last() };
+	const float Gap{ Sample.Time - LastSample.Time };
+
+	if (Gap <= 0.f)
+	{
+		return;
+	}
+
+	if (Gap > MaxSnapshotGap)
+	{
+		// Stood still until about one interval before this snapshot, instead of sliding slowly all along
+		FEnemyMovementSample Hold{ LastSample };
+		Hold.Time = Sample.Time - SnapshotInterval;
+		MovementSamples.Add(Hold);
+	}
+	else
+	{
+		SnapshotInterval = FMath::Lerp(SnapshotInterval, Gap, .2f);
+	}
+
+	if (MovementSamples.Num() >= MaxMovementSamples)
+	{
+		MovementSamples.RemoveAt(0, MovementSamples.Num() - MaxMovementSamples + 1, false);
+	}
+
+	MovementSamples.Add(Sample);
 }
 
-void AEnemy::CombatSphereEndOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
+void AEnemy::InterpolateMovement()
 {
-	if (OtherActor == nullptr)
+	if (MovementSamples.Num() == 0)
 	{
 		return;
 	}
 
-	auto ShooterCharacter = Cast<AShooterCharacter>(OtherActor);
+	const float RenderTime{ GetServerTime() - GetInterpolationDelay(SnapshotInterval) };
+
+	// Keep the last snapshot before the render time and those after it
+	while (MovementSamples.Num() > 2 && MovementSamples[1].Time <= RenderTime)
+	{
+		MovementSamples.RemoveAt(0, 1, false);
+	}
+
+	const FEnemyMovementSample& From{ MovementSamples[0] };
+	const FEnemyMovementSample& To{ MovementSamples.Num() > 1 ? MovementSamples[1] : From };
+
+	const float Duration{ To.Time - From.Time };
+	const float Alpha{ Duration > 0.f ? FMath::Clamp((RenderTime - From.Time) / Duration, 0.f, 1.f) : 1.f };
+
+	const FVector Location{ FMath::Lerp(From.Location, To.Location, Alpha) };
+	const FRotator Rotation{ FMath::Lerp(FRotator(0.f, From.Yaw, 0.f), FRotator(0.f, To.Yaw, 0.f), Alpha) };
+
+	SetActorLocationAndRotation(Location, Rotation);
+
+	// The anim instance reads the speed from the velocity
+	UCharacterMovementComponent* Movement{ GetCharacterMovement() };
+	Movement->Velocity = Duration > 0.f && Alpha < 1.f ? (To.Location - From.Location) / Duration : FVector::ZeroVector;
+	Movement->UpdateComponentVelocity();
+}
+
+float AEnemy::GetInterpolationDelay(float Interval)
+{
+	return FMath::Clamp(Interval * 1.5f, CVarEnemyInterpDelay.GetValueOnGameThread(), MaxSnapshotGap);
+}
+
+float AEnemy::GetClientInterpolationDelay() const
+{
+	return GetInterpolationDelay(1.f / FMath::Max(NetUpdateFrequency, 1.f));
+}
+
+void AEnemy::SetReducedMovement(bool bReduced)
+{
+	if (bReducedMovement == bReduced)
+	{
+		return;
+	}
+
+	UCharacterMovementComponent* Movement{ GetCharacterMovement() };
 
-	if (ShooterCharacter)
+	if (bReduced)
 	{
-		bIsInRange = false;
+		// Falling enemies keep full physics until they land
+		if (!Movement->IsMovingOnGround())
+		{
+			return;
+		}
+
+		// Follows the navmesh height instead of sweeping for the floor every update
+		Movement->SetMovementMode(MOVE_NavWalking);
+		Movement->SetComponentTickInterval(ReducedMovementTickInterval);
+	}
+	else
+	{
+		Movement->SetComponentTickInterval(0.f);
 
-		if (EnemyController)
+		// Checks that the capsule fits before turning collision back on; tried again on the next update if not
+		if (Movement->MovementMode == MOVE_NavWalking && !Movement->TryToLeaveNavWalking())
 		{
-			EnemyController->GetBlackboardComponent()->SetValueAsBool(TEXT("InAttackRange"), false);
+			return;
 		}
 	}
+
+	bReducedMovement = bReduced;
+
+	UpdateNetUpdateFrequency();
 }
 
 void AEnemy::PlayAttackMontage(FName Section, float PlayRate /*= 1.f*/)
@@ -270,7 +594,7 @@ void AEnemy::PlayAttackMontage(FName Section, float PlayRate /*= 1.f*/)
 	if (AnimInstance && AttackMontage)
 	{
 		AnimInstance->Montage_Play(AttackMontage, PlayRate);
-		AnimInstance->Montage_JumpToSection(GetAttackSectionName(), AttackMontage);
+		AnimInstance->Montage_JumpToSection(Section != NAME_None ? Section : GetAttackSectionName(), AttackMontage);
 	}
 
 	bCanAttack = false;
@@ -285,7 +609,7 @@ void AEnemy::PlayAttackMontage(FName Section, float PlayRate /*= 1.f*/)
 FName AEnemy::GetAttackSectionName()
 {
 	FName SectionName;
-	const int32 Section{ FMath::RandRange(1,4) };
+	const int32 Section{ UShooterRandomSubsystem::GetStream(this, EShooterRandomStream::EnemyAttack).RandRange(1, 4) };
 
 	switch (Section)
 	{
@@ -356,6 +680,11 @@ void AEnemy::DoDamage(AShooterCharacter* Victim)
 	{
 		UGameplayStatics::ApplyDamage(Character, BaseDamage, EnemyController, this, UDamageType::StaticClass());
 
+		if (ShooterCosmetics::AreStripped())
+		{
+			return;
+		}
+
 		// Activate death sound if the current hit will kill the character
 		if (Character->GetHealth() < BaseDamage)
 		{
@@ -394,7 +723,7 @@ void AEnemy::StunCharacter(AShooterCharacter* Victim)
 {
 	if (Victim)
 	{
-		const float Stun{ FMath::FRandRange(0.f, 1.f) };
+		const float Stun{ UShooterRandomSubsystem::GetStream(this, EShooterRandomStream::Stun).FRand() };
 
 		if (Stun <= Victim->GetStunChance())
 		{
@@ -415,14 +744,94 @@ void AEnemy::ResetCanAttack()
 
 void AEnemy::FinishDeath()
 {
+	// Freeze the last pose; the mesh keeps drawing it without evaluating anims or updating bones
 	GetMesh()->bPauseAnims = true;
+	GetMesh()->bNoSkeletonUpdate = true;
+	GetMesh()->SetComponentTickEnabled(false);
+	SetActorTickEnabled(false);
+
+	// The server takes the corpse away
+	if (!HasAuthority())
+	{
+		return;
+	}
 
 	GetWorldTimerManager().SetTimer(DeathTimer, this, &AEnemy::DestroyEnemy, DeathTime);
+
+	// May take this corpse away right away if there are too many
+	if (UEnemyPoolSubsystem* EnemyPool = GetWorld()->GetSubsystem<UEnemyPoolSubsystem>())
+	{
+		EnemyPool->AddCorpse(this);
+	}
 }
 
 void AEnemy::DestroyEnemy()
 {
-	Destroy();
+	if (UEnemyPoolSubsystem* EnemyPool = GetWorld()->GetSubsystem<UEnemyPoolSubsystem>())
+	{
+		EnemyPool->ReleaseEnemy(this);
+	}
+	else
+	{
+		Destroy();
+	}
+}
+
+void AEnemy::EnterPool()
+{
+	GetWorldTimerManager().ClearAllTimersForObject(this);
+
+	for (auto& HitPair : HitNumbers)
+	{
+		HitPair.Key->RemoveFromParent();
+	}
+	HitNumbers.Empty();
+
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+	SetActorTickEnabled(false);
+	GetMesh()->SetComponentTickEnabled(false);
+	GetCharacterMovement()->SetComponentTickEnabled(false);
+
+	StopBehavior();
+}
+
+void AEnemy::LeavePool(const FTransform& SpawnTransform)
+{
+	SetActorTransform(SpawnTransform, false, nullptr, ETeleportType::ResetPhysics);
+
+	// Clients jump to the new location instead of interpolating from the corpse
+	MovementSnapshot.TeleportCount = (MovementSnapshot.TeleportCount + 1) % EnemyMovement::MaxTeleports;
+	UpdateMovementSnapshot();
+
+	Health = MaxHealth;
+	bIsDying = false;
+	bIsStunned = false;
+	bIsInRange = false;
+	bHasAttackToken = true;
+	bAttackRangeKey = false;
+	bCanHitReact = true;
+	bCanAttack = true;
+	bReducedMovement = false;
+	Target = nullptr;
+
+	ResetDeathVisuals();
+
+	UCharacterMovementComponent* Movement{ GetCharacterMovement() };
+	Movement->SetComponentTickInterval(0.f);
+	Movement->SetComponentTickEnabled(true);
+	Movement->SetMovementMode(Movement->DefaultLandMovementMode);
+
+	UpdateNetUpdateFrequency();
+
+	SetActorHiddenInGame(false);
+
+	if (EnemyController)
+	{
+		EnemyController->Possess(this);
+	}
+
+	StartBehavior();
 }
 
 // Called every frame
@@ -430,6 +839,15 @@ void AEnemy::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	if (HasAuthority())
+	{
+		UpdateMovementSnapshot();
+	}
+	else
+	{
+		InterpolateMovement();
+	}
+
 	UpdateHitNumbers();
 }
 
@@ -442,11 +860,8 @@ void AEnemy::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
 
 float AEnemy::TakeDamage(float Damage, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser)
 {
-	// Set the target blackboard key to agro the character
-	if (EnemyController)
-	{
-		EnemyController->GetBlackboardComponent()->SetValueAsObject(TEXT("Target"), DamageCauser);
-	}
+	// Agro the character, along with the rest of the squad
+	ReportTarget(DamageCauser);
 
 	if (Health - Damage <= 0.f)
 	{
@@ -463,10 +878,13 @@ float AEnemy::TakeDamage(float Damage, struct FDamageEvent const& DamageEvent, A
 		return Damage;
 	}
 
-	ShowHealthBar();
+	if (!ShooterCosmetics::AreStripped())
+	{
+		ShowHealthBar();
+	}
 
 	// Determine whether bullet hit stuns
-	const float Stunned = FMath::FRandRange(0.f, 1.f);
+	const float Stunned = UShooterRandomSubsystem::GetStream(this, EShooterRandomStream::Stun).FRand();
 	if (Stunned <= StunChance)
 	{
 		// Stun the enemy
@@ -479,6 +897,11 @@ float AEnemy::TakeDamage(float Damage, struct FDamageEvent const& DamageEvent, A
 
 void AEnemy::BulletHit_Implementation(FHitResult HitResult, AActor* Shooter, AController* ShooterController)
 {
+	if (ShooterCosmetics::AreStripped())
+	{
+		return;
+	}
+
 	if (ImpactSFX)
 	{
 		UGameplayStatics::PlaySoundAtLocation(this, ImpactSFX, GetActorLocation());
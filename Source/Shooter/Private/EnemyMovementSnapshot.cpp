@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EnemyMovementSnapshot.h"
+#include "../Shooter.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Enemy Snapshots Received"), STAT_EnemySnapshotsReceived, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Enemy Snapshot Bits Received"), STAT_EnemySnapshotBitsReceived, STATGROUP_Shooter);
+
+namespace
+{
+	/** Bits of a snapshot besides the cell */
+	constexpr int32 FixedBits{ 3 * EnemyMovement::OffsetBits + EnemyMovement::YawBits + 16 + 2 };
+
+	/** Cell coordinates are small, so they are zigzag encoded and sent packed. Returns the bits sent */
+	int32 SerializeCellCoordinate(FArchive& Ar, int32& Coordinate)
+	{
+		uint32 Encoded{ static_cast<uint32>((Coordinate << 1) ^ (Coordinate >> 31)) };
+		Ar.SerializeIntPacked(Encoded);
+
+		if (Ar.IsLoading())
+		{
+			Coordinate = static_cast<int32>(Encoded >> 1) ^ -static_cast<int32>(Encoded & 1);
+		}
+
+		// Seven bits per byte
+		return 8 * FMath::Max(1, FMath::DivideAndRoundUp(32 - static_cast<int32>(FMath::CountLeadingZeros(Encoded)), 7));
+	}
+}
+
+void FEnemyMovementSnapshot::Set(const FVector& Location, float InYaw, float ServerTime)
+{
+	const int32 X{ FMath::RoundToInt(Location.X) };
+	const int32 Y{ FMath::RoundToInt(Location.Y) };
+	const int32 Z{ FMath::RoundToInt(Location.Z) };
+
+	// Arithmetic shift and mask floor negative coordinates too
+	Cell = FIntVector(X >> EnemyMovement::OffsetBits, Y >> EnemyMovement::OffsetBits, Z >> EnemyMovement::OffsetBits);
+
+	OffsetX = static_cast<uint16>(X & (EnemyMovement::CellSize - 1));
+	OffsetY = static_cast<uint16>(Y & (EnemyMovement::CellSize - 1));
+	OffsetZ = static_cast<uint16>(Z & (EnemyMovement::CellSize - 1));
+
+	constexpr int32 YawSteps{ 1 << EnemyMovement::YawBits };
+	Yaw = static_cast<uint16>(FMath::RoundToInt(FRotator::ClampAxis(InYaw) / 360.f * YawSteps) & (YawSteps - 1));
+
+	TimeStamp = static_cast<uint16>(FMath::FloorToInt(ServerTime / EnemyMovement::TimeStep) & MAX_uint16);
+}
+
+FVector FEnemyMovementSnapshot::GetLocation() const
+{
+	return FVector(
+		Cell.X * EnemyMovement::CellSize + OffsetX,
+		Cell.Y * EnemyMovement::CellSize + OffsetY,
+		Cell.Z * EnemyMovement::CellSize + OffsetZ);
+}
+
+float FEnemyMovementSnapshot::GetYaw() const
+{
+	return Yaw * 360.f / (1 << EnemyMovement::YawBits);
+}
+
+float FEnemyMovementSnapshot::GetTime(float NearServerTime) const
+{
+	const float Time{ TimeStamp * EnemyMovement::TimeStep };
+	const float Wraps{ FMath::RoundToFloat((NearServerTime - Time) / EnemyMovement::TimeWrap) };
+
+	return Time + Wraps * EnemyMovement::TimeWrap;
+}
+
+bool FEnemyMovementSnapshot::HasSameMovement(const FEnemyMovementSnapshot& Other) const
+{
+	return Cell == Other.Cell && OffsetX == Other.OffsetX && OffsetY == Other.OffsetY && OffsetZ == Other.OffsetZ
+		&& Yaw == Other.Yaw && TeleportCount == Other.TeleportCount;
+}
+
+bool FEnemyMovementSnapshot::operator==(const FEnemyMovementSnapshot& Other) const
+{
+	return HasSameMovement(Other) && TimeStamp == Other.TimeStamp;
+}
+
+bool FEnemyMovementSnapshot::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	bOutSuccess = true;
+
+	int32 CellBits{ SerializeCellCoordinate(Ar, Cell.X) };
+	CellBits += SerializeCellCoordinate(Ar, Cell.Y);
+	CellBits += SerializeCellCoordinate(Ar, Cell.Z);
+
+	uint32 Offset{ OffsetX };
+	Ar.SerializeBits(&Offset, EnemyMovement::OffsetBits);
+	OffsetX = static_cast<uint16>(Offset);
+
+	Offset = OffsetY;
+	Ar.SerializeBits(&Offset, EnemyMovement::OffsetBits);
+	OffsetY = static_cast<uint16>(Offset);
+
+	Offset = OffsetZ;
+	Ar.SerializeBits(&Offset, EnemyMovement::OffsetBits);
+	OffsetZ = static_cast<uint16>(Offset);
+
+	uint32 PackedYaw{ Yaw };
+	Ar.SerializeBits(&PackedYaw, EnemyMovement::YawBits);
+	Yaw = static_cast<uint16>(PackedYaw);
+
+	Ar << TimeStamp;
+
+	uint32 Teleports{ TeleportCount };
+	Ar.SerializeInt(Teleports, EnemyMovement::MaxTeleports);
+	TeleportCount = static_cast<uint8>(Teleports);
+
+	if (Ar.IsLoading())
+	{
+		INC_DWORD_STAT(STAT_EnemySnapshotsReceived);
+		INC_DWORD_STAT_BY(STAT_EnemySnapshotBitsReceived, CellBits + FixedBits);
+	}
+
+	return true;
+}
@@ -0,0 +1,431 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EnemyPerceptionSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/ParallelFor.h"
+#include "Enemy.h"
+#include "EnemySquadSubsystem.h"
+#include "ShooterCharacter.h"
+#include "VisibilityGridSubsystem.h"
+#include "../Shooter.h"
+
+DECLARE_CYCLE_STAT(TEXT("Enemy Perception"), STAT_EnemyPerception, STATGROUP_Shooter);
+DECLARE_CYCLE_STAT(TEXT("Enemy Perception Snapshot"), STAT_EnemyPerceptionSnapshot, STATGROUP_Shooter);
+DECLARE_CYCLE_STAT(TEXT("Enemy Perception Decide"), STAT_EnemyPerceptionDecide, STATGROUP_Shooter);
+DECLARE_CYCLE_STAT(TEXT("Enemy Perception Apply"), STAT_EnemyPerceptionApply, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Enemy Sight Traces"), STAT_EnemySightTraces, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Enemy Sight From Grid"), STAT_EnemySightFromGrid, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Perceiving Enemies"), STAT_PerceivingEnemies, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Enemies Decided"), STAT_EnemiesDecided, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Reduced Movement Enemies"), STAT_ReducedMovementEnemies, STATGROUP_Shooter);
+
+static TAutoConsoleVariable<float> CVarPerceptionRate(
+	TEXT("Shooter.Perception.Rate"),
+	10.f,
+	TEXT("Enemy perception updates per second. 0 updates every frame."));
+
+static TAutoConsoleVariable<int32> CVarPerceptionMaxTraces(
+	TEXT("Shooter.Perception.MaxTracesPerUpdate"),
+	64,
+	TEXT("Line of sight traces sent per perception update. Other enemies wait for the next update."));
+
+static TAutoConsoleVariable<int32> CVarPerceptionMaxEnemies(
+	TEXT("Shooter.Perception.MaxEnemiesPerUpdate"),
+	512,
+	TEXT("Enemies decided for per perception update. Larger hordes are spread over several updates. 0 decides for every enemy."));
+
+static TAutoConsoleVariable<int32> CVarPerceptionChunkSize(
+	TEXT("Shooter.Perception.ChunkSize"),
+	64,
+	TEXT("Enemies decided for by each worker task. Slices no larger than this are decided on the game thread."));
+
+static TAutoConsoleVariable<float> CVarLoseTargetScale(
+	TEXT("Shooter.Perception.LoseTargetScale"),
+	3.f,
+	TEXT("Enemies forget a player target farther than this many times their agro radius. 0 never forgets."));
+
+static TAutoConsoleVariable<float> CVarReducedMovementDistance(
+	TEXT("Shooter.Movement.ReducedDistance"),
+	3'000.f,
+	TEXT("Enemies farther than this from every player and off screen use reduced movement."));
+
+static TAutoConsoleVariable<int32> CVarForceMovementTier(
+	TEXT("Shooter.Movement.ForceTier"),
+	-1,
+	TEXT("-1: pick the movement tier from distance and visibility. 0: force full movement. 1: force reduced movement."));
+
+namespace
+{
+	/** Position of the padding lanes and dead players; far enough to never be in range */
+	constexpr float FarAway{ 1.e15f };
+
+	/** Reduced enemies must come this much closer than the reduced distance to switch back, so they do not flicker between tiers */
+	constexpr float FullMovementDistanceScale{ .8f };
+
+	/** Enemies rendered this recently are on screen and keep full movement */
+	constexpr float RecentlyRenderedTime{ .25f };
+}
+
+void UEnemyPerceptionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	SightTraceDelegate.BindUObject(this, &UEnemyPerceptionSubsystem::OnSightTraceDone);
+}
+
+void UEnemyPerceptionSubsystem::Tick(float DeltaTime)
+{
+	const float Rate{ CVarPerceptionRate.GetValueOnGameThread() };
+
+	TimeSinceUpdate += DeltaTime;
+
+	if (Rate > 0.f && TimeSinceUpdate < 1.f / Rate)
+	{
+		return;
+	}
+
+	TimeSinceUpdate = 0.f;
+
+	UpdatePerception();
+}
+
+TStatId UEnemyPerceptionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemyPerceptionSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemyPerceptionSubsystem::RegisterEnemy(AEnemy* Enemy)
+{
+	Enemies.AddUnique(Enemy);
+}
+
+void UEnemyPerceptionSubsystem::UnregisterEnemy(AEnemy* Enemy)
+{
+	Enemies.RemoveSwap(Enemy);
+}
+
+void UEnemyPerceptionSubsystem::GatherSnapshot()
+{
+	SCOPE_CYCLE_COUNTER(STAT_EnemyPerceptionSnapshot);
+
+	Players.Reset();
+	PlayerX.Reset();
+	PlayerY.Reset();
+	PlayerZ.Reset();
+	PlayerAlive.Reset();
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		AShooterCharacter* Player{ It->IsValid() ? Cast<AShooterCharacter>((*It)->GetPawn()) : nullptr };
+
+		if (Player)
+		{
+			const bool bAlive{ Player->GetHealth() > 0.f };
+			const FVector Location{ bAlive ? Player->GetActorLocation() : FVector(FarAway) };
+
+			Players.Add(Player);
+			PlayerX.Add(Location.X);
+			PlayerY.Add(Location.Y);
+			PlayerZ.Add(Location.Z);
+			PlayerAlive.Add(bAlive);
+		}
+	}
+
+	Enemies.RemoveAllSwap([](const TWeakObjectPtr<AEnemy>& Enemy) { return !Enemy.IsValid(); });
+
+	// Round robin through the enemies when there are more than one update may decide for
+	const int32 MaxEnemies{ CVarPerceptionMaxEnemies.GetValueOnGameThread() };
+	const int32 NumSlice{ MaxEnemies > 0 ? FMath::Min(Enemies.Num(), MaxEnemies) : Enemies.Num() };
+	const int32 NumPadded{ Align(NumSlice, 4) };
+
+	if (SliceCursor >= Enemies.Num())
+	{
+		SliceCursor = 0;
+	}
+
+	SliceEnemies.Reset();
+	for (int32 i = 0; i < NumSlice; i++)
+	{
+		SliceEnemies.Add(Enemies[(SliceCursor + i) % Enemies.Num()].Get());
+	}
+
+	SliceCursor = Enemies.Num() > 0 ? (SliceCursor + NumSlice) % Enemies.Num() : 0;
+
+	EnemyX.SetNumUninitialized(NumPadded);
+	EnemyY.SetNumUninitialized(NumPadded);
+	EnemyZ.SetNumUninitialized(NumPadded);
+	AgroRadiusSquared.SetNumUninitialized(NumPadded);
+	CombatRangeSquared.SetNumUninitialized(NumPadded);
+	EnemySnapshots.SetNum(NumPadded);
+	Decisions.SetNum(NumPadded);
+
+	for (int32 i = 0; i < NumPadded; i++)
+	{
+		const AEnemy* Enemy{ i < NumSlice ? SliceEnemies[i] : nullptr };
+		FEnemySnapshot& Snapshot{ EnemySnapshots[i] };
+
+		if (Enemy && !Enemy->GetIsDying())
+		{
+			const FVector Location{ Enemy->GetActorLocation() };
+
+			EnemyX[i] = Location.X;
+			EnemyY[i] = Location.Y;
+			EnemyZ[i] = Location.Z;
+			AgroRadiusSquared[i] = FMath::Square(Enemy->GetAgroRadius());
+			CombatRangeSquared[i] = FMath::Square(Enemy->GetCombatRange());
+
+			const AActor* Target{ Enemy->GetTarget() };
+
+			Snapshot.bHasTarget = Target != nullptr;
+			Snapshot.TargetPlayer = Players.IndexOfByPredicate([Target](const TWeakObjectPtr<AActor>& Player) { return Target && Player.Get() == Target; });
+			Snapshot.bAwaitingSight = EnemiesAwaitingSight.Contains(Enemy);
+			Snapshot.bReducedMovement = Enemy->GetIsReducedMovement();
+			Snapshot.bRecentlyRendered = Enemy->WasRecentlyRendered(RecentlyRenderedTime);
+		}
+		else
+		{
+			EnemyX[i] = FarAway;
+			EnemyY[i] = FarAway;
+			EnemyZ[i] = FarAway;
+			AgroRadiusSquared[i] = -1.f;
+			CombatRangeSquared[i] = -1.f;
+			Snapshot = FEnemySnapshot();
+		}
+	}
+
+	const UVisibilityGridSubsystem* GridSubsystem{ GetWorld()->GetSubsystem<UVisibilityGridSubsystem>() };
+	VisibilityGrid = GridSubsystem ? GridSubsystem->GetGrid() : nullptr;
+
+	ForceMovementTier = CVarForceMovementTier.GetValueOnGameThread();
+	ReducedDistanceSquared = FMath::Square(CVarReducedMovementDistance.GetValueOnGameThread());
+	LoseTargetScaleSquared = FMath::Square(CVarLoseTargetScale.GetValueOnGameThread());
+}
+
+void UEnemyPerceptionSubsystem::DecideBlock(int32 Block)
+{
+	// Nearest player of the four enemies
+	const VectorRegister X{ VectorLoad(&EnemyX[Block]) };
+	const VectorRegister Y{ VectorLoad(&EnemyY[Block]) };
+	const VectorRegister Z{ VectorLoad(&EnemyZ[Block]) };
+
+	VectorRegister NearestSquared{ VectorSetFloat1(MAX_flt) };
+	VectorRegister NearestIndex{ VectorSetFloat1(-1.f) };
+
+	for (int32 p = 0; p < Players.Num(); p++)
+	{
+		const VectorRegister DeltaX{ VectorSubtract(X, VectorSetFloat1(PlayerX[p])) };
+		const VectorRegister DeltaY{ VectorSubtract(Y, VectorSetFloat1(PlayerY[p])) };
+		const VectorRegister DeltaZ{ VectorSubtract(Z, VectorSetFloat1(PlayerZ[p])) };
+
+		const VectorRegister DistanceSquared{ VectorMultiplyAdd(DeltaX, DeltaX, VectorMultiplyAdd(DeltaY, DeltaY, VectorMultiply(DeltaZ, DeltaZ))) };
+		const VectorRegister Closer{ VectorCompareGT(NearestSquared, DistanceSquared) };
+
+		NearestSquared = VectorSelect(Closer, DistanceSquared, NearestSquared);
+		NearestIndex = VectorSelect(Closer, VectorSetFloat1(static_cast<float>(p)), NearestIndex);
+	}
+
+	float NearestDistanceSquared[4];
+	float NearestPlayer[4];
+	VectorStore(NearestSquared, NearestDistanceSquared);
+	VectorStore(NearestIndex, NearestPlayer);
+
+	const int32 InAgroRange{ VectorMaskBits(VectorCompareGE(VectorLoad(&AgroRadiusSquared[Block]), NearestSquared)) };
+	const int32 InCombatRange{ VectorMaskBits(VectorCompareGE(VectorLoad(&CombatRangeSquared[Block]), NearestSquared)) };
+
+	const float FullDistanceSquared{ ReducedDistanceSquared * FMath::Square(FullMovementDistanceScale) };
+
+	for (int32 Lane = 0; Lane < 4; Lane++)
+	{
+		const int32 i{ Block + Lane };
+		const FEnemySnapshot& Snapshot{ EnemySnapshots[i] };
+		FEnemyDecision& Decision{ Decisions[i] };
+
+		Decision = FEnemyDecision();
+
+		// Padding lanes and dying enemies have no range, so they are never in combat or agro range
+		Decision.bInAttackRange = (InCombatRange & (1 << Lane)) != 0;
+
+		if (ForceMovementTier >= 0)
+		{
+			Decision.bReducedMovement = ForceMovementTier > 0;
+		}
+		else
+		{
+			const float TierDistanceSquared{ Snapshot.bReducedMovement ? FullDistanceSquared : ReducedDistanceSquared };
+			Decision.bReducedMovement = NearestDistanceSquared[Lane] > TierDistanceSquared && !Snapshot.bRecentlyRendered;
+		}
+
+		// Forget players that died or got far away
+		if (Snapshot.TargetPlayer != INDEX_NONE)
+		{
+			const int32 p{ Snapshot.TargetPlayer };
+			const float TargetDistanceSquared{ FMath::Square(EnemyX[i] - PlayerX[p]) + FMath::Square(EnemyY[i] - PlayerY[p]) + FMath::Square(EnemyZ[i] - PlayerZ[p]) };
+
+			Decision.bDropTarget = !PlayerAlive[p] || (LoseTargetScaleSquared > 0.f && TargetDistanceSquared > AgroRadiusSquared[i] * LoseTargetScaleSquared);
+		}
+
+		// In range of a player but not hostile yet; check line of sight before aggroing
+		const bool bHostile{ Snapshot.bHasTarget && !Decision.bDropTarget };
+
+		if (!bHostile && !Snapshot.bAwaitingSight && (InAgroRange & (1 << Lane)) != 0)
+		{
+			const int32 p{ static_cast<int32>(NearestPlayer[Lane]) };
+
+			// The grid only needs a trace when the cells are partly visible
+			const EGridVisibility Visibility{ VisibilityGrid
+				? VisibilityGrid->GetVisibility(FVector(EnemyX[i], EnemyY[i], EnemyZ[i]), FVector(PlayerX[p], PlayerY[p], PlayerZ[p]))
+				: EGridVisibility::Unknown };
+
+			if (Visibility != EGridVisibility::Occluded)
+			{
+				Decision.SightPlayer = p;
+				Decision.bSightFromGrid = Visibility == EGridVisibility::Visible;
+			}
+		}
+	}
+}
+
+void UEnemyPerceptionSubsystem::ApplyDecisions()
+{
+	SCOPE_CYCLE_COUNTER(STAT_EnemyPerceptionApply);
+
+	int32 TraceBudget{ CVarPerceptionMaxTraces.GetValueOnGameThread() };
+
+	UEnemySquadSubsystem* Squads{ GetWorld()->GetSubsystem<UEnemySquadSubsystem>() };
+
+	for (int32 i = 0; i < SliceEnemies.Num(); i++)
+	{
+		AEnemy* Enemy{ SliceEnemies[i] };
+		const FEnemyDecision& Decision{ Decisions[i] };
+
+		if (Enemy == nullptr || Enemy->GetIsDying())
+		{
+			continue;
+		}
+
+		// Only writes the blackboard when the value changes
+		Enemy->SetInAttackRange(Decision.bInAttackRange);
+		Enemy->SetReducedMovement(Decision.bReducedMovement);
+
+		// The squad drops the target once every member has lost it
+		if (Decision.bDropTarget)
+		{
+			if (Squads)
+			{
+				Squads->ReportTargetLost(Enemy);
+			}
+			else
+			{
+				Enemy->SetTarget(nullptr);
+			}
+		}
+
+		AActor* Player{ Decision.SightPlayer != INDEX_NONE ? Players[Decision.SightPlayer].Get() : nullptr };
+
+		if (Player == nullptr)
+		{
+			continue;
+		}
+
+		if (Decision.bSightFromGrid)
+		{
+			Enemy->ReportTarget(Player);
+			INC_DWORD_STAT(STAT_EnemySightFromGrid);
+			continue;
+		}
+
+		if (TraceBudget <= 0)
+		{
+			continue;
+		}
+
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(EnemySight), false, Enemy);
+
+		const uint32 TraceId{ NextSightTraceId++ };
+		GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, Enemy->GetPawnViewLocation(), Player->GetActorLocation(),
+			ECollisionChannel::ECC_Visibility, QueryParams, FCollisionResponseParams::DefaultResponseParam, &SightTraceDelegate, TraceId);
+
+		PendingSightTraces.Add(TraceId, { Enemy, Player });
+		EnemiesAwaitingSight.Add(Enemy);
+
+		TraceBudget--;
+		INC_DWORD_STAT(STAT_EnemySightTraces);
+	}
+}
+
+void UEnemyPerceptionSubsystem::UpdatePerception()
+{
+	SCOPE_CYCLE_COUNTER(STAT_EnemyPerception);
+
+	GatherSnapshot();
+
+	SET_DWORD_STAT(STAT_PerceivingEnemies, Enemies.Num());
+	SET_DWORD_STAT(STAT_EnemiesDecided, SliceEnemies.Num());
+
+	if (SliceEnemies.Num() == 0)
+	{
+		return;
+	}
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_EnemyPerceptionDecide);
+
+		// Whole blocks of four per chunk; the last chunk may be short
+		const int32 NumBlocks{ EnemyX.Num() / 4 };
+		const int32 BlocksPerChunk{ FMath::Max(CVarPerceptionChunkSize.GetValueOnGameThread() / 4, 1) };
+		const int32 NumChunks{ FMath::DivideAndRoundUp(NumBlocks, BlocksPerChunk) };
+
+		ParallelFor(NumChunks, [this, NumBlocks, BlocksPerChunk](int32 Chunk)
+			{
+				const int32 LastBlock{ FMath::Min((Chunk + 1) * BlocksPerChunk, NumBlocks) };
+
+				for (int32 Block = Chunk * BlocksPerChunk; Block < LastBlock; Block++)
+				{
+					DecideBlock(Block * 4);
+				}
+			}, NumChunks <= 1);
+	}
+
+	ApplyDecisions();
+
+	int32 NumReduced{ 0 };
+	for (const TWeakObjectPtr<AEnemy>& Enemy : Enemies)
+	{
+		if (Enemy->GetIsReducedMovement())
+		{
+			NumReduced++;
+		}
+	}
+
+	SET_DWORD_STAT(STAT_ReducedMovementEnemies, NumReduced);
+}
+
+void UEnemyPerceptionSubsystem::OnSightTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum)
+{
+	FPendingSightTrace SightTrace;
+	if (!PendingSightTraces.RemoveAndCopyValue(Datum.UserData, SightTrace))
+	{
+		return;
+	}
+
+	EnemiesAwaitingSight.Remove(SightTrace.Enemy);
+
+	AEnemy* Enemy{ SightTrace.Enemy.Get() };
+	AActor* Player{ SightTrace.Player.Get() };
+
+	if (Enemy == nullptr || Player == nullptr || Enemy->GetIsDying())
+	{
+		return;
+	}
+
+	const FHitResult* Blocker{ FHitResult::GetFirstBlockingHit(Datum.OutHits) };
+
+	// Nothing in the way, or the trace stopped on the player
+	if (Blocker == nullptr || Blocker->GetActor() == Player)
+	{
+		Enemy->ReportTarget(Player);
+	}
+}
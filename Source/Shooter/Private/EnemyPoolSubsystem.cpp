@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EnemyPoolSubsystem.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Enemy.h"
+#include "../Shooter.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Enemy Corpses"), STAT_EnemyCorpses, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Enemies"), STAT_PooledEnemies, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Enemies Reused"), STAT_EnemiesReused, STATGROUP_Shooter);
+
+static TAutoConsoleVariable<int32> CVarMaxCorpses(
+	TEXT("Shooter.Corpses.Max"),
+	12,
+	TEXT("Dead enemies left in the level at once. The oldest corpse is taken away when a new one goes over."));
+
+static TAutoConsoleVariable<int32> CVarMaxPooledEnemies(
+	TEXT("Shooter.Corpses.MaxPooled"),
+	32,
+	TEXT("Hidden enemies kept for reuse. Enemies released when the pool is full are destroyed."));
+
+bool UEnemyPoolSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World{ Cast<UWorld>(Outer) };
+
+	return World && World->IsGameWorld();
+}
+
+void UEnemyPoolSubsystem::Deinitialize()
+{
+	Corpses.Empty();
+	PooledEnemies.Empty();
+
+	Super::Deinitialize();
+}
+
+void UEnemyPoolSubsystem::AddCorpse(AEnemy* Enemy)
+{
+	Corpses.AddUnique(Enemy);
+
+	const int32 MaxCorpses{ FMath::Max(CVarMaxCorpses.GetValueOnGameThread(), 0) };
+
+	while (Corpses.Num() > MaxCorpses)
+	{
+		AEnemy* Oldest{ Corpses[0].Get() };
+		Corpses.RemoveAt(0, 1, false);
+
+		if (Oldest)
+		{
+			ReleaseEnemy(Oldest);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_EnemyCorpses, Corpses.Num());
+}
+
+void UEnemyPoolSubsystem::ReleaseEnemy(AEnemy* Enemy)
+{
+	Corpses.Remove(Enemy);
+	SET_DWORD_STAT(STAT_EnemyCorpses, Corpses.Num());
+
+	if (PooledEnemies.Contains(Enemy))
+	{
+		return;
+	}
+
+	if (PooledEnemies.Num() >= CVarMaxPooledEnemies.GetValueOnGameThread())
+	{
+		Enemy->Destroy();
+		return;
+	}
+
+	Enemy->EnterPool();
+	PooledEnemies.Add(Enemy);
+
+	SET_DWORD_STAT(STAT_PooledEnemies, PooledEnemies.Num());
+}
+
+AEnemy* UEnemyPoolSubsystem::AcquireEnemy(TSubclassOf<AEnemy> EnemyClass, const FTransform& SpawnTransform)
+{
+	if (EnemyClass == nullptr)
+	{
+		return nullptr;
+	}
+
+	const int32 PooledIndex{ PooledEnemies.IndexOfByPredicate([EnemyClass](const AEnemy* Enemy)
+		{
+			return IsValid(Enemy) && Enemy->GetClass() == EnemyClass;
+		}) };
+
+	if (PooledIndex != INDEX_NONE)
+	{
+		AEnemy* Enemy{ PooledEnemies[PooledIndex] };
+		PooledEnemies.RemoveAtSwap(PooledIndex, 1, false);
+		SET_DWORD_STAT(STAT_PooledEnemies, PooledEnemies.Num());
+
+		Enemy->LeavePool(SpawnTransform);
+		INC_DWORD_STAT(STAT_EnemiesReused);
+
+		return Enemy;
+	}
+
+	// Nothing to reuse; spawn one with its AI controller like an enemy placed in the level
+	AEnemy* Enemy{ GetWorld()->SpawnActorDeferred<AEnemy>(EnemyClass, SpawnTransform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn) };
+
+	if (Enemy)
+	{
+		Enemy->AutoPossessAI = EAutoPossessAI::PlacedInWorldOrSpawned;
+		Enemy->FinishSpawning(SpawnTransform);
+	}
+
+	return Enemy;
+}
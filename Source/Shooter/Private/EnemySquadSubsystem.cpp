@@ -0,0 +1,331 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EnemySquadSubsystem.h"
+#include "HAL/IConsoleManager.h"
+#include "Enemy.h"
+#include "../Shooter.h"
+
+DECLARE_CYCLE_STAT(TEXT("Enemy Squads Tick"), STAT_EnemySquadsTick, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Squad Target Broadcasts"), STAT_SquadTargetBroadcasts, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Enemy Squads"), STAT_EnemySquads, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Attack Tokens"), STAT_AttackTokens, STATGROUP_Shooter);
+
+static TAutoConsoleVariable<float> CVarSquadJoinRadius(
+	TEXT("Shooter.Squads.JoinRadius"),
+	1'500.f,
+	TEXT("Enemies without a squad name join the nearest squad within this distance."));
+
+static TAutoConsoleVariable<int32> CVarSquadMaxSize(
+	TEXT("Shooter.Squads.MaxSize"),
+	8,
+	TEXT("Members of a squad grouped by distance. Named squads have no limit."));
+
+static TAutoConsoleVariable<int32> CVarMaxAttackersPerPlayer(
+	TEXT("Shooter.Squads.MaxAttackersPerPlayer"),
+	4,
+	TEXT("Enemies attacking the same player at once. 0 does not limit attackers."));
+
+static TAutoConsoleVariable<float> CVarAttackTokenRate(
+	TEXT("Shooter.Squads.AttackTokenRate"),
+	5.f,
+	TEXT("Attack token assignments per second."));
+
+void UEnemySquadSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_EnemySquadsTick);
+
+	ShareTargets();
+
+	const float Rate{ CVarAttackTokenRate.GetValueOnGameThread() };
+
+	TimeSinceTokens += DeltaTime;
+
+	if (Rate <= 0.f || TimeSinceTokens >= 1.f / Rate)
+	{
+		TimeSinceTokens = 0.f;
+		AssignAttackTokens();
+	}
+}
+
+TStatId UEnemySquadSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemySquadSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemySquadSubsystem::JoinSquad(AEnemy* Enemy)
+{
+	if (Enemy == nullptr || FindSquad(Enemy))
+	{
+		return;
+	}
+
+	const FName SquadName{ Enemy->GetSquadName() };
+	const FVector Location{ Enemy->GetActorLocation() };
+
+	const float JoinRadiusSquared{ FMath::Square(CVarSquadJoinRadius.GetValueOnGameThread()) };
+	const int32 MaxSize{ CVarSquadMaxSize.GetValueOnGameThread() };
+
+	int32 BestSquad{ INDEX_NONE };
+	float BestDistanceSquared{ MAX_flt };
+	int32 EmptySquad{ INDEX_NONE };
+
+	for (int32 i = 0; i < Squads.Num(); i++)
+	{
+		const FEnemySquad& Squad{ Squads[i] };
+
+		if (Squad.Members.Num() == 0)
+		{
+			EmptySquad = i;
+			continue;
+		}
+
+		if (SquadName != NAME_None)
+		{
+			if (Squad.Name == SquadName)
+			{
+				BestSquad = i;
+				break;
+			}
+
+			continue;
+		}
+
+		if (Squad.Name != NAME_None || Squad.Members.Num() >= MaxSize)
+		{
+			continue;
+		}
+
+		for (const TWeakObjectPtr<AEnemy>& Member : Squad.Members)
+		{
+			const float DistanceSquared{ Member.IsValid() ? FVector::DistSquared(Member->GetActorLocation(), Location) : MAX_flt };
+
+			if (DistanceSquared <= JoinRadiusSquared && DistanceSquared < BestDistanceSquared)
+			{
+				BestSquad = i;
+				BestDistanceSquared = DistanceSquared;
+			}
+		}
+	}
+
+	if (BestSquad == INDEX_NONE)
+	{
+		BestSquad = EmptySquad != INDEX_NONE ? EmptySquad : Squads.AddDefaulted();
+		Squads[BestSquad] = FEnemySquad();
+		Squads[BestSquad].Name = SquadName;
+	}
+
+	FEnemySquad& Squad{ Squads[BestSquad] };
+	Squad.Members.Add(Enemy);
+	Squad.LostTarget.Add(false);
+
+	// Join the squad's fight right away; attack only once given a token
+	Enemy->SetTarget(Squad.Target.Get());
+	Enemy->SetAttackToken(false);
+}
+
+void UEnemySquadSubsystem::LeaveSquad(AEnemy* Enemy)
+{
+	int32 MemberIndex{ INDEX_NONE };
+
+	if (FEnemySquad* Squad = FindSquad(Enemy, &MemberIndex))
+	{
+		Squad->Members.RemoveAtSwap(MemberIndex);
+
+		// Mirror the swap
+		Squad->LostTarget[MemberIndex] = Squad->LostTarget[Squad->LostTarget.Num() - 1];
+		Squad->LostTarget.RemoveAt(Squad->LostTarget.Num() - 1);
+	}
+}
+
+void UEnemySquadSubsystem::ReportTarget(AEnemy* Enemy, AActor* Target)
+{
+	if (Enemy == nullptr)
+	{
+		return;
+	}
+
+	Enemy->SetTarget(Target);
+
+	int32 MemberIndex{ INDEX_NONE };
+	FEnemySquad* Squad{ FindSquad(Enemy, &MemberIndex) };
+
+	if (Squad == nullptr || Target == nullptr)
+	{
+		return;
+	}
+
+	Squad->LostTarget[MemberIndex] = false;
+
+	if (Squad->Target == Target)
+	{
+		return;
+	}
+
+	Squad->Target = Target;
+	Squad->bTargetDirty = true;
+}
+
+void UEnemySquadSubsystem::ReportTargetLost(AEnemy* Enemy)
+{
+	int32 MemberIndex{ INDEX_NONE };
+	FEnemySquad* Squad{ FindSquad(Enemy, &MemberIndex) };
+
+	if (Squad == nullptr)
+	{
+		Enemy->SetTarget(nullptr);
+		return;
+	}
+
+	Squad->LostTarget[MemberIndex] = true;
+
+	for (int32 i = 0; i < Squad->Members.Num(); i++)
+	{
+		// Some member still has the target in reach
+		if (!Squad->LostTarget[i] && Squad->Members[i].IsValid() && !Squad->Members[i]->GetIsDying())
+		{
+			return;
+		}
+	}
+
+	Squad->Target = nullptr;
+	Squad->bTargetDirty = true;
+}
+
+void UEnemySquadSubsystem::NotifyCharacterDied(AActor* Player)
+{
+	for (FEnemySquad& Squad : Squads)
+	{
+		for (const TWeakObjectPtr<AEnemy>& Member : Squad.Members)
+		{
+			if (Member.IsValid() && Member->GetTarget() == Player)
+			{
+				Member->NotifyTargetDied();
+			}
+		}
+
+		if (Squad.Target == Player)
+		{
+			Squad.Target = nullptr;
+			Squad.bTargetDirty = true;
+		}
+	}
+}
+
+void UEnemySquadSubsystem::ShareTargets()
+{
+	for (FEnemySquad& Squad : Squads)
+	{
+		if (!Squad.bTargetDirty)
+		{
+			continue;
+		}
+
+		Squad.bTargetDirty = false;
+		Squad.LostTarget.Init(false, Squad.Members.Num());
+
+		AActor* Target{ Squad.Target.Get() };
+
+		// Members only write the blackboard when their target changes
+		for (const TWeakObjectPtr<AEnemy>& Member : Squad.Members)
+		{
+			if (Member.IsValid() && !Member->GetIsDying())
+			{
+				Member->SetTarget(Target);
+			}
+		}
+
+		INC_DWORD_STAT(STAT_SquadTargetBroadcasts);
+	}
+}
+
+void UEnemySquadSubsystem::AssignAttackTokens()
+{
+	const int32 MaxAttackers{ CVarMaxAttackersPerPlayer.GetValueOnGameThread() };
+
+	// Enemies in attack range of each target
+	TMap<AActor*, TArray<AEnemy*>> Attackers;
+	int32 NumSquads{ 0 };
+
+	for (const FEnemySquad& Squad : Squads)
+	{
+		if (Squad.Members.Num() > 0)
+		{
+			NumSquads++;
+		}
+
+		for (const TWeakObjectPtr<AEnemy>& Member : Squad.Members)
+		{
+			AEnemy* Enemy{ Member.Get() };
+
+			if (Enemy == nullptr || Enemy->GetIsDying())
+			{
+				continue;
+			}
+
+			if (MaxAttackers <= 0 || Enemy->GetTarget() == nullptr)
+			{
+				Enemy->SetAttackToken(true);
+				continue;
+			}
+
+			// Out of range enemies wait for the next assignment instead of jumping ahead of the attackers
+			if (!Enemy->GetIsInRange())
+			{
+				Enemy->SetAttackToken(false);
+				continue;
+			}
+
+			Attackers.FindOrAdd(Enemy->GetTarget()).Add(Enemy);
+		}
+	}
+
+	int32 NumTokens{ 0 };
+
+	for (auto& TargetAttackers : Attackers)
+	{
+		const FVector TargetLocation{ TargetAttackers.Key->GetActorLocation() };
+		TArray<AEnemy*>& Enemies{ TargetAttackers.Value };
+
+		// Enemies holding a token keep it so attacks are not cut off; then the nearest
+		Enemies.Sort([TargetLocation](const AEnemy& A, const AEnemy& B)
+			{
+				if (A.GetHasAttackToken() != B.GetHasAttackToken())
+				{
+					return A.GetHasAttackToken();
+				}
+
+				return FVector::DistSquared(A.GetActorLocation(), TargetLocation) < FVector::DistSquared(B.GetActorLocation(), TargetLocation);
+			});
+
+		for (int32 i = 0; i < Enemies.Num(); i++)
+		{
+			Enemies[i]->SetAttackToken(i < MaxAttackers);
+		}
+
+		NumTokens += FMath::Min(Enemies.Num(), MaxAttackers);
+	}
+
+	SET_DWORD_STAT(STAT_AttackTokens, NumTokens);
+	SET_DWORD_STAT(STAT_EnemySquads, NumSquads);
+}
+
+FEnemySquad* UEnemySquadSubsystem::FindSquad(const AEnemy* Enemy, int32* OutMemberIndex)
+{
+	for (FEnemySquad& Squad : Squads)
+	{
+		const int32 MemberIndex{ Squad.Members.IndexOfByKey(Enemy) };
+
+		if (MemberIndex != INDEX_NONE)
+		{
+			if (OutMemberIndex)
+			{
+				*OutMemberIndex = MemberIndex;
+			}
+
+			return &Squad;
+		}
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,169 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ExplosionBlast.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/DamageType.h"
+#include "Components/PrimitiveComponent.h"
+#include "DetonationQueueSubsystem.h"
+#include "ExplosiveField.h"
+#include "../Shooter.h"
+
+DECLARE_CYCLE_STAT(TEXT("Explosive Blast"), STAT_ExplosiveBlast, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Explosive Occlusion Traces"), STAT_ExplosiveOcclusionTraces, STATGROUP_Shooter);
+
+namespace
+{
+	/** Something inside the blast radius waiting for its occlusion trace */
+	struct FBlastCandidate
+	{
+		AActor* Actor;
+
+		/** Body to push; null for characters and chained explosives */
+		UPrimitiveComponent* Component;
+		FVector TargetLocation;
+
+		/** Index into the chain targets, or INDEX_NONE */
+		int32 ChainIndex;
+	};
+}
+
+float FExplosionBlast::GetDamageScale(float Distance) const
+{
+	if (Distance <= DamageInnerRadius || Radius <= DamageInnerRadius)
+	{
+		return 1.f;
+	}
+
+	// 0 at the inner radius, 1 at the edge of the blast
+	const float Alpha{ FMath::Clamp((Distance - DamageInnerRadius) / (Radius - DamageInnerRadius), 0.f, 1.f) };
+
+	return FMath::Lerp(1.f, MinimumDamageScale, FMath::Pow(Alpha, DamageFalloff));
+}
+
+int32 FExplosionBlast::Resolve(UWorld* World) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_ExplosiveBlast);
+
+	if (World == nullptr)
+	{
+		return 0;
+	}
+
+	UDetonationQueueSubsystem* DetonationQueue{ World->GetSubsystem<UDetonationQueueSubsystem>() };
+
+	// One overlap query for every pawn and physics body in range
+	FCollisionObjectQueryParams ObjectQueryParams;
+	ObjectQueryParams.AddObjectTypesToQuery(ECollisionChannel::ECC_Pawn);
+	ObjectQueryParams.AddObjectTypesToQuery(ECollisionChannel::ECC_PhysicsBody);
+	ObjectQueryParams.AddObjectTypesToQuery(ECollisionChannel::ECC_WorldDynamic);
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ExplosiveOverlap), false, ExplodingActor);
+
+	TArray<FOverlapResult> Overlaps;
+	World->OverlapMultiByObjectType(Overlaps, Origin, FQuat::Identity, ObjectQueryParams, FCollisionShape::MakeSphere(Radius), QueryParams);
+
+	// Characters are damaged once no matter how many of their components overlap;
+	// every simulating body gets its own impulse
+	TArray<FBlastCandidate> Candidates;
+	Candidates.Reserve(Overlaps.Num());
+
+	for (const FOverlapResult& Overlap : Overlaps)
+	{
+		AActor* Actor{ Overlap.GetActor() };
+		UPrimitiveComponent* Component{ Overlap.GetComponent() };
+
+		if (Actor == nullptr || Component == nullptr)
+		{
+			continue;
+		}
+
+		if (Actor->IsA<ACharacter>())
+		{
+			const bool bAlreadyAdded = Candidates.ContainsByPredicate([Actor](const FBlastCandidate& Candidate)
+				{
+					return Candidate.Component == nullptr && Candidate.Actor == Actor;
+				});
+
+			if (!bAlreadyAdded)
+			{
+				Candidates.Add({ Actor, nullptr, Actor->GetActorLocation(), INDEX_NONE });
+			}
+		}
+		else if (Component->IsSimulatingPhysics())
+		{
+			Candidates.Add({ Actor, Component, Component->GetComponentLocation(), INDEX_NONE });
+		}
+	}
+
+	// Other explosives and barrel instances come from the queue's registry instead of the overlap query
+	TArray<FDetonationTarget> ChainTargets;
+	if (DetonationQueue)
+	{
+		DetonationQueue->GatherChainTargets(Origin, Radius, ChainTargets);
+	}
+
+	for (int32 i = 0; i < ChainTargets.Num(); i++)
+	{
+		Candidates.Add({ ChainTargets[i].Owner.Get(), nullptr, ChainTargets[i].Location, i });
+	}
+
+	// Batch the occlusion traces; the same query params are shared by every trace
+	FCollisionQueryParams OcclusionParams(SCENE_QUERY_STAT(ExplosiveOcclusion), false, ExplodingActor);
+	TBitArray<> Visible(false, Candidates.Num());
+
+	for (int32 i = 0; i < Candidates.Num(); i++)
+	{
+		FHitResult OcclusionHit;
+		const bool bBlocked = World->LineTraceSingleByChannel(OcclusionHit, Origin, Candidates[i].TargetLocation, OcclusionChannel, OcclusionParams);
+
+		// Hitting the victim itself does not count as cover
+		Visible[i] = !bBlocked || OcclusionHit.GetActor() == Candidates[i].Actor;
+	}
+
+	INC_DWORD_STAT_BY(STAT_ExplosiveOcclusionTraces, Candidates.Num());
+
+	if (DetonationQueue)
+	{
+		DetonationQueue->ChargeDetonation(Candidates.Num());
+	}
+
+	for (int32 i = 0; i < Candidates.Num(); i++)
+	{
+		if (!Visible[i])
+		{
+			continue;
+		}
+
+		const FBlastCandidate& Candidate{ Candidates[i] };
+
+		const float Distance{ FVector::Dist(Origin, Candidate.TargetLocation) };
+
+		if (Candidate.ChainIndex != INDEX_NONE)
+		{
+			const FDetonationTarget& Target{ ChainTargets[Candidate.ChainIndex] };
+
+			// Barrel instances can survive weak blasts; everything else goes off
+			AExplosiveField* Field{ Cast<AExplosiveField>(Candidate.Actor) };
+			if (Field && !Field->DamageInstance(Target.InstanceId, Damage * GetDamageScale(Distance)))
+			{
+				continue;
+			}
+
+			// Chained explosives go off a little later, within the queue's frame budget
+			DetonationQueue->ScheduleDetonation(Target, Distance, Shooter, ShooterController);
+		}
+		else if (Candidate.Component == nullptr)
+		{
+			UGameplayStatics::ApplyDamage(Candidate.Actor, Damage * GetDamageScale(Distance), ShooterController, Shooter, UDamageType::StaticClass());
+		}
+		else
+		{
+			Candidate.Component->AddRadialImpulse(Origin, Radius, RadialImpulse, ERadialImpulseFalloff::RIF_Linear, true);
+		}
+	}
+
+	return Candidates.Num();
+}
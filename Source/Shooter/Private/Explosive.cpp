@@ -6,64 +6,123 @@
 #include "Sound/SoundCue.h"
 #include "Particles/ParticleSystemComponent.h"
 #include "Components/SphereComponent.h"
-#include "Gameframework/Character.h"
+#include "DetonationQueueSubsystem.h"
+#include "ExplosionBlast.h"
+#include "ShooterCosmetics.h"
 
 // Sets default values
 AExplosive::AExplosive() :
-	Damage(250.f)
+	Damage(250.f),
+	DamageInnerRadius(100.f),
+	MinimumDamageScale(0.25f),
+	DamageFalloff(1.f),
+	RadialImpulse(2'000.f),
+	OcclusionChannel(ECollisionChannel::ECC_Visibility),
+	bIsDetonating(false)
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	// Explosives only react to bullet hits; no need to tick
+	PrimaryActorTick.bCanEverTick = false;
+
+	// Replicated only so clients see them destroyed; nothing else changes, so they stay dormant
+	bReplicates = true;
+	NetDormancy = DORM_Initial;
 
 	ExplosiveMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("ExplosiveMesh"));
 	SetRootComponent(ExplosiveMesh);
 
 	OverlapSphere = CreateDefaultSubobject<USphereComponent>(TEXT("OverlapSphere"));
 	OverlapSphere->SetupAttachment(GetRootComponent());
+
+	// The blast queries the world itself when exploding; the sphere only stores the radius
+	OverlapSphere->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	OverlapSphere->SetGenerateOverlapEvents(false);
 }
 
 // Called when the game starts or when spawned
 void AExplosive::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	if (UDetonationQueueSubsystem* DetonationQueue = GetWorld()->GetSubsystem<UDetonationQueueSubsystem>())
+	{
+		DetonationQueue->RegisterExplosive(this);
+	}
 }
 
-// Called every frame
-void AExplosive::Tick(float DeltaTime)
+void AExplosive::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	Super::Tick(DeltaTime);
+	if (UDetonationQueueSubsystem* DetonationQueue = GetWorld()->GetSubsystem<UDetonationQueueSubsystem>())
+	{
+		DetonationQueue->UnregisterExplosive(this);
+	}
 
+	Super::EndPlay(EndPlayReason);
 }
 
 void AExplosive::BulletHit_Implementation(FHitResult HitResult, AActor* Shooter, AController* ShooterController)
 {
-	if (ExplodeVFX)
-	{
-		UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), ExplodeVFX, HitResult.Location, FRotator(0.f), true);
-	}
-
-	if (ImpactSFX)
+	if (ImpactSFX && !ShooterCosmetics::AreStripped())
 	{
 		UGameplayStatics::PlaySoundAtLocation(this, ImpactSFX, GetActorLocation());
 	}
 
-	if (ExplodeSFX)
+	// A bullet always sets the explosive off right away, even if a chain reaction already scheduled it
+	Explode(HitResult.Location, Shooter, ShooterController);
+}
+
+void AExplosive::DetonateFromChain(AActor* Shooter, AController* ShooterController)
+{
+	Explode(GetActorLocation(), Shooter, ShooterController);
+}
+
+void AExplosive::Explode(const FVector& VFXLocation, AActor* Shooter, AController* ShooterController)
+{
+	if (IsPendingKillPending())
 	{
-		UGameplayStatics::PlaySoundAtLocation(this, ExplodeSFX, GetActorLocation());
+		return;
 	}
 
-	// Apply AOE damage
-	TArray<AActor*> OverlappingActors;
-	GetOverlappingActors(OverlappingActors, ACharacter::StaticClass());
+	bIsDetonating = true;
+
+	UDetonationQueueSubsystem* DetonationQueue{ GetWorld()->GetSubsystem<UDetonationQueueSubsystem>() };
 
-	for (auto Actor : OverlappingActors)
+	if (!ShooterCosmetics::AreStripped())
 	{
-		UGameplayStatics::ApplyDamage(Actor, Damage, ShooterController, Shooter, UDamageType::StaticClass());
+		if (DetonationQueue)
+		{
+			// Budgeted; effects over the frame budget are spawned on the next frames
+			DetonationQueue->RequestVFX(ExplodeVFX, VFXLocation);
+		}
+		else if (ExplodeVFX)
+		{
+			UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), ExplodeVFX, VFXLocation, FRotator(0.f), true);
+		}
+
+		if (ExplodeSFX)
+		{
+			UGameplayStatics::PlaySoundAtLocation(this, ExplodeSFX, GetActorLocation());
+		}
 	}
 
-	// TO DO: Apply Radial force
+	FExplosionBlast Blast;
+	Blast.Origin = GetActorLocation();
+	Blast.Radius = OverlapSphere->GetScaledSphereRadius();
+	Blast.Damage = Damage;
+	Blast.DamageInnerRadius = DamageInnerRadius;
+	Blast.MinimumDamageScale = MinimumDamageScale;
+	Blast.DamageFalloff = DamageFalloff;
+	Blast.RadialImpulse = RadialImpulse;
+	Blast.OcclusionChannel = OcclusionChannel;
+	Blast.ExplodingActor = this;
+	Blast.Shooter = Shooter;
+	Blast.ShooterController = ShooterController;
+
+	Blast.Resolve(GetWorld());
 
 	Destroy();
 }
 
+float AExplosive::GetBlastRadius() const
+{
+	return OverlapSphere->GetScaledSphereRadius();
+}
@@ -0,0 +1,302 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ExplosiveField.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "Sound/SoundCue.h"
+#include "DetonationQueueSubsystem.h"
+#include "ExplosionBlast.h"
+#include "Explosive.h"
+#include "ShooterCosmetics.h"
+#if WITH_EDITOR
+#include "EngineUtils.h"
+#endif
+
+// Sets default values
+AExplosiveField::AExplosiveField() :
+	DamageInnerRadius(100.f),
+	MinimumDamageScale(0.25f),
+	DamageFalloff(1.f),
+	RadialImpulse(2'000.f),
+	OcclusionChannel(ECollisionChannel::ECC_Visibility),
+	InstanceBounds(ForceInit),
+	NextInstanceId(0)
+{
+	// Instances only react to bullet hits and the detonation queue; no need to tick
+	PrimaryActorTick.bCanEverTick = false;
+
+	ExplosiveInstances = CreateDefaultSubobject<UHierarchicalInstancedStaticMeshComponent>(TEXT("ExplosiveInstances"));
+	SetRootComponent(ExplosiveInstances);
+}
+
+void AExplosiveField::OnConstruction(const FTransform& Transform)
+{
+	Super::OnConstruction(Transform);
+
+	// Instances painted or added in the editor get the default data
+	const int32 NumInstances{ ExplosiveInstances->GetInstanceCount() };
+
+	if (InstanceData.Num() > NumInstances)
+	{
+		InstanceData.SetNum(NumInstances);
+	}
+
+	while (InstanceData.Num() < NumInstances)
+	{
+		InstanceData.Add(DefaultInstanceData);
+	}
+}
+
+// Called when the game starts or when spawned
+void AExplosiveField::BeginPlay()
+{
+	Super::BeginPlay();
+
+	const int32 NumInstances{ ExplosiveInstances->GetInstanceCount() };
+
+	InstanceData.SetNum(NumInstances);
+	InstanceIds.SetNumUninitialized(NumInstances);
+	InstanceLocations.SetNumUninitialized(NumInstances);
+	PendingInstances.Init(false, NumInstances);
+	InstanceIndices.Empty(NumInstances);
+
+	for (int32 i = 0; i < NumInstances; i++)
+	{
+		FTransform InstanceTransform;
+		ExplosiveInstances->GetInstanceTransform(i, InstanceTransform, true);
+
+		InstanceIds[i] = NextInstanceId++;
+		InstanceIndices.Add(InstanceIds[i], i);
+		InstanceLocations[i] = InstanceTransform.GetLocation();
+		InstanceBounds += InstanceLocations[i];
+	}
+
+	if (UDetonationQueueSubsystem* DetonationQueue = GetWorld()->GetSubsystem<UDetonationQueueSubsystem>())
+	{
+		DetonationQueue->RegisterExplosiveField(this);
+	}
+}
+
+void AExplosiveField::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UDetonationQueueSubsystem* DetonationQueue = GetWorld()->GetSubsystem<UDetonationQueueSubsystem>())
+	{
+		DetonationQueue->UnregisterExplosiveField(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AExplosiveField::BulletHit_Implementation(FHitResult HitResult, AActor* Shooter, AController* ShooterController)
+{
+	// Hits on an instanced component carry the instance index in Item
+	const int32 InstanceIndex{ HitResult.Item };
+
+	if (HitResult.GetComponent() != ExplosiveInstances || !InstanceIds.IsValidIndex(InstanceIndex))
+	{
+		return;
+	}
+
+	if (ImpactSFX && !ShooterCosmetics::AreStripped())
+	{
+		UGameplayStatics::PlaySoundAtLocation(this, ImpactSFX, InstanceLocations[InstanceIndex]);
+	}
+
+	// A bullet always sets the barrel off right away, even if a chain reaction already scheduled it
+	DetonateInstance(InstanceIndex, HitResult.Location, Shooter, ShooterController);
+}
+
+void AExplosiveField::DetonateFromChain(int32 InstanceId, AActor* Shooter, AController* ShooterController)
+{
+	const int32 InstanceIndex{ FindInstanceIndex(InstanceId) };
+
+	if (InstanceIndex != INDEX_NONE)
+	{
+		DetonateInstance(InstanceIndex, InstanceLocations[InstanceIndex], Shooter, ShooterController);
+	}
+}
+
+void AExplosiveField::DetonateInstance(int32 InstanceIndex, const FVector& VFXLocation, AActor* Shooter, AController* ShooterController)
+{
+	const FVector Origin{ InstanceLocations[InstanceIndex] };
+	const FExplosiveInstanceData Data{ InstanceData[InstanceIndex] };
+
+	// Remove first so the blast does not find the barrel that is going off
+	RemoveInstance(InstanceIndex);
+
+	UDetonationQueueSubsystem* DetonationQueue{ GetWorld()->GetSubsystem<UDetonationQueueSubsystem>() };
+
+	if (!ShooterCosmetics::AreStripped())
+	{
+		if (DetonationQueue)
+		{
+			// Budgeted; effects over the frame budget are spawned on the next frames
+			DetonationQueue->RequestVFX(ExplodeVFX, VFXLocation);
+		}
+		else if (ExplodeVFX)
+		{
+			UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), ExplodeVFX, VFXLocation, FRotator(0.f), true);
+		}
+
+		if (ExplodeSFX)
+		{
+			UGameplayStatics::PlaySoundAtLocation(this, ExplodeSFX, Origin);
+		}
+	}
+
+	FExplosionBlast Blast;
+	Blast.Origin = Origin;
+	Blast.Radius = Data.Radius;
+	Blast.Damage = Data.Damage;
+	Blast.DamageInnerRadius = DamageInnerRadius;
+	Blast.MinimumDamageScale = MinimumDamageScale;
+	Blast.DamageFalloff = DamageFalloff;
+	Blast.RadialImpulse = RadialImpulse;
+	Blast.OcclusionChannel = OcclusionChannel;
+	Blast.ExplodingActor = this;
+	Blast.Shooter = Shooter;
+	Blast.ShooterController = ShooterController;
+
+	Blast.Resolve(GetWorld());
+}
+
+void AExplosiveField::RemoveInstance(int32 InstanceIndex)
+{
+	const int32 LastIndex{ InstanceIds.Num() - 1 };
+
+	// The 4.26 hierarchical component moves its last instance into the hole; mirror that
+	ExplosiveInstances->RemoveInstance(InstanceIndex);
+
+	InstanceIndices.Remove(InstanceIds[InstanceIndex]);
+
+	if (InstanceIndex < LastIndex)
+	{
+		InstanceIndices.Add(InstanceIds[LastIndex], InstanceIndex);
+	}
+
+	InstanceIds.RemoveAtSwap(InstanceIndex, 1, false);
+	InstanceLocations.RemoveAtSwap(InstanceIndex, 1, false);
+	InstanceData.RemoveAtSwap(InstanceIndex, 1, false);
+
+	PendingInstances[InstanceIndex] = PendingInstances[LastIndex];
+	PendingInstances.RemoveAt(LastIndex);
+}
+
+int32 AExplosiveField::FindInstanceIndex(int32 InstanceId) const
+{
+	const int32* InstanceIndex{ InstanceIndices.Find(InstanceId) };
+
+	return InstanceIndex ? *InstanceIndex : INDEX_NONE;
+}
+
+void AExplosiveField::GatherInstancesInRadius(const FVector& Origin, float Radius, TArray<FDetonationTarget>& OutTargets) const
+{
+	if (InstanceIds.Num() == 0 || !InstanceBounds.ExpandBy(Radius).IsInside(Origin))
+	{
+		return;
+	}
+
+	const float RadiusSquared{ Radius * Radius };
+
+	for (int32 i = 0; i < InstanceLocations.Num(); i++)
+	{
+		if (!PendingInstances[i] && FVector::DistSquared(Origin, InstanceLocations[i]) <= RadiusSquared)
+		{
+			FDetonationTarget Target;
+			Target.Owner = const_cast<AExplosiveField*>(this);
+			Target.InstanceId = InstanceIds[i];
+			Target.Location = InstanceLocations[i];
+
+			OutTargets.Add(Target);
+		}
+	}
+}
+
+bool AExplosiveField::DamageInstance(int32 InstanceId, float Damage)
+{
+	const int32 InstanceIndex{ FindInstanceIndex(InstanceId) };
+
+	if (InstanceIndex == INDEX_NONE || PendingInstances[InstanceIndex])
+	{
+		return false;
+	}
+
+	InstanceData[InstanceIndex].Health -= Damage;
+
+	return InstanceData[InstanceIndex].Health <= 0.f;
+}
+
+bool AExplosiveField::MarkInstancePending(int32 InstanceId)
+{
+	const int32 InstanceIndex{ FindInstanceIndex(InstanceId) };
+
+	if (InstanceIndex == INDEX_NONE || PendingInstances[InstanceIndex])
+	{
+		return false;
+	}
+
+	PendingInstances[InstanceIndex] = true;
+
+	return true;
+}
+
+#if WITH_EDITOR
+void AExplosiveField::GatherExplosives()
+{
+	UWorld* World{ GetWorld() };
+
+	if (World == nullptr)
+	{
+		return;
+	}
+
+	Modify();
+	ExplosiveInstances->Modify();
+
+	TArray<AExplosive*> Gathered;
+
+	for (TActorIterator<AExplosive> It(World); It; ++It)
+	{
+		AExplosive* Explosive{ *It };
+		UStaticMesh* Mesh{ Explosive->GetExplosiveMesh()->GetStaticMesh() };
+
+		if (Mesh == nullptr)
+		{
+			continue;
+		}
+
+		// The first explosive decides the mesh, effects and falloff of an empty field
+		if (ExplosiveInstances->GetStaticMesh() == nullptr)
+		{
+			ExplosiveInstances->SetStaticMesh(Mesh);
+			ExplodeVFX = Explosive->GetExplodeVFX();
+			ExplodeSFX = Explosive->GetExplodeSFX();
+			ImpactSFX = Explosive->GetImpactSFX();
+			DamageInnerRadius = Explosive->GetDamageInnerRadius();
+			MinimumDamageScale = Explosive->GetMinimumDamageScale();
+			DamageFalloff = Explosive->GetDamageFalloff();
+			RadialImpulse = Explosive->GetRadialImpulse();
+			OcclusionChannel = Explosive->GetOcclusionChannel();
+		}
+		else if (ExplosiveInstances->GetStaticMesh() != Mesh)
+		{
+			continue;
+		}
+
+		ExplosiveInstances->AddInstanceWorldSpace(Explosive->GetExplosiveMesh()->GetComponentTransform());
+
+		FExplosiveInstanceData Data{ DefaultInstanceData };
+		Data.Damage = Explosive->GetDamage();
+		Data.Radius = Explosive->GetBlastRadius();
+		InstanceData.Add(Data);
+
+		Gathered.Add(Explosive);
+	}
+
+	for (AExplosive* Explosive : Gathered)
+	{
+		World->EditorDestroyActor(Explosive, true);
+	}
+}
+#endif
@@ -0,0 +1,491 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FlowFieldSubsystem.h"
+#include "NavigationSystem.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+#include "../Shooter.h"
+
+DECLARE_CYCLE_STAT(TEXT("Flow Field Tick"), STAT_FlowFieldTick, STATGROUP_Shooter);
+DECLARE_CYCLE_STAT(TEXT("Flow Field Build"), STAT_FlowFieldBuild, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Flow Field Probes"), STAT_FlowFieldProbes, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Flow Field Builds"), STAT_FlowFieldBuilds, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Flow Field Probed Cells"), STAT_FlowFieldProbedCells, STATGROUP_Shooter);
+
+static TAutoConsoleVariable<int32> CVarFlowFieldEnabled(
+	TEXT("Shooter.FlowField.Enabled"),
+	1,
+	TEXT("When 0, no flow fields are built and chasing enemies use regular pathfinding."));
+
+static TAutoConsoleVariable<float> CVarFlowFieldCellSize(
+	TEXT("Shooter.FlowField.CellSize"),
+	100.f,
+	TEXT("Size of a flow field cell in world units. Changing it clears the probed cells."));
+
+static TAutoConsoleVariable<int32> CVarFlowFieldHalfExtent(
+	TEXT("Shooter.FlowField.HalfExtent"),
+	40,
+	TEXT("Number of cells the field reaches from the player in each direction."));
+
+static TAutoConsoleVariable<int32> CVarFlowFieldProbesPerFrame(
+	TEXT("Shooter.FlowField.ProbesPerFrame"),
+	128,
+	TEXT("Navmesh projections used per frame to find walkable cells."));
+
+static TAutoConsoleVariable<float> CVarFlowFieldRebuildInterval(
+	TEXT("Shooter.FlowField.RebuildInterval"),
+	0.2f,
+	TEXT("Minimum time in seconds between two builds of the same field."));
+
+static TAutoConsoleVariable<float> CVarFlowFieldMaxStepHeight(
+	TEXT("Shooter.FlowField.MaxStepHeight"),
+	50.f,
+	TEXT("Largest height difference between two neighbouring cells that still connects them."));
+
+static TAutoConsoleVariable<float> CVarFlowFieldProbeHeight(
+	TEXT("Shooter.FlowField.ProbeHeight"),
+	200.f,
+	TEXT("Vertical extent of the navmesh projection of a cell, and the height of the bands cells are cached in."));
+
+namespace
+{
+	/** The eight neighbours of a cell; straight ones first */
+	const FIntPoint NeighbourOffsets[8]{ { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+
+	/** Index of the offset pointing the other way */
+	const uint8 OppositeNeighbour[8]{ 1, 0, 3, 2, 7, 6, 5, 4 };
+
+	/** Probed cells kept per target, in windows; older ones are dropped beyond that */
+	constexpr int32 MaxProbedWindowsPerTarget{ 4 };
+
+	/** A cell waiting to be expanded by the search */
+	struct FOpenCell
+	{
+		float Cost;
+		int32 Index;
+
+		bool operator<(const FOpenCell& Other) const { return Cost < Other.Cost; }
+	};
+}
+
+TSharedPtr<FFlowField, ESPMode::ThreadSafe> FFlowField::Build(const FFlowFieldBuildInput& Input, float CellSize)
+{
+	SCOPE_CYCLE_COUNTER(STAT_FlowFieldBuild);
+
+	const int32 Size{ Input.Size };
+	const int32 NumCells{ Size * Size };
+
+	TSharedPtr<FFlowField, ESPMode::ThreadSafe> Field{ MakeShared<FFlowField, ESPMode::ThreadSafe>() };
+	Field->MinCell = Input.MinCell;
+	Field->Size = Size;
+	Field->CellSize = CellSize;
+	Field->Directions.Init(FlowField::NoDirection, NumCells);
+
+	const FIntPoint Target{ Input.TargetCell - Input.MinCell };
+
+	if (Target.X < 0 || Target.Y < 0 || Target.X >= Size || Target.Y >= Size || Input.Heights.Num() != NumCells)
+	{
+		return Field;
+	}
+
+	TArray<float> Costs;
+	Costs.Init(MAX_flt, NumCells);
+
+	const int32 TargetIndex{ Target.Y * Size + Target.X };
+	Costs[TargetIndex] = 0.f;
+	Field->Directions[TargetIndex] = FlowField::TargetDirection;
+
+	TArray<FOpenCell> Open;
+	Open.HeapPush({ 0.f, TargetIndex });
+
+	auto IsWalkable = [&Input, Size](int32 X, int32 Y)
+	{
+		return X >= 0 && Y >= 0 && X < Size && Y < Size && Input.Heights[Y * Size + X] != FlowField::BlockedHeight;
+	};
+
+	while (Open.Num() > 0)
+	{
+		FOpenCell Current;
+		Open.HeapPop(Current, false);
+
+		// Stale entry; the cell was reached more cheaply since it was pushed
+		if (Current.Cost > Costs[Current.Index])
+		{
+			continue;
+		}
+
+		const int32 X{ Current.Index % Size };
+		const int32 Y{ Current.Index / Size };
+		const float Height{ Input.Heights[Current.Index] };
+
+		for (int32 i = 0; i < 8; i++)
+		{
+			const FIntPoint& Offset{ NeighbourOffsets[i] };
+			const int32 NeighbourX{ X + Offset.X };
+			const int32 NeighbourY{ Y + Offset.Y };
+
+			if (!IsWalkable(NeighbourX, NeighbourY))
+			{
+				continue;
+			}
+
+			const bool bIsDiagonal{ Offset.X != 0 && Offset.Y != 0 };
+
+			// Do not cut corners around walls
+			if (bIsDiagonal && (!IsWalkable(X + Offset.X, Y) || !IsWalkable(X, Y + Offset.Y)))
+			{
+				continue;
+			}
+
+			const int32 NeighbourIndex{ NeighbourY * Size + NeighbourX };
+
+			// The target may stand just off the navmesh; its cell connects to anything next to it
+			if (Height != FlowField::BlockedHeight && FMath::Abs(Input.Heights[NeighbourIndex] - Height) > Input.MaxStepHeight)
+			{
+				continue;
+			}
+
+			const float Cost{ Current.Cost + (bIsDiagonal ? 1.4142136f : 1.f) };
+
+			if (Cost < Costs[NeighbourIndex])
+			{
+				Costs[NeighbourIndex] = Cost;
+				Field->Directions[NeighbourIndex] = OppositeNeighbour[i];
+				Open.HeapPush({ Cost, NeighbourIndex });
+			}
+		}
+	}
+
+	return Field;
+}
+
+void UFlowFieldSubsystem::Deinitialize()
+{
+	// Builds in flight only hold copies of their input, but finish them before the world goes away
+	for (FFlowFieldTarget& FlowTarget : Targets)
+	{
+		if (FlowTarget.PendingBuild.IsValid())
+		{
+			FlowTarget.PendingBuild.Wait();
+		}
+	}
+
+	Targets.Empty();
+
+	if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+	{
+		NavSys->OnNavigationGenerationFinishedDelegate.RemoveDynamic(this, &UFlowFieldSubsystem::OnNavigationGenerationFinished);
+	}
+
+	Super::Deinitialize();
+}
+
+void UFlowFieldSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_FlowFieldTick);
+
+	// Only servers and standalone games move enemies
+	if (CVarFlowFieldEnabled.GetValueOnGameThread() == 0 || GetWorld()->GetNetMode() == NM_Client)
+	{
+		return;
+	}
+
+	// The navigation system is created after world subsystems
+	if (!bBoundToNavigation)
+	{
+		if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+		{
+			NavSys->OnNavigationGenerationFinishedDelegate.AddDynamic(this, &UFlowFieldSubsystem::OnNavigationGenerationFinished);
+			bBoundToNavigation = true;
+		}
+	}
+
+	const float CellSize{ FMath::Max(CVarFlowFieldCellSize.GetValueOnGameThread(), 10.f) };
+	const int32 HalfExtent{ FMath::Clamp(CVarFlowFieldHalfExtent.GetValueOnGameThread(), 4, 127) };
+	const float ProbeHeight{ FMath::Max(CVarFlowFieldProbeHeight.GetValueOnGameThread(), 10.f) };
+
+	if (CellSize != CachedCellSize || HalfExtent != CachedHalfExtent || ProbeHeight != CachedProbeHeight)
+	{
+		CachedCellSize = CellSize;
+		CachedHalfExtent = HalfExtent;
+		CachedProbeHeight = ProbeHeight;
+
+		ProbedHeights.Reset();
+
+		ProbeOrder.Reset();
+		for (int32 Y = -HalfExtent; Y <= HalfExtent; Y++)
+		{
+			for (int32 X = -HalfExtent; X <= HalfExtent; X++)
+			{
+				ProbeOrder.Add({ X, Y });
+			}
+		}
+
+		ProbeOrder.Sort([](const FIntPoint& A, const FIntPoint& B)
+			{
+				return A.X * A.X + A.Y * A.Y < B.X * B.X + B.Y * B.Y;
+			});
+
+		for (FFlowFieldTarget& FlowTarget : Targets)
+		{
+			FlowTarget.WindowCenter = FIntPoint(TNumericLimits<int32>::Max(), 0);
+			FlowTarget.Field.Reset();
+		}
+	}
+
+	UpdateTargets();
+	ProbeCells(CellSize, HalfExtent);
+	UpdateBuilds(CellSize, HalfExtent);
+
+	SET_DWORD_STAT(STAT_FlowFieldProbedCells, ProbedHeights.Num());
+}
+
+TStatId UFlowFieldSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFlowFieldSubsystem, STATGROUP_Tickables);
+}
+
+bool UFlowFieldSubsystem::SampleDirection(const AActor* Target, const FVector& Location, FVector& OutDirection) const
+{
+	if (Target == nullptr || CVarFlowFieldEnabled.GetValueOnGameThread() == 0)
+	{
+		return false;
+	}
+
+	for (const FFlowFieldTarget& FlowTarget : Targets)
+	{
+		if (FlowTarget.Target.Get() != Target || !FlowTarget.Field.IsValid())
+		{
+			continue;
+		}
+
+		const FFlowField& Field{ *FlowTarget.Field };
+		const FIntPoint Cell{ GetCell(Location, Field.CellSize) };
+		const FIntPoint Local{ Cell - Field.MinCell };
+
+		if (Local.X < 0 || Local.Y < 0 || Local.X >= Field.Size || Local.Y >= Field.Size)
+		{
+			return false;
+		}
+
+		const uint8 Direction{ Field.Directions[Local.Y * Field.Size + Local.X] };
+
+		if (Direction == FlowField::NoDirection)
+		{
+			return false;
+		}
+
+		if (Direction == FlowField::TargetDirection)
+		{
+			OutDirection = (Target->GetActorLocation() - Location).GetSafeNormal2D();
+			return true;
+		}
+
+		// Steer toward the center of the next cell so enemies converge on the cell path
+		const FIntPoint Next{ Cell + NeighbourOffsets[Direction] };
+		const FVector NextCenter{ (Next.X + 0.5f) * Field.CellSize, (Next.Y + 0.5f) * Field.CellSize, Location.Z };
+
+		OutDirection = (NextCenter - Location).GetSafeNormal2D();
+		return true;
+	}
+
+	return false;
+}
+
+void UFlowFieldSubsystem::UpdateTargets()
+{
+	Targets.RemoveAll([](const FFlowFieldTarget& FlowTarget)
+		{
+			return !FlowTarget.Target.IsValid();
+		});
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APawn* Pawn{ It->IsValid() ? (*It)->GetPawn() : nullptr };
+
+		if (Pawn == nullptr)
+		{
+			continue;
+		}
+
+		const bool bHasField = Targets.ContainsByPredicate([Pawn](const FFlowFieldTarget& FlowTarget)
+			{
+				return FlowTarget.Target.Get() == Pawn;
+			});
+
+		if (!bHasField)
+		{
+			Targets.AddDefaulted_GetRef().Target = Pawn;
+		}
+	}
+}
+
+void UFlowFieldSubsystem::ProbeCells(float CellSize, int32 HalfExtent)
+{
+	UNavigationSystemV1* NavSys{ FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()) };
+
+	if (NavSys == nullptr)
+	{
+		return;
+	}
+
+	int32 ProbeBudget{ CVarFlowFieldProbesPerFrame.GetValueOnGameThread() };
+
+	// Cached cells are cheap to skip, but bound that work as well
+	int32 CheckBudget{ ProbeBudget * 8 };
+
+	const float ProbeHeight{ CachedProbeHeight };
+	const FVector ProbeExtent{ CellSize * 0.5f, CellSize * 0.5f, ProbeHeight };
+
+	for (FFlowFieldTarget& FlowTarget : Targets)
+	{
+		const AActor* Target{ FlowTarget.Target.Get() };
+		const FVector TargetLocation{ Target->GetActorLocation() };
+		const FIntPoint TargetCell{ GetCell(TargetLocation, CellSize) };
+		const int32 TargetLayer{ FMath::FloorToInt(TargetLocation.Z / ProbeHeight) };
+
+		// Recenter the window once the target has walked a quarter of the way to its edge, or changed floor
+		const bool bHasWindow{ FlowTarget.WindowCenter.X != TNumericLimits<int32>::Max() };
+		const FIntPoint FromCenter{ bHasWindow ? TargetCell - FlowTarget.WindowCenter : FIntPoint(0, 0) };
+
+		if (!bHasWindow || FMath::Abs(FromCenter.X) > HalfExtent / 4 || FMath::Abs(FromCenter.Y) > HalfExtent / 4 || TargetLayer != FlowTarget.WindowLayer)
+		{
+			FlowTarget.WindowCenter = TargetCell;
+			FlowTarget.WindowLayer = TargetLayer;
+			FlowTarget.ProbeCursor = 0;
+
+			TrimProbedHeights();
+		}
+
+		// The probe is centered on the band, so a cell gets the same answer whoever probes it
+		const float ProbeZ{ (FlowTarget.WindowLayer + 0.5f) * ProbeHeight };
+
+		while (FlowTarget.ProbeCursor < ProbeOrder.Num() && ProbeBudget > 0 && CheckBudget > 0)
+		{
+			const FIntPoint Cell2D{ FlowTarget.WindowCenter + ProbeOrder[FlowTarget.ProbeCursor++] };
+			const FIntVector Cell{ Cell2D.X, Cell2D.Y, FlowTarget.WindowLayer };
+			CheckBudget--;
+
+			if (ProbedHeights.Contains(Cell))
+			{
+				continue;
+			}
+
+			const FVector CellCenter{ (Cell.X + 0.5f) * CellSize, (Cell.Y + 0.5f) * CellSize, ProbeZ };
+
+			FNavLocation NavLocation;
+			const bool bOnNavmesh{ NavSys->ProjectPointToNavigation(CellCenter, NavLocation, ProbeExtent) };
+
+			ProbedHeights.Add(Cell, bOnNavmesh ? NavLocation.Location.Z : FlowField::BlockedHeight);
+
+			FlowTarget.ProbesSinceBuild++;
+			ProbeBudget--;
+			INC_DWORD_STAT(STAT_FlowFieldProbes);
+		}
+	}
+}
+
+void UFlowFieldSubsystem::UpdateBuilds(float CellSize, int32 HalfExtent)
+{
+	const float Now{ GetWorld()->GetTimeSeconds() };
+	const float RebuildInterval{ CVarFlowFieldRebuildInterval.GetValueOnGameThread() };
+
+	for (FFlowFieldTarget& FlowTarget : Targets)
+	{
+		if (FlowTarget.PendingBuild.IsValid())
+		{
+			if (!FlowTarget.PendingBuild.IsReady())
+			{
+				continue;
+			}
+
+			FlowTarget.Field = FlowTarget.PendingBuild.Get();
+			FlowTarget.PendingBuild.Reset();
+		}
+
+		const FIntPoint TargetCell{ GetCell(FlowTarget.Target->GetActorLocation(), CellSize) };
+		const bool bNeedsBuild{ TargetCell != FlowTarget.BuiltTargetCell || FlowTarget.ProbesSinceBuild > 0 };
+
+		if (bNeedsBuild && Now - FlowTarget.LastBuildTime >= RebuildInterval)
+		{
+			StartBuild(FlowTarget, TargetCell, CellSize, HalfExtent);
+		}
+	}
+}
+
+void UFlowFieldSubsystem::StartBuild(FFlowFieldTarget& FlowTarget, const FIntPoint& TargetCell, float CellSize, int32 HalfExtent)
+{
+	FFlowFieldBuildInput Input;
+	Input.MinCell = FlowTarget.WindowCenter - FIntPoint(HalfExtent, HalfExtent);
+	Input.Size = HalfExtent * 2 + 1;
+	Input.TargetCell = TargetCell;
+	Input.MaxStepHeight = CVarFlowFieldMaxStepHeight.GetValueOnGameThread();
+
+	// Copy the window out of the cache; the worker never touches the map
+	Input.Heights.SetNumUninitialized(Input.Size * Input.Size);
+
+	for (int32 Y = 0; Y < Input.Size; Y++)
+	{
+		for (int32 X = 0; X < Input.Size; X++)
+		{
+			const float* Height{ ProbedHeights.Find(FIntVector(Input.MinCell.X + X, Input.MinCell.Y + Y, FlowTarget.WindowLayer)) };
+			Input.Heights[Y * Input.Size + X] = Height ? *Height : FlowField::BlockedHeight;
+		}
+	}
+
+	FlowTarget.BuiltTargetCell = TargetCell;
+	FlowTarget.ProbesSinceBuild = 0;
+	FlowTarget.LastBuildTime = GetWorld()->GetTimeSeconds();
+
+	FlowTarget.PendingBuild = Async(EAsyncExecution::ThreadPool, [Input = MoveTemp(Input), CellSize]()
+		{
+			return FFlowField::Build(Input, CellSize);
+		});
+
+	INC_DWORD_STAT(STAT_FlowFieldBuilds);
+}
+
+void UFlowFieldSubsystem::OnNavigationGenerationFinished(ANavigationData* NavData)
+{
+	ProbedHeights.Reset();
+
+	for (FFlowFieldTarget& FlowTarget : Targets)
+	{
+		FlowTarget.ProbeCursor = 0;
+	}
+}
+
+FIntPoint UFlowFieldSubsystem::GetCell(const FVector& Location, float CellSize) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+void UFlowFieldSubsystem::TrimProbedHeights()
+{
+	if (ProbedHeights.Num() <= FMath::Max(Targets.Num(), 1) * ProbeOrder.Num() * MaxProbedWindowsPerTarget)
+	{
+		return;
+	}
+
+	for (auto It = ProbedHeights.CreateIterator(); It; ++It)
+	{
+		const FIntVector& Cell{ It.Key() };
+
+		const bool bInWindow = Targets.ContainsByPredicate([&Cell, this](const FFlowFieldTarget& FlowTarget)
+			{
+				return Cell.Z == FlowTarget.WindowLayer
+					&& FMath::Abs(Cell.X - FlowTarget.WindowCenter.X) <= CachedHalfExtent
+					&& FMath::Abs(Cell.Y - FlowTarget.WindowCenter.Y) <= CachedHalfExtent;
+			});
+
+		if (!bInWindow)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	ProbedHeights.Compact();
+}
@@ -4,18 +4,42 @@
 #include "GruxAnimInstance.h"
 #include "Enemy.h"
 
+void FGruxAnimInstanceProxy::Update(float DeltaSeconds)
+{
+	Super::Update(DeltaSeconds);
+
+	if (UGruxAnimInstance* GruxAnimInstance = Cast<UGruxAnimInstance>(GetAnimInstanceObject()))
+	{
+		GruxAnimInstance->NativeThreadSafeUpdateAnimation(DeltaSeconds);
+	}
+}
+
 void UGruxAnimInstance::UpdateAnimationProperties(float DeltaTime)
 {
+	// Everything is updated by NativeUpdateAnimation and the proxy
+}
+
+void UGruxAnimInstance::NativeUpdateAnimation(float DeltaSeconds)
+{
+	Super::NativeUpdateAnimation(DeltaSeconds);
+
 	if (Enemy == nullptr)
 	{
 		Enemy = Cast<AEnemy>(TryGetPawnOwner());
 	}
 
-	if (Enemy)
-	{
-		FVector Velocity{ Enemy->GetVelocity() };
-		Velocity.Z = 0.f;
+	EnemyVelocity = Enemy ? Enemy->GetVelocity() : FVector::ZeroVector;
+}
 
-		Speed = Velocity.Size();
-	}
+void UGruxAnimInstance::NativeThreadSafeUpdateAnimation(float DeltaSeconds)
+{
+	FVector Velocity{ EnemyVelocity };
+	Velocity.Z = 0.f;
+
+	Speed = Velocity.Size();
+}
+
+FAnimInstanceProxy* UGruxAnimInstance::CreateAnimInstanceProxy()
+{
+	return new FGruxAnimInstanceProxy(this);
 }
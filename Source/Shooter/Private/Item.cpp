@@ -10,6 +10,9 @@
 #include "Kismet/GameplayStatics.h"
 #include "Sound/SoundCue.h"
 #include "Curves/CurveVector.h"
+#include "Net/UnrealNetwork.h"
+#include "ShooterReplicationGraph.h"
+#include "ShooterCosmetics.h"
 
 // Sets default values
 AItem::AItem() :
@@ -48,12 +51,31 @@ AItem::AItem() :
 	CollisionBox->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Ignore);
 	CollisionBox->SetCollisionResponseToChannel(ECollisionChannel::ECC_Visibility, ECollisionResponse::ECR_Block);
 
-	PickupWidget = CreateDefaultSubobject<UWidgetComponent>(TEXT("Pick up Widget"));
-	PickupWidget->SetupAttachment(GetRootComponent());
+	if (!ShooterCosmetics::AreStripped())
+	{
+		PickupWidget = CreateDefaultSubobject<UWidgetComponent>(TEXT("Pick up Widget"));
+		PickupWidget->SetupAttachment(GetRootComponent());
+	}
 
 	AreaSphere = CreateDefaultSubobject<USphereComponent>(TEXT("Area sphere"));
 	AreaSphere->SetupAttachment(GetRootComponent());
 	AreaSphere->SetSphereRadius(150.f);
+
+	// Picked up, dropped and interping items are moved by the server
+	bReplicates = true;
+	SetReplicateMovement(true);
+
+	// Pickups lying still cost nothing to replicate until something wakes them
+	NetDormancy = DORM_Initial;
+}
+
+void AItem::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(AItem, ItemState);
+	DOREPLIFETIME(AItem, Character);
+	DOREPLIFETIME_CONDITION(AItem, SlotIndex, COND_OwnerOnly);
 }
 
 // Called when the game starts or when spawned
@@ -88,11 +110,25 @@ void AItem::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	// Handle item interping when in the equipped interping state
-	ItemInterp(DeltaTime);
+	// The flight and the pulse only change how the item looks; the interp timer picks it up either way
+	if (!ShooterCosmetics::AreStripped())
+	{
+		// Handle item interping when in the equipped interping state
+		ItemInterp(DeltaTime);
+
+		// Get curve values from pulsecurve and set dynamic material parameters
+		UpdatePulse();
+	}
+}
+
+void AItem::OnRep_ReplicatedMovement()
+{
+	if (bIsInterping)
+	{
+		return;
+	}
 
-	// Get curve values from pulsecurve and set dynamic material parameters
-	UpdatePulse();
+	Super::OnRep_ReplicatedMovement();
 }
 
 void AItem::OnSphereOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
@@ -184,7 +220,10 @@ void AItem::SetItemProperties(EItemState State)
 		CollisionBox->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
 		break;
 	case EItemState::EIS_EquipInterping:
-		PickupWidget->SetVisibility(false);
+		if (PickupWidget)
+		{
+			PickupWidget->SetVisibility(false);
+		}
 
 		// Set mesh properties
 		ItemMesh->SetSimulatePhysics(false);
@@ -202,7 +241,10 @@ void AItem::SetItemProperties(EItemState State)
 		CollisionBox->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 		break;
 	case EItemState::EIS_PickedUp:
-		PickupWidget->SetVisibility(false);
+		if (PickupWidget)
+		{
+			PickupWidget->SetVisibility(false);
+		}
 
 		// Set mesh properties
 		ItemMesh->SetSimulatePhysics(false);
@@ -220,7 +262,10 @@ void AItem::SetItemProperties(EItemState State)
 		CollisionBox->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 		break;
 	case EItemState::EIS_Equipped:
-		PickupWidget->SetVisibility(false);
+		if (PickupWidget)
+		{
+			PickupWidget->SetVisibility(false);
+		}
 
 		// Set mesh properties
 		ItemMesh->SetSimulatePhysics(false);
@@ -273,13 +318,35 @@ void AItem::FinishInterping()
 		Character->UnHighlightInventorySlot();
 	}
 
+	ResetFlightVisuals();
+}
+
+void AItem::FinishItemFlight()
+{
+	if (!bIsInterping)
+	{
+		return;
+	}
+
+	bIsInterping = false;
+	GetWorldTimerManager().ClearTimer(ItemInterpTimer);
+
+	if (Character)
+	{
+		Character->IncrementInterpLocItemCount(InterpLocIndex, -1);
+	}
+
+	ResetFlightVisuals();
+}
+
+void AItem::ResetFlightVisuals()
+{
 	// Set scale back to normal
 	SetActorScale3D(FVector(1.f));
 
 	DisableGlowMaterial();
 	bCanChangeCustomDepth = true;
 	DisableCustomDepth();
-	
 }
 
 void AItem::ItemInterp(float DeltaTime)
@@ -350,14 +417,14 @@ FVector AItem::GetInterpLocation()
 		return FVector(0.f);
 	}
 
+	// Stripped servers have no interp components
+	const USceneComponent* SceneComp{ Character->GetInterpLocation(ItemType == EItemType::EIT_Ammo ? InterpLocIndex : 0).SceneComp };
+
 	switch (ItemType)
 	{
 	case EItemType::EIT_Ammo:
-		return Character->GetInterpLocation(InterpLocIndex).SceneComp->GetComponentLocation();
-		break;
 	case EItemType::EIT_Weapon:
-		return Character->GetInterpLocation(0).SceneComp->GetComponentLocation();
-		break;
+		return SceneComp ? SceneComp->GetComponentLocation() : GetActorLocation();
 	}
 
 	return FVector();
@@ -449,7 +516,8 @@ void AItem::OnConstruction(const FTransform& Transform)
 			}
 		}
 
-		if (MaterialInstance)
+		// Glow and pulse only; stripped servers keep the plain material
+		if (MaterialInstance && !ShooterCosmetics::AreStripped())
 		{
 			DynamicMaterialInstance = UMaterialInstanceDynamic::Create(MaterialInstance, this);
 			DynamicMaterialInstance->SetVectorParameterValue(TEXT("EmissiveColor"), GlowColor);
@@ -536,7 +604,7 @@ void AItem::PlayEquipSound(bool bForcePlaySound)
 
 void AItem::StartPulseTimer()
 {
-	if (ItemState == EItemState::EIS_PickUp)
+	if (ItemState == EItemState::EIS_PickUp && !ShooterCosmetics::AreStripped())
 	{
 		GetWorldTimerManager().SetTimer(PulseTimer, this, &AItem::ResetPulseTimer, PulseCurveTime);
 	}
@@ -551,6 +619,37 @@ void AItem::SetItemState(EItemState State)
 {
 	ItemState = State;
 	SetItemProperties(State);
+
+	if (HasAuthority())
+	{
+		// Wake up first so the new state is sent before going dormant again
+		SetNetDormancy(State == EItemState::EIS_PickUp ? DORM_DormantAll : DORM_Awake);
+
+		UShooterReplicationGraph::NotifyItemChanged(this);
+	}
+}
+
+void AItem::OnRep_ItemState()
+{
+	SetItemProperties(ItemState);
+
+	// Character arrives in the same update, and its notifies run after all properties are set
+	if (ItemState == EItemState::EIS_EquipInterping && Character && !bIsInterping)
+	{
+		StartItemFlight();
+
+		// Only looks; the server picks the item up when its own timer runs out
+		GetWorldTimerManager().SetTimer(ItemInterpTimer, this, &AItem::FinishItemFlight, ZCurveTime);
+
+		if (Character->IsLocallyControlled())
+		{
+			PlayPickUpSound();
+		}
+	}
+	else if (ItemState != EItemState::EIS_EquipInterping)
+	{
+		FinishItemFlight();
+	}
 }
 
 void AItem::StartItemCurve(AShooterCharacter* Char, bool bForcePlaySound)
@@ -560,34 +659,43 @@ void AItem::StartItemCurve(AShooterCharacter* Char, bool bForcePlaySound)
 		// Store a handle to the Character
 		Character = Char;
 
-		// Get array index in interplocations with the lowest item count
-		InterpLocIndex = Character->GetInterpLocationIndex();
+		if (!ShooterCosmetics::AreStripped())
+		{
+			PlayPickUpSound(bForcePlaySound);
+		}
 
-		// Add 1 to the item count for this interp location struct
-		Character->IncrementInterpLocItemCount(InterpLocIndex, 1);
+		StartItemFlight();
 
-		PlayPickUpSound(bForcePlaySound);
+		SetItemState(EItemState::EIS_EquipInterping);
 
-		// Store initial location of the item
-		ItemInterpStartLocation = GetActorLocation();
+		GetWorldTimerManager().SetTimer(ItemInterpTimer, this, &AItem::FinishInterping, ZCurveTime);
+	}
+}
 
-		bIsInterping = true;
+void AItem::StartItemFlight()
+{
+	// Get array index in interplocations with the lowest item count
+	InterpLocIndex = Character->GetInterpLocationIndex();
 
-		SetItemState(EItemState::EIS_EquipInterping);
+	// Add 1 to the item count for this interp location struct
+	Character->IncrementInterpLocItemCount(InterpLocIndex, 1);
 
-		GetWorldTimerManager().ClearTimer(PulseTimer);
-		GetWorldTimerManager().SetTimer(ItemInterpTimer, this, &AItem::FinishInterping, ZCurveTime);
+	// Store initial location of the item
+	ItemInterpStartLocation = GetActorLocation();
 
-		// Get the initial yaw of the camera
-		const float CameraRotationYaw{ Character->GetFollowCamera()->GetComponentRotation().Yaw };
+	bIsInterping = true;
 
-		// Get the initial yaw of the item
-		const float ItemRotationYaw{ GetActorRotation().Yaw };
+	GetWorldTimerManager().ClearTimer(PulseTimer);
 
-		// Initial Yaw offset between camera and item
-		InterpInitialYawOffset = ItemRotationYaw - CameraRotationYaw;
+	// Get the initial yaw of the camera
+	const float CameraRotationYaw{ Character->GetFollowCamera()->GetComponentRotation().Yaw };
 
-		bCanChangeCustomDepth = false;
-	}
+	// Get the initial yaw of the item
+	const float ItemRotationYaw{ GetActorRotation().Yaw };
+
+	// Initial Yaw offset between camera and item
+	InterpInitialYawOffset = ItemRotationYaw - CameraRotationYaw;
+
+	bCanChangeCustomDepth = false;
 }
 
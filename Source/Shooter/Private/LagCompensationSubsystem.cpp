@@ -0,0 +1,352 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LagCompensationSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "GameFramework/DamageType.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/ParallelFor.h"
+#include "ShooterCharacter.h"
+#include "Enemy.h"
+#include "../Shooter.h"
+
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Record"), STAT_LagCompensationRecord, STATGROUP_Shooter);
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Validate"), STAT_LagCompensationValidate, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rewound Shots"), STAT_RewoundShots, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rewound Hits"), STAT_RewoundHits, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Hitbox Histories"), STAT_HitboxHistories, STATGROUP_Shooter);
+DECLARE_MEMORY_STAT(TEXT("Hitbox History Memory"), STAT_HitboxHistoryMemory, STATGROUP_Shooter);
+
+static TAutoConsoleVariable<int32> CVarRewindEnabled(
+	TEXT("Shooter.Rewind.Enabled"),
+	1,
+	TEXT("1: shots from remote players are checked against where targets were when the client fired. 0: against where they are now."));
+
+static TAutoConsoleVariable<float> CVarRewindMaxTime(
+	TEXT("Shooter.Rewind.MaxTime"),
+	0.5f,
+	TEXT("Farthest back in seconds a client's fire time may be. Clients claiming older shots are clamped to this. Enemies are rewound their interpolation delay on top."));
+
+namespace
+{
+	/** Radius of the sphere around the head bone */
+	constexpr float HeadRadius{ 18.f };
+
+	/** Below this many shots validation stays on the game thread */
+	constexpr int32 MinParallelShots{ 8 };
+}
+
+bool FHitboxHistory::Sample(float Time, FVector& OutLocation, FVector& OutHeadLocation) const
+{
+	if (Num == 0)
+	{
+		return false;
+	}
+
+	const int32 Newest{ (Head + LagCompensation::HistoryLength - 1) % LagCompensation::HistoryLength };
+	const FHitboxSnapshot* Newer{ &Snapshots[Newest] };
+
+	for (int32 Age = 1; Age < Num && Time < Newer->Time; Age++)
+	{
+		const FHitboxSnapshot& Older{ Snapshots[(Newest - Age + LagCompensation::HistoryLength) % LagCompensation::HistoryLength] };
+
+		if (Older.Time <= Time)
+		{
+			const float Alpha{ (Time - Older.Time) / FMath::Max(Newer->Time - Older.Time, KINDA_SMALL_NUMBER) };
+
+			OutLocation = FMath::Lerp(Older.Location, Newer->Location, Alpha);
+			OutHeadLocation = FMath::Lerp(Older.HeadLocation, Newer->HeadLocation, Alpha);
+			return true;
+		}
+
+		Newer = &Older;
+	}
+
+	// Newer than the last tick or older than the history: the closest snapshot is the best we have
+	OutLocation = Newer->Location;
+	OutHeadLocation = Newer->HeadLocation;
+	return true;
+}
+
+void ULagCompensationSubsystem::Tick(float DeltaTime)
+{
+	if (!IsServing())
+	{
+		PendingShots.Reset();
+		return;
+	}
+
+	RecordSnapshots();
+
+	if (PendingShots.Num() > 0)
+	{
+		ValidateShots(PendingShots, Results);
+
+		if (bRecordLatencies)
+		{
+			const float Now{ GetWorld()->GetTimeSeconds() };
+
+			for (const FRewindShot& Shot : PendingShots)
+			{
+				Latencies.Add(FMath::Max(Now - Shot.ClientTime, 0.f));
+			}
+		}
+
+		ApplyResults();
+	}
+}
+
+TStatId ULagCompensationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(ULagCompensationSubsystem, STATGROUP_Tickables);
+}
+
+void ULagCompensationSubsystem::RegisterCharacter(ACharacter* Character, FName HeadBone)
+{
+	if (Character == nullptr || !IsServing())
+	{
+		return;
+	}
+
+	FHitboxHistory& History{ Histories.AddDefaulted_GetRef() };
+	History.Character = Character;
+	History.HeadBone = HeadBone;
+	History.CapsuleRadius = Character->GetCapsuleComponent()->GetScaledCapsuleRadius();
+	History.CapsuleHalfHeight = Character->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+	History.DisplayDelay = 0.f;
+	History.Head = 0;
+	History.Num = 0;
+
+	INC_DWORD_STAT(STAT_HitboxHistories);
+	SET_MEMORY_STAT(STAT_HitboxHistoryMemory, Histories.GetAllocatedSize());
+}
+
+void ULagCompensationSubsystem::UnregisterCharacter(ACharacter* Character)
+{
+	const int32 Index{ Histories.IndexOfByPredicate([Character](const FHitboxHistory& History) { return History.Character.Get() == Character; }) };
+
+	if (Index != INDEX_NONE)
+	{
+		Histories.RemoveAtSwap(Index);
+		DEC_DWORD_STAT(STAT_HitboxHistories);
+		SET_MEMORY_STAT(STAT_HitboxHistoryMemory, Histories.GetAllocatedSize());
+	}
+}
+
+void ULagCompensationSubsystem::QueueShot(AShooterCharacter* Shooter, const FVector& Start, const FVector& Direction, float ClientTime, float Range, float Damage, float HeadShotDamage)
+{
+	const float Now{ GetWorld()->GetTimeSeconds() };
+
+	FRewindShot& Shot{ PendingShots.AddDefaulted_GetRef() };
+	Shot.Shooter = Shooter;
+	Shot.ShooterHistory = Histories.IndexOfByPredicate([Shooter](const FHitboxHistory& History) { return History.Character.Get() == Shooter; });
+	Shot.Start = Start;
+	Shot.Direction = Direction;
+	Shot.Time = FMath::Clamp(ClientTime, Now - CVarRewindMaxTime.GetValueOnGameThread(), Now);
+	Shot.ClientTime = ClientTime;
+	Shot.Damage = Damage;
+	Shot.HeadShotDamage = HeadShotDamage;
+
+	// Walls have not moved since the shot, so they are tested now and only characters are rewound
+	FHitResult WorldHit;
+	FCollisionQueryParams QueryParams;
+	QueryParams.AddIgnoredActor(Shooter);
+
+	const bool bBlocked{ GetWorld()->LineTraceSingleByObjectType(WorldHit, Start, Start + Direction * Range, FCollisionObjectQueryParams(ECollisionChannel::ECC_WorldStatic), QueryParams) };
+
+	Shot.MaxDistance = bBlocked ? WorldHit.Distance : Range;
+}
+
+void ULagCompensationSubsystem::ValidateShots(const TArray<FRewindShot>& Shots, TArray<FRewindResult>& OutResults) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_LagCompensationValidate);
+
+	OutResults.SetNum(Shots.Num());
+
+	// Shots only read the histories, so each one is tested on its own worker
+	ParallelFor(Shots.Num(), [this, &Shots, &OutResults](int32 Index)
+		{
+			OutResults[Index] = ValidateShot(Shots[Index]);
+		}, Shots.Num() < MinParallelShots);
+
+	INC_DWORD_STAT_BY(STAT_RewoundShots, Shots.Num());
+}
+
+void ULagCompensationSubsystem::SetRecordLatencies(bool bRecord)
+{
+	bRecordLatencies = bRecord;
+
+	if (!bRecord)
+	{
+		Latencies.Empty();
+	}
+}
+
+void ULagCompensationSubsystem::TakeLatencies(TArray<float>& OutLatencies)
+{
+	OutLatencies.Append(Latencies);
+	Latencies.Reset();
+}
+
+bool ULagCompensationSubsystem::IsRewindEnabled() const
+{
+	return CVarRewindEnabled.GetValueOnGameThread() != 0 && IsServing();
+}
+
+bool ULagCompensationSubsystem::IsServing() const
+{
+	const ENetMode NetMode{ GetWorld()->GetNetMode() };
+
+	return NetMode == NM_DedicatedServer || NetMode == NM_ListenServer;
+}
+
+void ULagCompensationSubsystem::RecordSnapshots()
+{
+	SCOPE_CYCLE_COUNTER(STAT_LagCompensationRecord);
+
+	const float Now{ GetWorld()->GetTimeSeconds() };
+
+	for (FHitboxHistory& History : Histories)
+	{
+		const ACharacter* Character{ History.Character.Get() };
+
+		if (Character == nullptr)
+		{
+			continue;
+		}
+
+		// Enemies are interpolated between snapshots, so clients aim at where they were a little earlier
+		if (const AEnemy* Enemy = Cast<AEnemy>(Character))
+		{
+			History.DisplayDelay = Enemy->GetClientInterpolationDelay();
+		}
+
+		FHitboxSnapshot& Snapshot{ History.Snapshots[History.Head] };
+		Snapshot.Time = Now;
+		Snapshot.Location = Character->GetActorLocation();
+		Snapshot.HeadLocation = History.HeadBone.IsNone() ? Snapshot.Location : Character->GetMesh()->GetSocketLocation(History.HeadBone);
+
+		History.Head = (History.Head + 1) % LagCompensation::HistoryLength;
+		History.Num = FMath::Min(History.Num + 1, LagCompensation::HistoryLength);
+	}
+}
+
+FRewindResult ULagCompensationSubsystem::ValidateShot(const FRewindShot& Shot) const
+{
+	FRewindResult Result;
+
+	const FVector End{ Shot.Start + Shot.Direction * Shot.MaxDistance };
+	float ClosestDistance{ Shot.MaxDistance };
+
+	for (int32 Index = 0; Index < Histories.Num(); Index++)
+	{
+		const FHitboxHistory& History{ Histories[Index] };
+		FVector Location;
+		FVector HeadLocation;
+
+		if (Index == Shot.ShooterHistory || !History.Sample(Shot.Time - History.DisplayDelay, Location, HeadLocation))
+		{
+			continue;
+		}
+
+		// The head sits inside the capsule, so it is tested first and wins for this character
+		bool bHeadShot{ false };
+		float Distance{ MAX_flt };
+
+		if (!History.HeadBone.IsNone() && FMath::LineSphereIntersection(Shot.Start, Shot.Direction, Shot.MaxDistance, HeadLocation, HeadRadius))
+		{
+			bHeadShot = true;
+			Distance = ((HeadLocation - Shot.Start) | Shot.Direction) - HeadRadius;
+		}
+		else
+		{
+			const FVector Axis{ 0.f, 0.f, FMath::Max(History.CapsuleHalfHeight - History.CapsuleRadius, 0.f) };
+			FVector OnShot;
+			FVector OnAxis;
+			FMath::SegmentDistToSegmentSafe(Shot.Start, End, Location - Axis, Location + Axis, OnShot, OnAxis);
+
+			const float DistanceSquared{ FVector::DistSquared(OnShot, OnAxis) };
+			const float RadiusSquared{ FMath::Square(History.CapsuleRadius) };
+
+			if (DistanceSquared <= RadiusSquared)
+			{
+				// Step back from the closest approach to where the shot enters the capsule
+				Distance = FVector::Dist(Shot.Start, OnShot) - FMath::Sqrt(RadiusSquared - DistanceSquared);
+			}
+		}
+
+		if (Distance < ClosestDistance)
+		{
+			ClosestDistance = Distance;
+			Result.History = Index;
+			Result.bHeadShot = bHeadShot;
+			Result.Location = Shot.Start + Shot.Direction * FMath::Max(Distance, 0.f);
+		}
+	}
+
+	return Result;
+}
+
+void ULagCompensationSubsystem::ApplyResults()
+{
+	// Damage can kill and unregister characters, which reorders the histories
+	TArray<TPair<TWeakObjectPtr<ACharacter>, int32>, TInlineAllocator<16>> Hits;
+
+	for (int32 Index = 0; Index < Results.Num(); Index++)
+	{
+		if (Results[Index].History != INDEX_NONE)
+		{
+			Hits.Emplace(Histories[Results[Index].History].Character, Index);
+		}
+	}
+
+	for (const TPair<TWeakObjectPtr<ACharacter>, int32>& Hit : Hits)
+	{
+		// Players stop the shot but, as with SendBullet, only enemies take damage
+		AEnemy* Victim{ Cast<AEnemy>(Hit.Key.Get()) };
+		const FRewindShot& Shot{ PendingShots[Hit.Value] };
+		AShooterCharacter* Shooter{ Shot.Shooter.Get() };
+
+		if (Victim && Shooter)
+		{
+			const float Damage{ Results[Hit.Value].bHeadShot ? Shot.HeadShotDamage : Shot.Damage };
+			UGameplayStatics::ApplyDamage(Victim, Damage, Shooter->GetController(), Shooter, UDamageType::StaticClass());
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_RewoundHits, Hits.Num());
+
+	PendingShots.Reset();
+	Results.Reset();
+}
+
+namespace
+{
+	void ReportLagCompensation(const TArray<FString>& Args, UWorld* World)
+	{
+		const ULagCompensationSubsystem* LagCompensation{ World ? World->GetSubsystem<ULagCompensationSubsystem>() : nullptr };
+
+		if (LagCompensation == nullptr)
+		{
+			return;
+		}
+
+		const int32 NumHistories{ LagCompensation->GetNumHistories() };
+		const float DeltaSeconds{ FMath::Max(World->GetDeltaSeconds(), KINDA_SMALL_NUMBER) };
+
+		UE_LOG(LogShooter, Display, TEXT("Hitbox history: %d snapshots of %d bytes, %d bytes per character"),
+			LagCompensation::HistoryLength, static_cast<int32>(sizeof(FHitboxSnapshot)), static_cast<int32>(sizeof(FHitboxHistory)));
+
+		UE_LOG(LogShooter, Display, TEXT("%d characters, %.1f KB in total, covering %.2f s at the current %.0f Hz tick"),
+			NumHistories, NumHistories * sizeof(FHitboxHistory) / 1024.f, LagCompensation::HistoryLength * DeltaSeconds, 1.f / DeltaSeconds);
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs ReportLagCompensationCommand(
+		TEXT("Shooter.Rewind.Report"),
+		TEXT("Logs the size of the hitbox history kept per character for rewinding shots."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&ReportLagCompensation));
+}
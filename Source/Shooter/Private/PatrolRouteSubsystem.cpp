@@ -0,0 +1,135 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PatrolRouteSubsystem.h"
+#include "NavigationSystem.h"
+#include "GameFramework/Pawn.h"
+#include "../Shooter.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Patrol Path Queries Avoided"), STAT_PatrolPathQueriesAvoided, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Patrol Path Queries"), STAT_PatrolPathQueries, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Patrol Routes"), STAT_PatrolRoutes, STATGROUP_Shooter);
+
+bool UPatrolRouteSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World{ Cast<UWorld>(Outer) };
+
+	return World && World->IsGameWorld();
+}
+
+void UPatrolRouteSubsystem::Deinitialize()
+{
+	if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+	{
+		NavSys->OnNavigationGenerationFinishedDelegate.RemoveDynamic(this, &UPatrolRouteSubsystem::OnNavigationGenerationFinished);
+	}
+
+	Routes.Empty();
+
+	Super::Deinitialize();
+}
+
+void UPatrolRouteSubsystem::RequestRoute(const FVector& Start, const FVector& End, const APawn* Pawn)
+{
+	UNavigationSystemV1* NavSys{ FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()) };
+
+	if (NavSys == nullptr || Pawn == nullptr)
+	{
+		return;
+	}
+
+	if (!bBoundToNavigation)
+	{
+		NavSys->OnNavigationGenerationFinishedDelegate.AddDynamic(this, &UPatrolRouteSubsystem::OnNavigationGenerationFinished);
+		bBoundToNavigation = true;
+	}
+
+	const FRouteKey Key{ MakeKey(Start, End) };
+
+	if (Routes.Contains(Key))
+	{
+		return;
+	}
+
+	const FNavAgentProperties& AgentProperties{ Pawn->GetNavAgentPropertiesRef() };
+	const ANavigationData* NavData{ NavSys->GetNavDataForProps(AgentProperties, Start) };
+
+	if (NavData == nullptr)
+	{
+		return;
+	}
+
+	const FPathFindingQuery Query(Pawn, *NavData, Start, End);
+	const FNavPathQueryDelegate Delegate{ FNavPathQueryDelegate::CreateUObject(this, &UPatrolRouteSubsystem::OnRouteFound, Key) };
+
+	const uint32 QueryId{ NavSys->FindPathAsync(AgentProperties, Query, Delegate, EPathFindingMode::Regular) };
+
+	if (QueryId != INVALID_NAVQUERYID)
+	{
+		Routes.Add(Key).QueryId = QueryId;
+		INC_DWORD_STAT(STAT_PatrolPathQueries);
+	}
+}
+
+FNavPathSharedPtr UPatrolRouteSubsystem::MakeRoutePath(const FVector& Start, const FVector& End) const
+{
+	const FPatrolRoute* Route{ Routes.Find(MakeKey(Start, End)) };
+
+	if (Route == nullptr || Route->QueryId != INVALID_NAVQUERYID || Route->Points.Num() < 2)
+	{
+		return nullptr;
+	}
+
+	// Every mover gets its own path; path following keeps per-path state
+	FNavPathSharedPtr Path{ MakeShareable(new FNavigationPath(Route->Points)) };
+	Path->MarkReady();
+
+	return Path;
+}
+
+void UPatrolRouteSubsystem::NotifyQueryAvoided()
+{
+	NumQueriesAvoided++;
+	INC_DWORD_STAT(STAT_PatrolPathQueriesAvoided);
+}
+
+UPatrolRouteSubsystem::FRouteKey UPatrolRouteSubsystem::MakeKey(const FVector& Start, const FVector& End)
+{
+	// Enemies placed on the same points share a route
+	return FRouteKey(FIntVector(Start.GridSnap(1.f)), FIntVector(End.GridSnap(1.f)));
+}
+
+void UPatrolRouteSubsystem::OnRouteFound(uint32 QueryId, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path, FRouteKey Key)
+{
+	FPatrolRoute* Route{ Routes.Find(Key) };
+
+	// Dropped by a navmesh change while the query was running
+	if (Route == nullptr || Route->QueryId != QueryId)
+	{
+		return;
+	}
+
+	if (Result != ENavigationQueryResult::Success || !Path.IsValid() || Path->IsPartial())
+	{
+		// Let the next request try again
+		Routes.Remove(Key);
+		return;
+	}
+
+	Route->QueryId = INVALID_NAVQUERYID;
+	Route->Points.Reset(Path->GetPathPoints().Num());
+
+	for (const FNavPathPoint& PathPoint : Path->GetPathPoints())
+	{
+		Route->Points.Add(PathPoint.Location);
+	}
+
+	SET_DWORD_STAT(STAT_PatrolRoutes, Routes.Num());
+}
+
+void UPatrolRouteSubsystem::OnNavigationGenerationFinished(ANavigationData* NavData)
+{
+	Routes.Reset();
+
+	SET_DWORD_STAT(STAT_PatrolRoutes, 0);
+}
@@ -8,6 +8,23 @@
 #include "Weapon.h"
 #include "WeaponType.h"
 
+namespace
+{
+	/** Curve names are resolved once instead of every frame */
+	const FName TurningCurveName(TEXT("Turning"));
+	const FName RotationCurveName(TEXT("Rotation"));
+}
+
+void FShooterAnimInstanceProxy::Update(float DeltaSeconds)
+{
+	Super::Update(DeltaSeconds);
+
+	if (UShooterAnimInstance* ShooterAnimInstance = Cast<UShooterAnimInstance>(GetAnimInstanceObject()))
+	{
+		ShooterAnimInstance->NativeThreadSafeUpdateAnimation(DeltaSeconds);
+	}
+}
+
 UShooterAnimInstance::UShooterAnimInstance() :
 	Speed(0.f),
 	bIsInAir(false),
@@ -35,96 +52,121 @@ UShooterAnimInstance::UShooterAnimInstance() :
 
 void UShooterAnimInstance::UpdateAnimationProperties(float DeltaTime)
 {
+	// Everything is updated by NativeUpdateAnimation and the proxy
+}
+
+void UShooterAnimInstance::NativeInitializeAnimation()
+{
+	ShooterCharacter = Cast<AShooterCharacter>(TryGetPawnOwner());
+}
+
+void UShooterAnimInstance::NativeUpdateAnimation(float DeltaSeconds)
+{
+	Super::NativeUpdateAnimation(DeltaSeconds);
+
 	if (ShooterCharacter == nullptr)
 	{
 		ShooterCharacter = Cast<AShooterCharacter>(TryGetPawnOwner());
 	}
 
-	if (ShooterCharacter)
+	Snapshot.bHasCharacter = ShooterCharacter != nullptr;
+
+	if (ShooterCharacter == nullptr)
 	{
-		bIsCrouching = ShooterCharacter->GetCrouching();
-		bIsReloading = ShooterCharacter->GetCombatState() == ECombatState::ECS_Reloading;
-		bIsEquipping = ShooterCharacter->GetCombatState() == ECombatState::ECS_Equipping;
-		bShouldUseFABRIK = ShooterCharacter->GetCombatState() == ECombatState::ECS_Unoccupied || ShooterCharacter->GetCombatState() == ECombatState::ECS_FireTimerInProgress;
+		return;
+	}
 
-		// Get the lateral speed of the character from velocity
-		FVector Velocity{ ShooterCharacter->GetVelocity() };
-		Velocity.Z = 0;
-		Speed = Velocity.Size();
+	// Only copy here; the math runs in NativeThreadSafeUpdateAnimation
+	const UCharacterMovementComponent* CharacterMovement{ ShooterCharacter->GetCharacterMovement() };
+	const AWeapon* EquippedWeapon{ ShooterCharacter->GetEquippedWeapon() };
+
+	Snapshot.Velocity = ShooterCharacter->GetVelocity();
+	Snapshot.AimRotation = ShooterCharacter->GetBaseAimRotation();
+	Snapshot.ActorRotation = ShooterCharacter->GetActorRotation();
+	Snapshot.CombatState = ShooterCharacter->GetCombatState();
+	Snapshot.bHasEquippedWeapon = EquippedWeapon != nullptr;
+	Snapshot.EquippedWeaponType = EquippedWeapon ? EquippedWeapon->GetWeaponType() : Snapshot.EquippedWeaponType;
+	Snapshot.bIsFalling = CharacterMovement->IsFalling();
+	Snapshot.bIsAccelerating = CharacterMovement->GetCurrentAcceleration().Size() > 0.f;
+	Snapshot.bIsAiming = ShooterCharacter->GetIsAiming();
+	Snapshot.bIsCrouching = ShooterCharacter->GetCrouching();
+	Snapshot.TurningCurve = GetCurveValue(TurningCurveName);
+	Snapshot.RotationCurve = GetCurveValue(RotationCurveName);
+}
 
-		// Is the character in air?
-		bIsInAir = ShooterCharacter->GetCharacterMovement()->IsFalling();
+void UShooterAnimInstance::NativeThreadSafeUpdateAnimation(float DeltaSeconds)
+{
+	if (!Snapshot.bHasCharacter)
+	{
+		return;
+	}
 
-		// Is the character accelerating?
-		if (ShooterCharacter->GetCharacterMovement()->GetCurrentAcceleration().Size() > 0.f)
-		{
-			bIsAccelerating = true;
-		}
-		else
-		{
-			bIsAccelerating = false;
-		}
+	bIsCrouching = Snapshot.bIsCrouching;
+	bIsReloading = Snapshot.CombatState == ECombatState::ECS_Reloading;
+	bIsEquipping = Snapshot.CombatState == ECombatState::ECS_Equipping;
+	bShouldUseFABRIK = Snapshot.CombatState == ECombatState::ECS_Unoccupied || Snapshot.CombatState == ECombatState::ECS_FireTimerInProgress;
 
-		FRotator AimRotation = ShooterCharacter->GetBaseAimRotation();
-		FRotator MovementRotation = UKismetMathLibrary::MakeRotFromX(ShooterCharacter->GetVelocity());
+	// Get the lateral speed of the character from velocity
+	FVector Velocity{ Snapshot.Velocity };
+	Velocity.Z = 0;
+	Speed = Velocity.Size();
 
-		MovementOffsetYaw = UKismetMathLibrary::NormalizedDeltaRotator(MovementRotation, AimRotation).Yaw;
+	bIsInAir = Snapshot.bIsFalling;
+	bIsAccelerating = Snapshot.bIsAccelerating;
 
-		if (ShooterCharacter->GetVelocity().Size() > 0.f)
-		{
-			LastMovementOffsetYaw = MovementOffsetYaw;
-		}
+	const FRotator MovementRotation{ UKismetMathLibrary::MakeRotFromX(Snapshot.Velocity) };
 
-		bIsAiming = ShooterCharacter->GetIsAiming();
+	MovementOffsetYaw = UKismetMathLibrary::NormalizedDeltaRotator(MovementRotation, Snapshot.AimRotation).Yaw;
 
-		if (bIsReloading)
-		{
-			OffsetState = EOffsetState::EOS_Reloading;
-		}
-		else if (bIsInAir)
-		{
-			OffsetState = EOffsetState::EOS_InAir;
-		}
-		else if (ShooterCharacter->GetIsAiming())
-		{
-			OffsetState = EOffsetState::EOS_Aiming;
-		}
-		else
-		{
-			OffsetState = EOffsetState::EOS_Hip;
-		}
+	if (Snapshot.Velocity.Size() > 0.f)
+	{
+		LastMovementOffsetYaw = MovementOffsetYaw;
+	}
 
-		// Check if character has an equipped weapon
-		if (ShooterCharacter->GetEquippedWeapon())
-		{
-			EquippedWeaponType = ShooterCharacter->GetEquippedWeapon()->GetWeaponType();
-		}
+	bIsAiming = Snapshot.bIsAiming;
+
+	if (bIsReloading)
+	{
+		OffsetState = EOffsetState::EOS_Reloading;
+	}
+	else if (bIsInAir)
+	{
+		OffsetState = EOffsetState::EOS_InAir;
+	}
+	else if (bIsAiming)
+	{
+		OffsetState = EOffsetState::EOS_Aiming;
+	}
+	else
+	{
+		OffsetState = EOffsetState::EOS_Hip;
+	}
+
+	// Keep the last weapon type while nothing is equipped
+	if (Snapshot.bHasEquippedWeapon)
+	{
+		EquippedWeaponType = Snapshot.EquippedWeaponType;
 	}
-	
+
 	TurnInPlace();
-	Lean(DeltaTime);
+	Lean(DeltaSeconds);
 }
 
-void UShooterAnimInstance::NativeInitializeAnimation()
+FAnimInstanceProxy* UShooterAnimInstance::CreateAnimInstanceProxy()
 {
-	ShooterCharacter = Cast<AShooterCharacter>(TryGetPawnOwner());
+	return new FShooterAnimInstanceProxy(this);
 }
 
 void UShooterAnimInstance::TurnInPlace()
 {
-	if (ShooterCharacter == nullptr)
-	{
-		return;
-	}
-
-	Pitch = ShooterCharacter->GetBaseAimRotation().Pitch;
+	Pitch = Snapshot.AimRotation.Pitch;
 
 	if (Speed > 0 || bIsInAir)
 	{
 		// Do not turn in place when character is moving
 		RootYawOffset = 0.f;
 		TIPCharacterYawLastFrame = TIPCharacterYaw;
-		TIPCharacterYaw = ShooterCharacter->GetActorRotation().Yaw;
+		TIPCharacterYaw = Snapshot.ActorRotation.Yaw;
 
 		RotationCurve = 0.f;
 		RotationCurveLastFrame = 0.f;
@@ -132,7 +174,7 @@ void UShooterAnimInstance::TurnInPlace()
 	else
 	{
 		TIPCharacterYawLastFrame = TIPCharacterYaw;
-		TIPCharacterYaw = ShooterCharacter->GetActorRotation().Yaw;
+		TIPCharacterYaw = Snapshot.ActorRotation.Yaw;
 
 		const float TIPYawDelta{ TIPCharacterYaw - TIPCharacterYawLastFrame };
 
@@ -140,13 +182,13 @@ void UShooterAnimInstance::TurnInPlace()
 		RootYawOffset = UKismetMathLibrary::NormalizeAxis(RootYawOffset - TIPYawDelta);
 
 		// 1.0 if turning, 0.0 if not
-		const float Turning{ GetCurveValue(TEXT("Turning")) };
+		const float Turning{ Snapshot.TurningCurve };
 
 		if (Turning > 0)
 		{
 			bIsTurningInPlace = true;
 			RotationCurveLastFrame = RotationCurve;
-			RotationCurve = GetCurveValue(TEXT("Rotation"));
+			RotationCurve = Snapshot.RotationCurve;
 			const float DeltaRotation{ RotationCurve - RotationCurveLastFrame };
 
 			// Turning left if RootYawOffset > 0 | Turning right if RootYawOffset < 0
@@ -207,13 +249,8 @@ void UShooterAnimInstance::TurnInPlace()
 
 void UShooterAnimInstance::Lean(float DeltaTime)
 {
-	if (ShooterCharacter == nullptr)
-	{
-		return;
-	}
-
 	CharacterRotationLastFrame = CharacterRotation;
-	CharacterRotation = ShooterCharacter->GetActorRotation();
+	CharacterRotation = Snapshot.ActorRotation;
 
 	const FRotator Delta{ UKismetMathLibrary::NormalizedDeltaRotator(CharacterRotation, CharacterRotationLastFrame) };
 
@@ -0,0 +1,801 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShooterBenchmarkSubsystem.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+#include "EngineUtils.h"
+#include "Kismet/GameplayStatics.h"
+#include "GameFramework/PlayerController.h"
+#include "Components/CapsuleComponent.h"
+#include "CoreGlobals.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/DateTime.h"
+#include "HAL/PlatformMisc.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "ShooterCharacter.h"
+#include "Enemy.h"
+#include "EnemyPoolSubsystem.h"
+#include "Item.h"
+#include "Weapon.h"
+#include "Explosive.h"
+#include "ShooterRandomSubsystem.h"
+#include "../Shooter.h"
+
+#if STATS
+#include "Stats/StatsData.h"
+#endif
+
+namespace
+{
+	struct FScenarioInfo
+	{
+		const TCHAR* Name;
+		EBenchmarkScenario Scenario;
+		int32 DefaultCount;
+	};
+
+	const FScenarioInfo ScenarioInfos[]
+	{
+		{ TEXT("EnemiesChasing"), EBenchmarkScenario::EnemiesChasing, 100 },
+		{ TEXT("AutoFireCrowd"), EBenchmarkScenario::AutoFireCrowd, 50 },
+		{ TEXT("LootField"), EBenchmarkScenario::LootField, 300 },
+		{ TEXT("BarrelField"), EBenchmarkScenario::BarrelField, 400 }
+	};
+
+	const FScenarioInfo& GetScenarioInfo(EBenchmarkScenario Scenario)
+	{
+		return ScenarioInfos[static_cast<int32>(Scenario)];
+	}
+
+	/** A metric compared with the baseline, and the smallest growth that is more than noise */
+	struct FBenchmarkMetric
+	{
+		const TCHAR* Path;
+		double MinChange;
+	};
+
+	const FBenchmarkMetric ComparedMetrics[]
+	{
+		{ TEXT("gameThreadMs.avg"), 0.05 },
+		{ TEXT("gameThreadMs.p95"), 0.1 },
+		{ TEXT("allocationsPerFrame"), 10.0 },
+		{ TEXT("spawns"), 1.0 },
+		{ TEXT("memoryGrowthMB"), 1.0 }
+	};
+
+	/** Smallest growth of a cycle stat's average that is more than noise */
+	constexpr double MinStatChangeMs{ 0.02 };
+
+	/** Enemies chasing the player start on a ring this far away */
+	constexpr float ChaseRadiusMin{ 1'200.f };
+	constexpr float ChaseRadiusMax{ 2'400.f };
+
+	/** Distance from the player to the middle of the crowd, and between its enemies */
+	constexpr float CrowdDistance{ 1'500.f };
+	constexpr float CrowdSpacing{ 150.f };
+
+	constexpr float LootSpacing{ 250.f };
+
+	/** Degrees per second the player turns while walking through the loot, so it crosses the field in arcs */
+	constexpr float LootTurnRate{ 20.f };
+
+	constexpr float BarrelDistance{ 1'500.f };
+	constexpr float BarrelSpacing{ 200.f };
+
+	/** How far above and below the player's feet the ground is looked for under spawned content */
+	constexpr float GroundTraceUp{ 500.f };
+	constexpr float GroundTraceDown{ 2'000.f };
+
+	/** Nearest-rank percentile of a sorted array; Fraction 0.95 is p95 */
+	float Percentile(const TArray<float>& Sorted, float Fraction)
+	{
+		if (Sorted.Num() == 0)
+		{
+			return 0.f;
+		}
+
+		return Sorted[FMath::Clamp(FMath::CeilToInt(Fraction * Sorted.Num()) - 1, 0, Sorted.Num() - 1)];
+	}
+
+	TSharedRef<FJsonObject> DistributionToJson(TArray<float> Values)
+	{
+		TSharedRef<FJsonObject> Object{ MakeShared<FJsonObject>() };
+
+		Values.Sort();
+
+		double Sum{ 0.0 };
+		for (float Value : Values)
+		{
+			Sum += Value;
+		}
+
+		Object->SetNumberField(TEXT("avg"), Values.Num() > 0 ? Sum / Values.Num() : 0.0);
+		Object->SetNumberField(TEXT("p50"), Percentile(Values, 0.5f));
+		Object->SetNumberField(TEXT("p95"), Percentile(Values, 0.95f));
+		Object->SetNumberField(TEXT("p99"), Percentile(Values, 0.99f));
+		Object->SetNumberField(TEXT("max"), Values.Num() > 0 ? Values.Last() : 0.f);
+
+		return Object;
+	}
+
+	/** Reads a number by a dotted path like "gameThreadMs.avg" */
+	bool GetMetric(const FJsonObject& Scenario, const FString& Path, double& OutValue)
+	{
+		TArray<FString> Keys;
+		Path.ParseIntoArray(Keys, TEXT("."));
+
+		const FJsonObject* Object{ &Scenario };
+
+		for (int32 Index = 0; Index < Keys.Num() - 1; Index++)
+		{
+			const TSharedPtr<FJsonObject>* Child;
+
+			if (!Object->TryGetObjectField(Keys[Index], Child))
+			{
+				return false;
+			}
+
+			Object = Child->Get();
+		}
+
+		return Keys.Num() > 0 && Object->TryGetNumberField(Keys.Last(), OutValue);
+	}
+
+	/** A class placed in the level, so spawned content has its real meshes and settings */
+	template<class T>
+	TSubclassOf<T> FindLevelClass(UWorld* World)
+	{
+		for (TActorIterator<T> It(World); It; ++It)
+		{
+			return It->GetClass();
+		}
+
+		return nullptr;
+	}
+
+	/** Spawn positions of Count actors in a square grid centered on Center */
+	void GetGridLocations(const FVector& Center, int32 Count, float Spacing, TArray<FVector>& OutLocations)
+	{
+		const int32 Columns{ FMath::CeilToInt(FMath::Sqrt(static_cast<float>(Count))) };
+		const float HalfSize{ (Columns - 1) * Spacing / 2.f };
+
+		for (int32 Index = 0; Index < Count; Index++)
+		{
+			OutLocations.Add(Center + FVector((Index % Columns) * Spacing - HalfSize, (Index / Columns) * Spacing - HalfSize, 0.f));
+		}
+	}
+
+	/**
+	 * Moves each location from the player's height down onto the ground, so loot and barrels do not spend the
+	 * sampled frames falling. Where no ground is found they are left at the player's feet.
+	 */
+	void PlaceOnGround(UWorld* World, const ACharacter* Player, TArray<FVector>& Locations)
+	{
+		const float HalfHeight{ Player->GetCapsuleComponent()->GetScaledCapsuleHalfHeight() };
+
+		FCollisionQueryParams QueryParams;
+		QueryParams.AddIgnoredActor(Player);
+
+		for (FVector& Location : Locations)
+		{
+			const FVector Feet{ Location.X, Location.Y, Location.Z - HalfHeight };
+			FHitResult Ground;
+
+			if (World->LineTraceSingleByChannel(Ground, Feet + FVector(0.f, 0.f, GroundTraceUp), Feet - FVector(0.f, 0.f, GroundTraceDown), ECollisionChannel::ECC_Visibility, QueryParams))
+			{
+				Location = Ground.ImpactPoint;
+			}
+			else
+			{
+				Location = Feet;
+			}
+		}
+	}
+}
+
+bool UShooterBenchmarkSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	FString Scenarios;
+
+	return Super::ShouldCreateSubsystem(Outer) && FParse::Value(FCommandLine::Get(), TEXT("ShooterBenchmark="), Scenarios, false);
+}
+
+void UShooterBenchmarkSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	const TCHAR* CommandLine{ FCommandLine::Get() };
+
+	FString ScenarioList;
+	FParse::Value(CommandLine, TEXT("ShooterBenchmark="), ScenarioList, false);
+
+	TArray<FString> Entries;
+	ScenarioList.ParseIntoArray(Entries, TEXT(","));
+
+	for (const FString& Entry : Entries)
+	{
+		FString Name{ Entry };
+		FString Count;
+		Entry.Split(TEXT(":"), &Name, &Count);
+
+		bool bFound{ false };
+
+		for (const FScenarioInfo& Info : ScenarioInfos)
+		{
+			if (Name == Info.Name || Name == TEXT("All"))
+			{
+				Runs.Add({ Info.Scenario, Count.IsEmpty() ? Info.DefaultCount : FMath::Max(FCString::Atoi(*Count), 1) });
+				bFound = true;
+			}
+		}
+
+		if (!bFound)
+		{
+			UE_LOG(LogShooter, Warning, TEXT("Benchmark: unknown scenario %s"), *Name);
+		}
+	}
+
+	FParse::Value(CommandLine, TEXT("BenchmarkFrames="), Frames);
+	FParse::Value(CommandLine, TEXT("BenchmarkWarmup="), WarmupFrames);
+	FParse::Value(CommandLine, TEXT("BenchmarkTolerance="), Tolerance);
+	FParse::Value(CommandLine, TEXT("BenchmarkBaseline="), BaselineFile);
+
+	if (!FParse::Value(CommandLine, TEXT("BenchmarkOut="), OutputFile))
+	{
+		OutputFile = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / FDateTime::Now().ToString() + TEXT(".json");
+	}
+
+	Frames = FMath::Max(Frames, 1);
+	WarmupFrames = FMath::Max(WarmupFrames, 0);
+
+	ActorSpawnedHandle = GetWorld()->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &UShooterBenchmarkSubsystem::OnActorSpawned));
+}
+
+void UShooterBenchmarkSubsystem::Deinitialize()
+{
+	GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+
+	Super::Deinitialize();
+}
+
+void UShooterBenchmarkSubsystem::Tick(float DeltaTime)
+{
+	switch (Phase)
+	{
+	case EPhase::WaitingForPlayer:
+		Player = Cast<AShooterCharacter>(UGameplayStatics::GetPlayerPawn(GetWorld(), 0));
+
+		if (Runs.Num() == 0)
+		{
+			Phase = EPhase::Finished;
+			FPlatformMisc::RequestExitWithStatus(false, 1);
+		}
+		else if (Player.IsValid() && Player->GetEquippedWeapon())
+		{
+#if STATS
+			// The stats of shown groups are sent back to the game thread every frame
+			GEngine->Exec(GetWorld(), TEXT("stat Shooter"));
+			GEngine->Exec(GetWorld(), TEXT("stat MemoryAllocator"));
+#endif
+
+			StartScenario();
+		}
+		break;
+
+	case EPhase::WarmingUp:
+		DriveScenario();
+
+		if (++FrameInPhase >= WarmupFrames)
+		{
+			Phase = EPhase::Sampling;
+			FrameInPhase = 0;
+			LastFrameTime = FPlatformTime::Seconds();
+			Samples.StartUsedMemory = FPlatformMemory::GetStats().UsedPhysical;
+			Samples.PeakUsedMemory = Samples.StartUsedMemory;
+		}
+		break;
+
+	case EPhase::Sampling:
+		DriveScenario();
+
+		// GGameThreadTime holds the previous frame, so the first sampled frame is skipped
+		if (FrameInPhase > 0)
+		{
+			SampleFrame();
+		}
+
+		if (++FrameInPhase > Frames)
+		{
+			FinishScenario();
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+TStatId UShooterBenchmarkSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterBenchmarkSubsystem, STATGROUP_Tickables);
+}
+
+void UShooterBenchmarkSubsystem::StartScenario()
+{
+	const FBenchmarkScenarioRun& Run{ Runs[RunIndex] };
+
+	// Every scenario starts from the same random numbers, whatever ran before it
+	if (UShooterRandomSubsystem* Random = GetWorld()->GetSubsystem<UShooterRandomSubsystem>())
+	{
+		Random->Reseed(Random->GetSeed());
+	}
+
+	Samples = FBenchmarkScenarioSamples();
+	SetUpScenario(Run);
+
+	Phase = EPhase::WarmingUp;
+	FrameInPhase = 0;
+
+	UE_LOG(LogShooter, Display, TEXT("Benchmark: %s with %d, %d spawned, sampling %d frames"), GetScenarioInfo(Run.Scenario).Name, Run.Count, ScenarioActors.Num(), Frames);
+}
+
+void UShooterBenchmarkSubsystem::FinishScenario()
+{
+	const FBenchmarkScenarioRun& Run{ Runs[RunIndex] };
+
+	Results.Add(ScenarioToJson(Run, Samples));
+
+	if (AShooterCharacter* Character = Player.Get())
+	{
+		Character->BotSetFireButton(false);
+	}
+
+	UEnemyPoolSubsystem* EnemyPool{ GetWorld()->GetSubsystem<UEnemyPoolSubsystem>() };
+
+	// Enemies came from the pool and go back to it, so the next scenario reuses them like the game does
+	for (const TWeakObjectPtr<AActor>& Actor : ScenarioActors)
+	{
+		AEnemy* Enemy{ Cast<AEnemy>(Actor.Get()) };
+
+		if (Enemy && EnemyPool)
+		{
+			EnemyPool->ReleaseEnemy(Enemy);
+		}
+		else if (Actor.IsValid())
+		{
+			Actor->Destroy();
+		}
+	}
+
+	ScenarioActors.Reset();
+
+	if (++RunIndex < Runs.Num())
+	{
+		StartScenario();
+		return;
+	}
+
+	Phase = EPhase::Finished;
+	WriteResults();
+}
+
+void UShooterBenchmarkSubsystem::SetUpScenario(const FBenchmarkScenarioRun& Run)
+{
+	AShooterCharacter* Character{ Player.Get() };
+	UWorld* World{ GetWorld() };
+
+	if (Character == nullptr)
+	{
+		return;
+	}
+
+	// Every run lasts the whole scenario, whatever hits the player
+	Character->SetCanBeDamaged(false);
+
+	const FVector Origin{ Character->GetActorLocation() };
+	const FVector Forward{ Character->GetActorForwardVector().GetSafeNormal2D() };
+
+	UEnemyPoolSubsystem* EnemyPool{ World->GetSubsystem<UEnemyPoolSubsystem>() };
+	const TSubclassOf<AEnemy> EnemyClass{ FindLevelClass<AEnemy>(World) };
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	TArray<FVector> Locations;
+
+	switch (Run.Scenario)
+	{
+	case EBenchmarkScenario::EnemiesChasing:
+		if (EnemyPool == nullptr || EnemyClass == nullptr)
+		{
+			UE_LOG(LogShooter, Warning, TEXT("Benchmark: no enemy placed in the level to spawn more of"));
+			break;
+		}
+
+		for (int32 Index = 0; Index < Run.Count; Index++)
+		{
+			const float Angle{ 2.f * PI * Index / Run.Count };
+			const float Radius{ FMath::Lerp(ChaseRadiusMin, ChaseRadiusMax, static_cast<float>(Index % 4) / 3.f) };
+			const FVector Location{ Origin + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.f) * Radius };
+
+			if (AEnemy* Enemy = EnemyPool->AcquireEnemy(EnemyClass, FTransform((Origin - Location).Rotation(), Location)))
+			{
+				Enemy->ReportTarget(Character);
+				ScenarioActors.Add(Enemy);
+			}
+		}
+
+		ScenarioTarget = Origin + Forward;
+		break;
+
+	case EBenchmarkScenario::AutoFireCrowd:
+		if (EnemyPool == nullptr || EnemyClass == nullptr)
+		{
+			UE_LOG(LogShooter, Warning, TEXT("Benchmark: no enemy placed in the level to spawn more of"));
+			break;
+		}
+
+		ScenarioTarget = Origin + Forward * CrowdDistance;
+		GetGridLocations(ScenarioTarget, Run.Count, CrowdSpacing, Locations);
+
+		for (const FVector& Location : Locations)
+		{
+			if (AEnemy* Enemy = EnemyPool->AcquireEnemy(EnemyClass, FTransform((Origin - Location).Rotation(), Location)))
+			{
+				ScenarioActors.Add(Enemy);
+			}
+		}
+		break;
+
+	case EBenchmarkScenario::LootField:
+	{
+		// Loot lying in the level, or more of the player's own weapon
+		TSubclassOf<AItem> ItemClass{ Character->GetEquippedWeapon()->GetClass() };
+
+		for (TActorIterator<AItem> It(World); It; ++It)
+		{
+			if (It->GetItemState() == EItemState::EIS_PickUp)
+			{
+				ItemClass = It->GetClass();
+				break;
+			}
+		}
+
+		ScenarioTarget = Origin + Forward * (FMath::Sqrt(static_cast<float>(Run.Count)) * LootSpacing / 2.f + LootSpacing);
+		GetGridLocations(ScenarioTarget, Run.Count, LootSpacing, Locations);
+		PlaceOnGround(World, Character, Locations);
+
+		for (const FVector& Location : Locations)
+		{
+			if (AItem* Item = World->SpawnActor<AItem>(ItemClass, Location, FRotator::ZeroRotator, SpawnParams))
+			{
+				ScenarioActors.Add(Item);
+			}
+		}
+		break;
+	}
+
+	case EBenchmarkScenario::BarrelField:
+	{
+		const TSubclassOf<AExplosive> ExplosiveClass{ FindLevelClass<AExplosive>(World) };
+
+		ScenarioTarget = Origin + Forward * BarrelDistance;
+
+		// The first barrel is the one nearest the player, which sets off the rest
+		GetGridLocations(ScenarioTarget, Run.Count, BarrelSpacing, Locations);
+		Locations.Sort([&Origin](const FVector& A, const FVector& B) { return FVector::DistSquared(A, Origin) < FVector::DistSquared(B, Origin); });
+		PlaceOnGround(World, Character, Locations);
+
+		for (const FVector& Location : Locations)
+		{
+			if (AExplosive* Explosive = World->SpawnActor<AExplosive>(ExplosiveClass ? ExplosiveClass : AExplosive::StaticClass(), Location, FRotator::ZeroRotator, SpawnParams))
+			{
+				ScenarioActors.Add(Explosive);
+			}
+		}
+		break;
+	}
+	}
+}
+
+void UShooterBenchmarkSubsystem::DriveScenario()
+{
+	AShooterCharacter* Character{ Player.Get() };
+	APlayerController* PlayerController{ Character ? Cast<APlayerController>(Character->GetController()) : nullptr };
+
+	if (PlayerController == nullptr)
+	{
+		return;
+	}
+
+	const FBenchmarkScenarioRun& Run{ Runs[RunIndex] };
+
+	switch (Run.Scenario)
+	{
+	case EBenchmarkScenario::AutoFireCrowd:
+	{
+		PlayerController->SetControlRotation((ScenarioTarget - Character->GetPawnViewLocation()).Rotation());
+
+		// The magazine is kept full, so firing never stops for a reload
+		AWeapon* Weapon{ Character->GetEquippedWeapon() };
+
+		if (Weapon && Weapon->GetAmmo() == 0)
+		{
+			Weapon->SetAmmo(Weapon->GetMagazineCapacity());
+		}
+
+		// Semi-automatic weapons fire again on every press
+		if (Weapon && !Weapon->GetbCanAuto())
+		{
+			Character->BotSetFireButton(false);
+		}
+
+		Character->BotSetFireButton(true);
+		break;
+	}
+
+	case EBenchmarkScenario::LootField:
+	{
+		FRotator Rotation{ PlayerController->GetControlRotation() };
+		Rotation.Yaw += LootTurnRate * GetWorld()->GetDeltaSeconds();
+
+		PlayerController->SetControlRotation(Rotation);
+		Character->BotMove(1.f, 0.f);
+		break;
+	}
+
+	case EBenchmarkScenario::BarrelField:
+		if (Phase == EPhase::Sampling && FrameInPhase == 0 && ScenarioActors.Num() > 0)
+		{
+			if (AExplosive* Explosive = Cast<AExplosive>(ScenarioActors[0].Get()))
+			{
+				FHitResult HitResult;
+				HitResult.Location = Explosive->GetActorLocation();
+
+				Explosive->BulletHit_Implementation(HitResult, Character, PlayerController);
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void UShooterBenchmarkSubsystem::SampleFrame()
+{
+	const double Now{ FPlatformTime::Seconds() };
+
+	Samples.GameThreadMs.Add(FPlatformTime::ToMilliseconds(GGameThreadTime));
+	Samples.FrameMs.Add((Now - LastFrameTime) * 1'000.0);
+	LastFrameTime = Now;
+
+	Samples.PeakUsedMemory = FMath::Max<uint64>(Samples.PeakUsedMemory, FPlatformMemory::GetStats().UsedPhysical);
+
+#if STATS
+	const FGameThreadStatsData* StatsData{ FLatestGameThreadStatsData::Get().Latest };
+
+	if (StatsData == nullptr)
+	{
+		return;
+	}
+
+	auto AddStat = [this](const FComplexStatMessage& Message, double Value, bool bIsCycle)
+	{
+		FBenchmarkStat& Stat{ Samples.Stats.FindOrAdd(Message.GetShortName().ToString()) };
+		Stat.Sum += Value;
+		Stat.Max = FMath::Max(Stat.Max, Value);
+		Stat.bIsCycle = bIsCycle;
+	};
+
+	for (const FActiveStatGroupInfo& Group : StatsData->ActiveStatGroups)
+	{
+		for (const FComplexStatMessage& Message : Group.FlatAggregate)
+		{
+			AddStat(Message, FPlatformTime::ToMilliseconds(static_cast<uint32>(Message.GetValue_Duration(EComplexStatField::IncAve))), true);
+		}
+
+		for (const FComplexStatMessage& Message : Group.CountersAggregate)
+		{
+			const bool bIsDouble{ Message.NameAndInfo.GetField<EStatDataType>() == EStatDataType::ST_double };
+
+			AddStat(Message, bIsDouble ? Message.GetValue_double(EComplexStatField::IncAve) : Message.GetValue_int64(EComplexStatField::IncAve), false);
+		}
+	}
+#endif
+}
+
+void UShooterBenchmarkSubsystem::OnActorSpawned(AActor* Actor)
+{
+	if (Phase == EPhase::Sampling && Actor)
+	{
+		Samples.Spawns.FindOrAdd(Actor->GetClass()->GetName())++;
+	}
+}
+
+TSharedRef<FJsonObject> UShooterBenchmarkSubsystem::ScenarioToJson(const FBenchmarkScenarioRun& Run, const FBenchmarkScenarioSamples& ScenarioSamples) const
+{
+	TSharedRef<FJsonObject> Scenario{ MakeShared<FJsonObject>() };
+	const int32 SampledFrames{ FMath::Max(ScenarioSamples.GameThreadMs.Num(), 1) };
+
+	Scenario->SetStringField(TEXT("name"), GetScenarioInfo(Run.Scenario).Name);
+	Scenario->SetNumberField(TEXT("count"), Run.Count);
+	Scenario->SetNumberField(TEXT("frames"), ScenarioSamples.GameThreadMs.Num());
+	Scenario->SetObjectField(TEXT("gameThreadMs"), DistributionToJson(ScenarioSamples.GameThreadMs));
+	Scenario->SetObjectField(TEXT("frameMs"), DistributionToJson(ScenarioSamples.FrameMs));
+	Scenario->SetNumberField(TEXT("memoryGrowthMB"), (ScenarioSamples.PeakUsedMemory - ScenarioSamples.StartUsedMemory) / (1024.0 * 1024.0));
+
+	int32 TotalSpawns{ 0 };
+	TSharedRef<FJsonObject> Spawns{ MakeShared<FJsonObject>() };
+
+	for (const TPair<FString, int32>& Spawn : ScenarioSamples.Spawns)
+	{
+		Spawns->SetNumberField(Spawn.Key, Spawn.Value);
+		TotalSpawns += Spawn.Value;
+	}
+
+	Scenario->SetNumberField(TEXT("spawns"), TotalSpawns);
+	Scenario->SetObjectField(TEXT("spawnsByClass"), Spawns);
+
+	TSharedRef<FJsonObject> Stats{ MakeShared<FJsonObject>() };
+
+	for (const TPair<FString, FBenchmarkStat>& Stat : ScenarioSamples.Stats)
+	{
+		TSharedRef<FJsonObject> StatObject{ MakeShared<FJsonObject>() };
+		StatObject->SetNumberField(TEXT("avg"), Stat.Value.Sum / SampledFrames);
+		StatObject->SetNumberField(TEXT("max"), Stat.Value.Max);
+		StatObject->SetBoolField(TEXT("cycle"), Stat.Value.bIsCycle);
+
+		Stats->SetObjectField(Stat.Key, StatObject);
+	}
+
+	Scenario->SetObjectField(TEXT("stats"), Stats);
+
+	// Calls to the allocator per frame, when stats are compiled in
+	const FBenchmarkStat* MallocCalls{ ScenarioSamples.Stats.Find(TEXT("STAT_MallocCalls")) };
+	const FBenchmarkStat* ReallocCalls{ ScenarioSamples.Stats.Find(TEXT("STAT_ReallocCalls")) };
+
+	if (MallocCalls)
+	{
+		Scenario->SetNumberField(TEXT("allocationsPerFrame"), (MallocCalls->Sum + (ReallocCalls ? ReallocCalls->Sum : 0.0)) / SampledFrames);
+	}
+
+	UE_LOG(LogShooter, Display, TEXT("Benchmark: %s with %d: %.3f ms game thread per frame, %d spawns"),
+		GetScenarioInfo(Run.Scenario).Name, Run.Count, Scenario->GetObjectField(TEXT("gameThreadMs"))->GetNumberField(TEXT("avg")), TotalSpawns);
+
+	return Scenario;
+}
+
+void UShooterBenchmarkSubsystem::CompareWithBaseline(const TArray<TSharedPtr<FJsonObject>>& Scenarios, TArray<FString>& OutRegressions) const
+{
+	FString BaselineText;
+	TSharedPtr<FJsonObject> Baseline;
+
+	if (!FFileHelper::LoadFileToString(BaselineText, *BaselineFile) || !FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(BaselineText), Baseline) || !Baseline.IsValid())
+	{
+		UE_LOG(LogShooter, Error, TEXT("Benchmark: could not read the baseline %s"), *BaselineFile);
+		OutRegressions.Add(FString::Printf(TEXT("baseline %s unreadable"), *BaselineFile));
+		return;
+	}
+
+	const TArray<TSharedPtr<FJsonValue>>* BaselineScenarios;
+
+	if (!Baseline->TryGetArrayField(TEXT("scenarios"), BaselineScenarios))
+	{
+		return;
+	}
+
+	const double Growth{ 1.0 + Tolerance / 100.0 };
+
+	for (const TSharedPtr<FJsonObject>& Scenario : Scenarios)
+	{
+		const FString Name{ Scenario->GetStringField(TEXT("name")) };
+		const int32 Count{ static_cast<int32>(Scenario->GetNumberField(TEXT("count"))) };
+
+		const TSharedPtr<FJsonValue>* Match{ BaselineScenarios->FindByPredicate([&Name, Count](const TSharedPtr<FJsonValue>& Value)
+			{
+				const TSharedPtr<FJsonObject> Object{ Value->AsObject() };
+				return Object.IsValid() && Object->GetStringField(TEXT("name")) == Name && static_cast<int32>(Object->GetNumberField(TEXT("count"))) == Count;
+			}) };
+
+		if (Match == nullptr)
+		{
+			UE_LOG(LogShooter, Display, TEXT("Benchmark: %s with %d is not in the baseline"), *Name, Count);
+			continue;
+		}
+
+		const FJsonObject& Old{ *(*Match)->AsObject() };
+
+		auto Compare = [&](const FString& Path, double MinChange)
+		{
+			double OldValue;
+			double NewValue;
+
+			if (GetMetric(Old, Path, OldValue) && GetMetric(*Scenario, Path, NewValue) && NewValue > OldValue * Growth && NewValue - OldValue > MinChange)
+			{
+				OutRegressions.Add(FString::Printf(TEXT("%s %s: %.3f -> %.3f (%+.1f%%)"),
+					*Name, *Path, OldValue, NewValue, OldValue > 0.0 ? (NewValue / OldValue - 1.0) * 100.0 : 100.0));
+			}
+		};
+
+		for (const FBenchmarkMetric& Metric : ComparedMetrics)
+		{
+			Compare(Metric.Path, Metric.MinChange);
+		}
+
+		const TSharedPtr<FJsonObject>* Stats;
+
+		if (Scenario->TryGetObjectField(TEXT("stats"), Stats))
+		{
+			for (const TPair<FString, TSharedPtr<FJsonValue>>& Stat : (*Stats)->Values)
+			{
+				bool bIsCycle{ false };
+
+				if (Stat.Value->AsObject()->TryGetBoolField(TEXT("cycle"), bIsCycle) && bIsCycle)
+				{
+					Compare(FString::Printf(TEXT("stats.%s.avg"), *Stat.Key), MinStatChangeMs);
+				}
+			}
+		}
+	}
+}
+
+void UShooterBenchmarkSubsystem::WriteResults()
+{
+	TSharedRef<FJsonObject> Root{ MakeShared<FJsonObject>() };
+
+	const UShooterRandomSubsystem* Random{ GetWorld()->GetSubsystem<UShooterRandomSubsystem>() };
+
+	Root->SetStringField(TEXT("map"), GetWorld()->GetMapName());
+	Root->SetNumberField(TEXT("seed"), Random ? Random->GetSeed() : 0);
+	Root->SetBoolField(TEXT("fixedStep"), FApp::UseFixedTimeStep());
+	Root->SetNumberField(TEXT("frames"), Frames);
+	Root->SetNumberField(TEXT("warmupFrames"), WarmupFrames);
+
+	TArray<TSharedPtr<FJsonValue>> Scenarios;
+	for (const TSharedPtr<FJsonObject>& Result : Results)
+	{
+		Scenarios.Add(MakeShared<FJsonValueObject>(Result));
+	}
+
+	Root->SetArrayField(TEXT("scenarios"), Scenarios);
+
+	TArray<FString> Regressions;
+
+	if (!BaselineFile.IsEmpty())
+	{
+		CompareWithBaseline(Results, Regressions);
+
+		TArray<TSharedPtr<FJsonValue>> RegressionValues;
+		for (const FString& Regression : Regressions)
+		{
+			UE_LOG(LogShooter, Warning, TEXT("Benchmark regression: %s"), *Regression);
+			RegressionValues.Add(MakeShared<FJsonValueString>(Regression));
+		}
+
+		Root->SetStringField(TEXT("baseline"), BaselineFile);
+		Root->SetNumberField(TEXT("tolerancePercent"), Tolerance);
+		Root->SetArrayField(TEXT("regressions"), RegressionValues);
+	}
+
+	FString Text;
+	FJsonSerializer::Serialize(Root, TJsonWriterFactory<>::Create(&Text));
+
+	if (FFileHelper::SaveStringToFile(Text, *OutputFile))
+	{
+		UE_LOG(LogShooter, Display, TEXT("Benchmark: results written to %s"), *FPaths::ConvertRelativePathToFull(OutputFile));
+	}
+	else
+	{
+		UE_LOG(LogShooter, Error, TEXT("Benchmark: could not write %s"), *OutputFile);
+	}
+
+	FPlatformMisc::RequestExitWithStatus(false, Regressions.Num() > 0 ? 1 : 0);
+}
@@ -0,0 +1,712 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Console commands used to measure the cost of gameplay systems in a running game.
+// Results are written to the LogShooter category.
+
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Kismet/GameplayStatics.h"
+#include "GameFramework/PlayerController.h"
+#include "Explosive.h"
+#include "Enemy.h"
+#include "EnemyController.h"
+#include "BehaviorTree/BehaviorTree.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Tickable.h"
+#include "CoreGlobals.h"
+#include "UObject/StrongObjectPtr.h"
+#include "UObject/CoreNet.h"
+#include "Engine/NetSerialization.h"
+#include "ShotBatch.h"
+#include "ShooterCosmetics.h"
+#include "Serialization/ArchiveCountMem.h"
+#include "UObject/UObjectHash.h"
+#include "../Shooter.h"
+
+namespace ShooterBenchmarks
+{
+	/**
+	 * Measures the average game thread time over several frames for each phase of a benchmark.
+	 * Each phase changes the world in its Begin function, waits a few frames to settle, then samples.
+	 */
+	class FFrameTimeBenchmark : public FTickableGameObject
+	{
+	public:
+		struct FPhase
+		{
+			FString Name;
+			TFunction<void()> Begin;
+
+			/** Units the phase changed; the benchmark's unit count if 0 */
+			int32 UnitCount;
+		};
+
+		FFrameTimeBenchmark(const FString& InName, int32 InFramesPerPhase, int32 InUnitCount, TFunction<void()> InOnFinished) :
+			Name(InName),
+			FramesPerPhase(FMath::Max(InFramesPerPhase, 1)),
+			UnitCount(FMath::Max(InUnitCount, 1)),
+			OnFinished(MoveTemp(InOnFinished))
+		{
+		}
+
+		void AddPhase(const FString& PhaseName, TFunction<void()> Begin, int32 PhaseUnitCount = 0)
+		{
+			Phases.Add({ PhaseName, MoveTemp(Begin), PhaseUnitCount });
+		}
+
+		virtual void Tick(float DeltaTime) override
+		{
+			if (FrameInPhase == 0 && Phases[PhaseIndex].Begin)
+			{
+				Phases[PhaseIndex].Begin();
+			}
+
+			// GGameThreadTime holds the previous frame, so skip the frame the phase began on
+			if (FrameInPhase > WarmupFrames)
+			{
+				PhaseMs += FPlatformTime::ToMilliseconds(GGameThreadTime);
+			}
+
+			if (++FrameInPhase < FramesPerPhase + WarmupFrames + 1)
+			{
+				return;
+			}
+
+			const double AverageMs{ PhaseMs / FramesPerPhase };
+			PhaseAverages.Add(AverageMs);
+
+			UE_LOG(LogShooter, Log, TEXT("%s [%s]: %.3f ms game thread per frame"), *Name, *Phases[PhaseIndex].Name, AverageMs);
+
+			if (PhaseIndex > 0)
+			{
+				const int32 PhaseUnits{ Phases[PhaseIndex].UnitCount > 0 ? Phases[PhaseIndex].UnitCount : UnitCount };
+
+				UE_LOG(LogShooter, Log, TEXT("%s [%s]: %+.4f ms per unit vs [%s] (%d units)"),
+					*Name, *Phases[PhaseIndex].Name, (AverageMs - PhaseAverages[0]) / PhaseUnits, *Phases[0].Name, PhaseUnits);
+			}
+
+			FrameInPhase = 0;
+			PhaseMs = 0.0;
+
+			if (++PhaseIndex == Phases.Num())
+			{
+				bFinished = true;
+
+				if (OnFinished)
+				{
+					OnFinished();
+				}
+			}
+		}
+
+		virtual bool IsTickable() const override { return !bFinished && Phases.Num() > 0; }
+		virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(FFrameTimeBenchmark, STATGROUP_Tickables); }
+
+	private:
+		FString Name;
+		TArray<FPhase> Phases;
+		TArray<double> PhaseAverages;
+
+		int32 FramesPerPhase;
+		int32 UnitCount;
+		int32 WarmupFrames{ 10 };
+		int32 PhaseIndex{ 0 };
+		int32 FrameInPhase{ 0 };
+		double PhaseMs{ 0.0 };
+		bool bFinished{ false };
+
+		TFunction<void()> OnFinished;
+	};
+
+	/** The frame time benchmark in progress; replaced by the next one */
+	TUniquePtr<FFrameTimeBenchmark> ActiveFrameTimeBenchmark;
+
+	/** Location benchmark content is spawned around: the first player if there is one */
+	FVector GetBenchmarkOrigin(UWorld* World)
+	{
+		APawn* PlayerPawn{ UGameplayStatics::GetPlayerPawn(World, 0) };
+
+		return PlayerPawn ? PlayerPawn->GetActorLocation() + PlayerPawn->GetActorForwardVector() * 600.f : FVector(0.f);
+	}
+
+	/** Spawns Count explosives in a grid and detonates all of them in the same frame */
+	void BenchExplosives(const TArray<FString>& Args, UWorld* World)
+	{
+		if (World == nullptr)
+		{
+			return;
+		}
+
+		const int32 Count{ Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 50 };
+		const float Spacing{ Args.Num() > 1 ? FCString::Atof(*Args[1]) : 200.f };
+
+		if (Count <= 0)
+		{
+			return;
+		}
+
+		// Use the class placed in the level so the barrels have their real mesh, radius and effects
+		TSubclassOf<AExplosive> ExplosiveClass{ AExplosive::StaticClass() };
+		for (TActorIterator<AExplosive> It(World); It; ++It)
+		{
+			ExplosiveClass = It->GetClass();
+			break;
+		}
+
+		const FVector Origin{ GetBenchmarkOrigin(World) };
+		const int32 Columns{ FMath::CeilToInt(FMath::Sqrt(static_cast<float>(Count))) };
+
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+		TArray<AExplosive*> Explosives;
+		Explosives.Reserve(Count);
+
+		for (int32 i = 0; i < Count; i++)
+		{
+			const FVector Offset{ (i % Columns) * Spacing, (i / Columns) * Spacing, 0.f };
+			AExplosive* Explosive{ World->SpawnActor<AExplosive>(ExplosiveClass, Origin + Offset, FRotator::ZeroRotator, SpawnParams) };
+
+			if (Explosive)
+			{
+				Explosives.Add(Explosive);
+			}
+		}
+
+		APlayerController* PlayerController{ UGameplayStatics::GetPlayerController(World, 0) };
+		APawn* Shooter{ PlayerController ? PlayerController->GetPawn() : nullptr };
+
+		const uint64 StartCycles{ FPlatformTime::Cycles64() };
+
+		for (AExplosive* Explosive : Explosives)
+		{
+			FHitResult HitResult;
+			HitResult.Location = Explosive->GetActorLocation();
+
+			Explosive->BulletHit_Implementation(HitResult, Shooter, PlayerController);
+		}
+
+		const double TotalMs{ FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles) };
+
+		UE_LOG(LogShooter, Log, TEXT("Bench.Explosives: %d blasts in %.3f ms (%.3f ms per blast)"),
+			Explosives.Num(), TotalMs, Explosives.Num() > 0 ? TotalMs / Explosives.Num() : 0.0);
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs BenchExplosivesCommand(
+		TEXT("Shooter.Bench.Explosives"),
+		TEXT("Detonates N explosives in the same frame and logs the cost. Usage: Shooter.Bench.Explosives [Count=50] [Spacing=200]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchExplosives));
+
+	/**
+	 * Runs every enemy with its current behavior tree, then with each tree given on the command line,
+	 * and logs the frame time difference per enemy. The trees must use the same blackboard.
+	 */
+	void BenchBehaviorTree(const TArray<FString>& Args, UWorld* World)
+	{
+		if (World == nullptr)
+		{
+			return;
+		}
+
+		const int32 Frames{ Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 300 };
+
+		TArray<TWeakObjectPtr<AEnemy>> Enemies;
+		for (TActorIterator<AEnemy> It(World); It; ++It)
+		{
+			if (Cast<AEnemyController>(It->GetController()))
+			{
+				Enemies.Add(*It);
+			}
+		}
+
+		if (Enemies.Num() == 0)
+		{
+			UE_LOG(LogShooter, Warning, TEXT("Bench.BehaviorTree: no enemies with an AI controller in the level"));
+			return;
+		}
+
+		auto RunTree = [Enemies](UBehaviorTree* Tree)
+		{
+			for (const TWeakObjectPtr<AEnemy>& Enemy : Enemies)
+			{
+				AEnemyController* EnemyController{ Enemy.IsValid() ? Cast<AEnemyController>(Enemy->GetController()) : nullptr };
+				UBehaviorTree* EnemyTree{ Tree ? Tree : (Enemy.IsValid() ? Enemy->GetBehaviorTree() : nullptr) };
+
+				if (EnemyController && EnemyTree)
+				{
+					EnemyController->RunBehaviorTree(EnemyTree);
+				}
+			}
+		};
+
+		ActiveFrameTimeBenchmark = MakeUnique<FFrameTimeBenchmark>(TEXT("Bench.BehaviorTree"), Frames, Enemies.Num(), [RunTree]() { RunTree(nullptr); });
+		ActiveFrameTimeBenchmark->AddPhase(TEXT("current"), nullptr);
+
+		for (int32 i = 1; i < Args.Num(); i++)
+		{
+			UBehaviorTree* Tree{ LoadObject<UBehaviorTree>(nullptr, *Args[i]) };
+
+			if (Tree == nullptr)
+			{
+				UE_LOG(LogShooter, Warning, TEXT("Bench.BehaviorTree: could not load %s"), *Args[i]);
+				continue;
+			}
+
+			// Keep the tree alive for the length of the benchmark
+			TStrongObjectPtr<UBehaviorTree> StrongTree(Tree);
+			ActiveFrameTimeBenchmark->AddPhase(Tree->GetName(), [RunTree, StrongTree]() { RunTree(StrongTree.Get()); });
+		}
+
+		UE_LOG(LogShooter, Log, TEXT("Bench.BehaviorTree: sampling %d frames per tree for %d enemies"), Frames, Enemies.Num());
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs BenchBehaviorTreeCommand(
+		TEXT("Shooter.Bench.BehaviorTree"),
+		TEXT("Compares the frame cost per enemy of behavior trees. Usage: Shooter.Bench.BehaviorTree [Frames=300] [TreePath...]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchBehaviorTree));
+
+	/**
+	 * Measures the movement cost per enemy in each movement tier. Samples the level with enemy movement
+	 * switched off first, then with every enemy forced to full and to reduced movement.
+	 * Enemies should be patrolling or chasing while it runs.
+	 */
+	void BenchMovementTiers(const TArray<FString>& Args, UWorld* World)
+	{
+		if (World == nullptr)
+		{
+			return;
+		}
+
+		const int32 Frames{ Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 300 };
+
+		TArray<TWeakObjectPtr<AEnemy>> Enemies;
+		for (TActorIterator<AEnemy> It(World); It; ++It)
+		{
+			if (!It->GetIsDying())
+			{
+				Enemies.Add(*It);
+			}
+		}
+
+		if (Enemies.Num() == 0)
+		{
+			UE_LOG(LogShooter, Warning, TEXT("Bench.MovementTiers: no enemies in the level"));
+			return;
+		}
+
+		IConsoleVariable* ForceTier{ IConsoleManager::Get().FindConsoleVariable(TEXT("Shooter.Movement.ForceTier")) };
+		check(ForceTier);
+
+		// Perception applies the forced tier on its next update; set it right away so warmup frames are in the right tier
+		auto SetTier = [Enemies, ForceTier](int32 Tier)
+		{
+			ForceTier->Set(Tier);
+
+			for (const TWeakObjectPtr<AEnemy>& Enemy : Enemies)
+			{
+				if (Enemy.IsValid())
+				{
+					Enemy->GetCharacterMovement()->SetComponentTickEnabled(true);
+
+					if (Tier >= 0)
+					{
+						Enemy->SetReducedMovement(Tier > 0);
+					}
+				}
+			}
+		};
+
+		auto DisableMovement = [Enemies]()
+		{
+			for (const TWeakObjectPtr<AEnemy>& Enemy : Enemies)
+			{
+				if (Enemy.IsValid())
+				{
+					Enemy->GetCharacterMovement()->SetComponentTickEnabled(false);
+				}
+			}
+		};
+
+		ActiveFrameTimeBenchmark = MakeUnique<FFrameTimeBenchmark>(TEXT("Bench.MovementTiers"), Frames, Enemies.Num(), [SetTier]() { SetTier(-1); });
+		ActiveFrameTimeBenchmark->AddPhase(TEXT("no movement"), DisableMovement);
+		ActiveFrameTimeBenchmark->AddPhase(TEXT("full"), [SetTier]() { SetTier(0); });
+		ActiveFrameTimeBenchmark->AddPhase(TEXT("reduced"), [SetTier]() { SetTier(1); });
+
+		UE_LOG(LogShooter, Log, TEXT("Bench.MovementTiers: sampling %d frames per tier for %d enemies"), Frames, Enemies.Num());
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs BenchMovementTiersCommand(
+		TEXT("Shooter.Bench.MovementTiers"),
+		TEXT("Compares the frame cost per enemy of full and reduced movement. Usage: Shooter.Bench.MovementTiers [Frames=300]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchMovementTiers));
+
+	/** Rough cost of the bunch and property headers around one RPC, which both send modes pay per RPC */
+	constexpr int32 RpcHeaderBits{ 64 };
+
+	/**
+	 * Compares the upstream bandwidth per player of batched shots against one RPC per shot with a full
+	 * origin, direction, time and sequence number. Shots are generated for a strafing, turning player,
+	 * so nothing needs to be running. Also logs the error the quantization adds.
+	 */
+	void BenchShotBandwidth(const TArray<FString>& Args, UWorld* World)
+	{
+		const float FireInterval{ Args.Num() > 0 ? FCString::Atof(*Args[0]) : 0.1f };
+		const float BatchInterval{ Args.Num() > 1 ? FCString::Atof(*Args[1]) : 0.033f };
+		const float Seconds{ Args.Num() > 2 ? FCString::Atof(*Args[2]) : 10.f };
+
+		if (FireInterval <= 0.f || BatchInterval < 0.f || Seconds <= 0.f)
+		{
+			return;
+		}
+
+		int64 NaiveBits{ 0 };
+		int64 BatchedBits{ 0 };
+		int32 NumBatches{ 0 };
+		float MaxDirectionError{ 0.f };
+		float MaxTimeError{ 0.f };
+
+		FShotBatch Batch;
+		float BatchStartTime{ 0.f };
+
+		auto SendBatch = [&]()
+		{
+			if (Batch.IsEmpty())
+			{
+				return;
+			}
+
+			FNetBitWriter Writer(nullptr, 0);
+			bool bSuccess{ true };
+			Batch.NetSerialize(Writer, nullptr, bSuccess);
+
+			BatchedBits += RpcHeaderBits + Writer.GetNumBits();
+			NumBatches++;
+
+			Batch.Reset();
+		};
+
+		const int32 NumShots{ FMath::FloorToInt(Seconds / FireInterval) };
+		TArray<float> FireTimes;
+
+		for (int32 i = 0; i < NumShots; i++)
+		{
+			// Fire on the frame after each fire interval, like the fire timer does at 60 fps
+			const float Time{ FMath::CeilToFloat(i * FireInterval * 60.f) / 60.f };
+			const FVector Start{ 600.f * Time, 300.f * FMath::Sin(Time), 160.f };
+			const FVector Direction{ FRotator(10.f * FMath::Sin(Time * 3.f), 45.f * Time, 0.f).Vector() };
+
+			// One RPC per shot with the full origin, direction, time and sequence
+			{
+				FNetBitWriter Writer(nullptr, 0);
+				bool bSuccess{ true };
+				FVector_NetQuantize NaiveStart{ Start };
+				FVector_NetQuantizeNormal NaiveDirection{ Direction };
+				float NaiveTime{ Time };
+				uint16 NaiveSequence{ static_cast<uint16>(i) };
+
+				NaiveStart.NetSerialize(Writer, nullptr, bSuccess);
+				NaiveDirection.NetSerialize(Writer, nullptr, bSuccess);
+				Writer << NaiveTime;
+				Writer << NaiveSequence;
+
+				NaiveBits += RpcHeaderBits + Writer.GetNumBits();
+			}
+
+			if (!Batch.IsEmpty() && Time - BatchStartTime >= BatchInterval)
+			{
+				SendBatch();
+			}
+
+			if (!Batch.Add(static_cast<uint16>(i), Start, Direction, Time))
+			{
+				SendBatch();
+				Batch.Add(static_cast<uint16>(i), Start, Direction, Time);
+			}
+
+			if (Batch.Shots.Num() == 1)
+			{
+				BatchStartTime = Time;
+			}
+
+			const FVector Unpacked{ ShotBatch::UnpackDirection(Batch.Shots.Last().Direction) };
+			MaxDirectionError = FMath::Max(MaxDirectionError, FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(FVector::DotProduct(Unpacked, Direction), -1.f, 1.f))));
+
+			TArray<float, TInlineAllocator<ShotBatch::MaxShots>> Times;
+			Batch.GetShotTimes(Times);
+			MaxTimeError = FMath::Max(MaxTimeError, FMath::Abs(Times.Last() - Time));
+
+			if (BatchInterval == 0.f)
+			{
+				SendBatch();
+			}
+		}
+
+		SendBatch();
+
+		const double NaiveBytesPerSecond{ NaiveBits / 8.0 / Seconds };
+		const double BatchedBytesPerSecond{ BatchedBits / 8.0 / Seconds };
+
+		UE_LOG(LogShooter, Log, TEXT("Bench.ShotBandwidth: %d shots in %.1f s, one every %.3f s, batched every %.3f s"), NumShots, Seconds, FireInterval, BatchInterval);
+		UE_LOG(LogShooter, Log, TEXT("Bench.ShotBandwidth: per-shot RPCs %.1f B/s per player (%d RPCs)"), NaiveBytesPerSecond, NumShots);
+		UE_LOG(LogShooter, Log, TEXT("Bench.ShotBandwidth: batched %.1f B/s per player (%d RPCs), %.1f%% of per-shot"),
+			BatchedBytesPerSecond, NumBatches, NaiveBytesPerSecond > 0.0 ? 100.0 * BatchedBytesPerSecond / NaiveBytesPerSecond : 0.0);
+		UE_LOG(LogShooter, Log, TEXT("Bench.ShotBandwidth: max direction error %.4f deg, max time error %.2f ms. RPC headers estimated at %d bits"),
+			MaxDirectionError, MaxTimeError * 1000.f, RpcHeaderBits);
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs BenchShotBandwidthCommand(
+		TEXT("Shooter.Bench.ShotBandwidth"),
+		TEXT("Compares the bandwidth of batched and per-shot fire RPCs. Usage: Shooter.Bench.ShotBandwidth [FireInterval=0.1] [BatchInterval=0.033] [Seconds=10]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchShotBandwidth));
+
+	/**
+	 * Compares the bandwidth per enemy of the default character movement replication against enemy movement snapshots
+	 * at the full and reduced rates. Uses a Grux walking and turning at 60 fps, so nothing needs to be running.
+	 * Payload only; both pay the same bunch and property headers per update. Also logs the error the quantization adds.
+	 * On clients, the Enemy Snapshot Bits Received stat shows the live payload.
+	 */
+	void BenchEnemyMovementBandwidth(const TArray<FString>& Args, UWorld* World)
+	{
+		const float Seconds{ Args.Num() > 0 ? FCString::Atof(*Args[0]) : 10.f };
+		const float DefaultRate{ Args.Num() > 1 ? FCString::Atof(*Args[1]) : 30.f };
+		const float FullRate{ Args.Num() > 2 ? FCString::Atof(*Args[2]) : 20.f };
+		const float ReducedRate{ Args.Num() > 3 ? FCString::Atof(*Args[3]) : 4.f };
+
+		if (Seconds <= 0.f || DefaultRate <= 0.f || FullRate <= 0.f || ReducedRate <= 0.f)
+		{
+			return;
+		}
+
+		constexpr float FrameTime{ 1.f / 60.f };
+		constexpr float Speed{ 400.f };
+
+		const int32 NumFrames{ FMath::FloorToInt(Seconds / FrameTime) };
+
+		// Bits sent by the default replication and by snapshots at each rate
+		int64 DefaultBits{ 0 };
+		int64 FullBits{ 0 };
+		int64 ReducedBits{ 0 };
+		float MaxLocationError{ 0.f };
+		float MaxYawError{ 0.f };
+
+		float NextDefaultTime{ 0.f };
+		float NextFullTime{ 0.f };
+		float NextReducedTime{ 0.f };
+
+		FVector Location{ 12'345.f, -6'789.f, 90.f };
+
+		for (int32 i = 0; i < NumFrames; i++)
+		{
+			const float Time{ i * FrameTime };
+			const float Yaw{ 90.f * FMath::Sin(Time * .5f) };
+			const FVector Velocity{ FRotator(0.f, Yaw, 0.f).Vector() * Speed };
+
+			Location += Velocity * FrameTime;
+
+			if (Time >= NextDefaultTime)
+			{
+				NextDefaultTime += 1.f / DefaultRate;
+
+				FNetBitWriter Writer(nullptr, 0);
+				bool bSuccess{ true };
+
+				FRepMovement RepMovement;
+				RepMovement.Location = Location;
+				RepMovement.Rotation = FRotator(0.f, Yaw, 0.f);
+				RepMovement.LinearVelocity = Velocity;
+				RepMovement.NetSerialize(Writer, nullptr, bSuccess);
+
+				// The character movement time stamp goes with every update
+				float TimeStamp{ Time };
+				Writer << TimeStamp;
+
+				DefaultBits += Writer.GetNumBits();
+			}
+
+			FEnemyMovementSnapshot Snapshot;
+			Snapshot.Set(Location, Yaw, Time);
+
+			FNetBitWriter Writer(nullptr, 0);
+			bool bSuccess{ true };
+			Snapshot.NetSerialize(Writer, nullptr, bSuccess);
+
+			if (Time >= NextFullTime)
+			{
+				NextFullTime += 1.f / FullRate;
+				FullBits += Writer.GetNumBits();
+			}
+
+			if (Time >= NextReducedTime)
+			{
+				NextReducedTime += 1.f / ReducedRate;
+				ReducedBits += Writer.GetNumBits();
+			}
+
+			MaxLocationError = FMath::Max(MaxLocationError, FVector::Dist(Snapshot.GetLocation(), Location));
+			MaxYawError = FMath::Max(MaxYawError, FMath::Abs(FRotator::NormalizeAxis(Snapshot.GetYaw() - Yaw)));
+		}
+
+		const double DefaultBytesPerSecond{ DefaultBits / 8.0 / Seconds };
+		const double FullBytesPerSecond{ FullBits / 8.0 / Seconds };
+		const double ReducedBytesPerSecond{ ReducedBits / 8.0 / Seconds };
+
+		UE_LOG(LogShooter, Log, TEXT("Bench.EnemyMovementBandwidth: %.1f s of a walking, turning enemy"), Seconds);
+		UE_LOG(LogShooter, Log, TEXT("Bench.EnemyMovementBandwidth: default movement at %.0f Hz: %.1f B/s per enemy"), DefaultRate, DefaultBytesPerSecond);
+		UE_LOG(LogShooter, Log, TEXT("Bench.EnemyMovementBandwidth: snapshots at %.0f Hz: %.1f B/s per enemy, %.1f%% of default"),
+			FullRate, FullBytesPerSecond, DefaultBytesPerSecond > 0.0 ? 100.0 * FullBytesPerSecond / DefaultBytesPerSecond : 0.0);
+		UE_LOG(LogShooter, Log, TEXT("Bench.EnemyMovementBandwidth: snapshots at %.0f Hz: %.1f B/s per enemy, %.1f%% of default"),
+			ReducedRate, ReducedBytesPerSecond, DefaultBytesPerSecond > 0.0 ? 100.0 * ReducedBytesPerSecond / DefaultBytesPerSecond : 0.0);
+		UE_LOG(LogShooter, Log, TEXT("Bench.EnemyMovementBandwidth: max location error %.2f cm, max yaw error %.3f deg"), MaxLocationError, MaxYawError);
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs BenchEnemyMovementBandwidthCommand(
+		TEXT("Shooter.Bench.EnemyMovementBandwidth"),
+		TEXT("Compares the bandwidth per enemy of default movement replication and movement snapshots. Usage: Shooter.Bench.EnemyMovementBandwidth [Seconds=10] [DefaultRate=30] [FullRate=20] [ReducedRate=4]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchEnemyMovementBandwidth));
+
+	/** Actors of one class and the memory they hold */
+	struct FActorClassCost
+	{
+		UClass* Class = nullptr;
+		int32 Components = 0;
+		int32 Objects = 0;
+		int64 Bytes = 0;
+		TArray<TWeakObjectPtr<AActor>> Actors;
+	};
+
+	/** Turns the ticking of actors and their components off, and back on for the ones it turned off */
+	class FTickSwitch
+	{
+	public:
+		void Disable(const TArray<TWeakObjectPtr<AActor>>& Actors)
+		{
+			for (const TWeakObjectPtr<AActor>& Actor : Actors)
+			{
+				if (!Actor.IsValid())
+				{
+					continue;
+				}
+
+				if (Actor->IsActorTickEnabled())
+				{
+					Actor->SetActorTickEnabled(false);
+					DisabledActors.Add(Actor);
+				}
+
+				for (UActorComponent* Component : Actor->GetComponents())
+				{
+					if (Component && Component->IsComponentTickEnabled())
+					{
+						Component->SetComponentTickEnabled(false);
+						DisabledComponents.Add(Component);
+					}
+				}
+			}
+		}
+
+		void Restore()
+		{
+			for (const TWeakObjectPtr<AActor>& Actor : DisabledActors)
+			{
+				if (Actor.IsValid())
+				{
+					Actor->SetActorTickEnabled(true);
+				}
+			}
+
+			for (const TWeakObjectPtr<UActorComponent>& Component : DisabledComponents)
+			{
+				if (Component.IsValid())
+				{
+					Component->SetComponentTickEnabled(true);
+				}
+			}
+
+			DisabledActors.Reset();
+			DisabledComponents.Reset();
+		}
+
+	private:
+		TArray<TWeakObjectPtr<AActor>> DisabledActors;
+		TArray<TWeakObjectPtr<UActorComponent>> DisabledComponents;
+	};
+
+	/**
+	 * Logs the memory per actor of each actor class: the actor and every object it owns, like components, widgets and
+	 * dynamic materials. Then measures the tick cost per actor of the classes with the most actors by turning their
+	 * ticking off one class at a time. Run a dedicated server with and without -KeepCosmetics to compare stripping.
+	 */
+	void BenchActorClassCost(const TArray<FString>& Args, UWorld* World)
+	{
+		if (World == nullptr)
+		{
+			return;
+		}
+
+		const int32 Frames{ Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 300 };
+		const int32 MaxTickClasses{ Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 8 };
+
+		TMap<UClass*, FActorClassCost> CostByClass;
+
+		for (TActorIterator<AActor> It(World); It; ++It)
+		{
+			AActor* Actor{ *It };
+			FActorClassCost& Cost{ CostByClass.FindOrAdd(Actor->GetClass()) };
+
+			auto CountObject = [&Cost](UObject* Object)
+			{
+				Cost.Objects++;
+				Cost.Bytes += Object->GetClass()->GetStructureSize() + FArchiveCountMem(Object).GetMax();
+			};
+
+			Cost.Class = Actor->GetClass();
+			Cost.Components += Actor->GetComponents().Num();
+			Cost.Actors.Add(Actor);
+
+			CountObject(Actor);
+			ForEachObjectWithOuter(Actor, CountObject, true);
+		}
+
+		TArray<FActorClassCost> Costs;
+		CostByClass.GenerateValueArray(Costs);
+		Costs.Sort([](const FActorClassCost& A, const FActorClassCost& B) { return A.Bytes > B.Bytes; });
+
+		UE_LOG(LogShooter, Log, TEXT("Bench.ActorClassCost: cosmetics %s, %d actor classes"), ShooterCosmetics::AreStripped() ? TEXT("stripped") : TEXT("kept"), Costs.Num());
+
+		for (const FActorClassCost& Cost : Costs)
+		{
+			const float NumActors{ static_cast<float>(Cost.Actors.Num()) };
+
+			UE_LOG(LogShooter, Log, TEXT("Bench.ActorClassCost: %s: %d actors, %.1f KB total, per actor %.1f KB, %.1f components, %.1f objects"),
+				*Cost.Class->GetName(), Cost.Actors.Num(), Cost.Bytes / 1024.f, Cost.Bytes / 1024.f / NumActors, Cost.Components / NumActors, Cost.Objects / NumActors);
+		}
+
+		// The classes with the most actors are where stripping shows in the frame time
+		Costs.Sort([](const FActorClassCost& A, const FActorClassCost& B) { return A.Actors.Num() > B.Actors.Num(); });
+
+		TSharedRef<FTickSwitch> TickSwitch{ MakeShared<FTickSwitch>() };
+
+		ActiveFrameTimeBenchmark = MakeUnique<FFrameTimeBenchmark>(TEXT("Bench.ActorClassCost"), Frames, 1, [TickSwitch]() { TickSwitch->Restore(); });
+		ActiveFrameTimeBenchmark->AddPhase(TEXT("all ticking"), nullptr);
+
+		for (int32 i = 0; i < FMath::Min(Costs.Num(), MaxTickClasses); i++)
+		{
+			TArray<TWeakObjectPtr<AActor>> Actors{ Costs[i].Actors };
+
+			ActiveFrameTimeBenchmark->AddPhase(FString::Printf(TEXT("%s not ticking"), *Costs[i].Class->GetName()), [TickSwitch, Actors]()
+			{
+				TickSwitch->Restore();
+				TickSwitch->Disable(Actors);
+			}, Actors.Num());
+		}
+
+		UE_LOG(LogShooter, Log, TEXT("Bench.ActorClassCost: sampling %d frames per class; the tick cost per actor is the negative of the difference"), Frames);
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs BenchActorClassCostCommand(
+		TEXT("Shooter.Bench.ActorClassCost"),
+		TEXT("Logs the memory and tick cost per actor of each actor class. Usage: Shooter.Bench.ActorClassCost [Frames=300] [TickClasses=8]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchActorClassCost));
+}
@@ -22,6 +22,46 @@
 #include "Enemy.h"
 #include "EnemyController.h"
 #include "BehaviorTree/BlackboardComponent.h"
+#include "EnemySquadSubsystem.h"
+#include "LagCompensationSubsystem.h"
+#include "GameFramework/GameStateBase.h"
+#include "Net/UnrealNetwork.h"
+#include "HAL/IConsoleManager.h"
+#include "ShooterCosmetics.h"
+#include "ShooterAimProvider.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Shot Batches Received"), STAT_ShotBatchesReceived, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Input Sequence Gaps"), STAT_InputSequenceGaps, STATGROUP_Shooter);
+
+static TAutoConsoleVariable<float> CVarShotBatchInterval(
+	TEXT("Shooter.Net.ShotBatchInterval"),
+	0.033f,
+	TEXT("Seconds an owning client collects shots before sending them to the server in one batch. 0: send every frame."));
+
+namespace
+{
+	/** Length of the aim trace from the crosshair */
+	constexpr float AimTraceDistance{ 5'000.f };
+
+	/** Farthest a client's aim ray may start from its character */
+	constexpr float MaxAimStartDistance{ 1'000.f };
+
+	/** Farthest a client may pick up an item from */
+	constexpr float MaxPickUpDistance{ 600.f };
+
+	/** Part of a fire rate or montage a client's action may arrive early by */
+	constexpr float ClientTimingTolerance{ 0.8f };
+
+	/** Unacknowledged inputs kept by the owner; older ones are assumed lost with the connection */
+	constexpr int32 MaxPendingCombatInputs{ 64 };
+
+	/** True when sequence number A comes after B, allowing for wrap-around */
+	bool IsNewerSequence(uint16 A, uint16 B)
+	{
+		return static_cast<int16>(A - B) > 0;
+	}
+}
 
 // Sets default values
 AShooterCharacter::AShooterCharacter() :
@@ -57,6 +97,9 @@ AShooterCharacter::AShooterCharacter() :
 	// Automatic fire variables
 	bIsFireButtonPressed(false),
 	bShouldFire(true),
+	CombatStateStartTime(0.f),
+	LastClientFireTime(0.f),
+	PendingShotBatchTime(0.f),
 	// Item trace variables
 	bShouldTraceForItems(false),
 	OverlappedItemsCount(0),
@@ -69,6 +112,7 @@ AShooterCharacter::AShooterCharacter() :
 	StartingSRAmmo(30),
 	// Combat variables
 	CombatState(ECombatState::ECS_Unoccupied),
+	CombatInputSequence(0),
 	bIsCrouching(false),
 	bAimingButtonPressed(false),
 	// Sound timer variables
@@ -113,27 +157,42 @@ AShooterCharacter::AShooterCharacter() :
 	// Create HandSceneComp
 	HandSceneComponent = CreateDefaultSubobject<USceneComponent>(TEXT("HandSceneComp"));
 
-	// Create interpolation components
-	WeaponInterpComp = CreateDefaultSubobject<USceneComponent>(TEXT("WeaponInterpComp"));
-	WeaponInterpComp->SetupAttachment(FollowCamera);
+	// Create interpolation components; items only fly to them to look picked up
+	if (!ShooterCosmetics::AreStripped())
+	{
+		WeaponInterpComp = CreateDefaultSubobject<USceneComponent>(TEXT("WeaponInterpComp"));
+		WeaponInterpComp->SetupAttachment(FollowCamera);
+
+		InterpComp1 = CreateDefaultSubobject<USceneComponent>(TEXT("InterpComp1"));
+		InterpComp1->SetupAttachment(FollowCamera);
 
-	InterpComp1 = CreateDefaultSubobject<USceneComponent>(TEXT("InterpComp1"));
-	InterpComp1->SetupAttachment(FollowCamera);
+		InterpComp2 = CreateDefaultSubobject<USceneComponent>(TEXT("InterpComp2"));
+		InterpComp2->SetupAttachment(FollowCamera);
 
-	InterpComp2 = CreateDefaultSubobject<USceneComponent>(TEXT("InterpComp2"));
-	InterpComp2->SetupAttachment(FollowCamera);
+		InterpComp3 = CreateDefaultSubobject<USceneComponent>(TEXT("InterpComp3"));
+		InterpComp3->SetupAttachment(FollowCamera);
 
-	InterpComp3 = CreateDefaultSubobject<USceneComponent>(TEXT("InterpComp3"));
-	InterpComp3->SetupAttachment(FollowCamera);
+		InterpComp4 = CreateDefaultSubobject<USceneComponent>(TEXT("InterpComp4"));
+		InterpComp4->SetupAttachment(FollowCamera);
 
-	InterpComp4 = CreateDefaultSubobject<USceneComponent>(TEXT("InterpComp4"));
-	InterpComp4->SetupAttachment(FollowCamera);
+		InterpComp5 = CreateDefaultSubobject<USceneComponent>(TEXT("InterpComp5"));
+		InterpComp5->SetupAttachment(FollowCamera);
 
-	InterpComp5 = CreateDefaultSubobject<USceneComponent>(TEXT("InterpComp5"));
-	InterpComp5->SetupAttachment(FollowCamera);
+		InterpComp6 = CreateDefaultSubobject<USceneComponent>(TEXT("InterpComp6"));
+		InterpComp6->SetupAttachment(FollowCamera);
+	}
+}
+
+void AShooterCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	InterpComp6 = CreateDefaultSubobject<USceneComponent>(TEXT("InterpComp6"));
-	InterpComp6->SetupAttachment(FollowCamera);
+	DOREPLIFETIME(AShooterCharacter, Health);
+	DOREPLIFETIME(AShooterCharacter, bIsDead);
+	DOREPLIFETIME_CONDITION(AShooterCharacter, EquippedWeapon, COND_SkipOwner);
+	DOREPLIFETIME_CONDITION(AShooterCharacter, CombatState, COND_SkipOwner);
+	DOREPLIFETIME_CONDITION(AShooterCharacter, Inventory, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(AShooterCharacter, CombatAck, COND_OwnerOnly);
 }
 
 float AShooterCharacter::TakeDamage(float DamageAmount, struct FDamageEvent const& DamageEvent, class AController* EventInstigator, AActor* DamageCauser)
@@ -143,9 +202,12 @@ float AShooterCharacter::TakeDamage(float DamageAmount, struct FDamageEvent cons
 		Health = 0.f;
 		Die();
 
-		auto EnemyController = Cast<AEnemyController>(EventInstigator);
-
-		if (EnemyController)
+		// Tell every enemy targeting this character, not just the one that landed the hit
+		if (UEnemySquadSubsystem* Squads = GetWorld()->GetSubsystem<UEnemySquadSubsystem>())
+		{
+			Squads->NotifyCharacterDied(this);
+		}
+		else if (auto EnemyController = Cast<AEnemyController>(EventInstigator))
 		{
 			EnemyController->GetBlackboardComponent()->SetValueAsBool(TEXT("CharacterDead"), true);
 		}
@@ -169,20 +231,39 @@ void AShooterCharacter::BeginPlay()
 		CameraCurrentFOV = CameraDefaultFOV;
 	}
 
-	// Spawn the default weapon and equip it
-	EquipWeapon(SpawnDefaultWeapon());
-	Inventory.Add(EquippedWeapon);
-	EquippedWeapon->SetSlotIndex(0);
-	EquippedWeapon->DisableCustomDepth();
-	EquippedWeapon->DisableGlowMaterial();
-	EquippedWeapon->SetCharacter(this);
+	// Clients get the weapon, inventory and ammo through replication
+	if (HasAuthority())
+	{
+		// Spawn the default weapon and equip it
+		EquipWeapon(SpawnDefaultWeapon());
+		Inventory.Add(EquippedWeapon);
+		EquippedWeapon->SetSlotIndex(0);
+		EquippedWeapon->DisableCustomDepth();
+		EquippedWeapon->DisableGlowMaterial();
+		EquippedWeapon->SetCharacter(this);
 
-	InitializeAmmoMap();
+		InitializeAmmoMap();
+
+		if (ULagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>())
+		{
+			LagCompensation->RegisterCharacter(this);
+		}
+	}
 
 	// Create structs for each interp location. Add to array
 	InitializeInterpLocations();
 }
 
+void AShooterCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (ULagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>())
+	{
+		LagCompensation->UnregisterCharacter(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
 // Called every frame
 void AShooterCharacter::Tick(float DeltaTime)
 {
@@ -198,7 +279,19 @@ void AShooterCharacter::Tick(float DeltaTime)
 	CalculateCrosshairSpread(DeltaTime);
 
 	// Check OverlappedItemsCount, then trace for items
-	TraceForItems();
+	if (IsLocallyControlled())
+	{
+		TraceForItems();
+
+		if (!HasAuthority() && !PendingShotBatch.IsEmpty() && GetWorld()->GetTimeSeconds() - PendingShotBatchTime >= CVarShotBatchInterval.GetValueOnGameThread())
+		{
+			SendShotBatch();
+		}
+	}
+	else if (HasAuthority())
+	{
+		UpdateCombatAck();
+	}
 }
 
 // Called to bind functionality to input
@@ -240,17 +333,34 @@ void AShooterCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputCo
 
 void AShooterCharacter::FinishReloading()
 {
-	if (CombatState == ECombatState::ECS_Stunned)
+	// Remote players finish reloading when their own montage does, through ServerFinishReloading
+	if (HasAuthority() && !IsLocallyControlled())
 	{
 		return;
 	}
 
+	const int32 RoundsMoved{ CompleteReload() };
+
+	if (RoundsMoved != INDEX_NONE && !HasAuthority() && IsLocallyControlled())
+	{
+		SendShotBatch();
+		ServerFinishReloading(RecordCombatInput(RoundsMoved, -RoundsMoved));
+	}
+}
+
+int32 AShooterCharacter::CompleteReload()
+{
+	if (CombatState != ECombatState::ECS_Reloading)
+	{
+		return INDEX_NONE;
+	}
+
 	// Update the combat state
 	CombatState = ECombatState::ECS_Unoccupied;
 
 	if (EquippedWeapon == nullptr)
 	{
-		return;
+		return 0;
 	}
 
 	const auto AmmoType = EquippedWeapon->GetAmmoType();
@@ -268,22 +378,60 @@ void AShooterCharacter::FinishReloading()
 		{
 			// Reload the magazine with all the carried ammo
 			EquippedWeapon->ReloadAmmo(CarriedAmmo);
-			CarriedAmmo = 0;
-			AmmoMap.Add(AmmoType, CarriedAmmo);
-		}
-		else
-		{
-			// Fill the magazine
-			EquippedWeapon->ReloadAmmo(MagEmptySpace);
-			CarriedAmmo -= MagEmptySpace;
-			AmmoMap.Add(AmmoType, CarriedAmmo);
+			AmmoMap.Add(AmmoType, 0);
+
+			return CarriedAmmo;
 		}
+
+		// Fill the magazine
+		EquippedWeapon->ReloadAmmo(MagEmptySpace);
+		CarriedAmmo -= MagEmptySpace;
+		AmmoMap.Add(AmmoType, CarriedAmmo);
+
+		return MagEmptySpace;
 	}
+
+	return 0;
+}
+
+bool AShooterCharacter::ServerFinishReloading_Validate(uint16 InputSequence)
+{
+	return true;
+}
+
+void AShooterCharacter::ServerFinishReloading_Implementation(uint16 InputSequence)
+{
+	AcknowledgeInput(InputSequence);
+
+	if (CombatState != ECombatState::ECS_Reloading || EquippedWeapon == nullptr)
+	{
+		return;
+	}
+
+	// The client's montage started before ours, but cannot have been much shorter
+	const float ReloadLength{ GetMontageSectionLength(ReloadMontage, EquippedWeapon->GetReloadMontageSection()) };
+	const float TimeLeft{ ReloadLength * ClientTimingTolerance - (GetWorld()->GetTimeSeconds() - CombatStateStartTime) };
+
+	if (TimeLeft <= 0.f)
+	{
+		GetWorldTimerManager().ClearTimer(DeferredReloadTimer);
+		CompleteReload();
+	}
+	else
+	{
+		// Too early, from jitter or an early notify; the client already moved the ammo, so finish when we may
+		GetWorldTimerManager().SetTimer(DeferredReloadTimer, this, &AShooterCharacter::FinishDeferredReload, TimeLeft);
+	}
+}
+
+void AShooterCharacter::FinishDeferredReload()
+{
+	CompleteReload();
 }
 
 void AShooterCharacter::FinishEquipping()
 {
-	if (CombatState == ECombatState::ECS_Stunned)
+	if (CombatState != ECombatState::ECS_Equipping)
 	{
 		return;
 	}
@@ -327,7 +475,10 @@ void AShooterCharacter::IncrementOverlappedItemsCount(int8 Amount)
 
 void AShooterCharacter::GetPickUpItem(AItem* Item)
 {
-	Item->PlayEquipSound();
+	if (!ShooterCosmetics::AreStripped())
+	{
+		Item->PlayEquipSound();
+	}
 
 	auto Weapon = Cast<AWeapon>(Item);
 	if (Weapon)
@@ -336,6 +487,9 @@ void AShooterCharacter::GetPickUpItem(AItem* Item)
 		{
 			Weapon->SetSlotIndex(Inventory.Num());
 			Inventory.Add(Weapon);
+
+			// Replicates owner-only weapon state such as ammo to us; set before the state so the item is routed to our connection
+			Weapon->SetOwner(this);
 			Weapon->SetItemState(EItemState::EIS_PickedUp);
 		}
 		else // inventory is full; swap with equipped weapon
@@ -470,6 +624,7 @@ void AShooterCharacter::StartFireTimer()
 	}
 
 	CombatState = ECombatState::ECS_FireTimerInProgress;
+	CombatStateStartTime = GetWorld()->GetTimeSeconds();
 
 	if (bShouldFire)
 	{
@@ -504,28 +659,51 @@ void AShooterCharacter::AutoFireReset()
 	}
 }
 
-bool AShooterCharacter::TraceUnderCrosshair(FHitResult& OutHitResult, FVector& OutHitLocation)
+bool AShooterCharacter::GetCrosshairRay(FVector& OutStart, FVector& OutDirection)
 {
-	// Get current size of the viewport
-	FVector2D ViewportSize;
-	if (GEngine && GEngine->GameViewport)
+	AController* OwningController{ GetController() };
+
+	if (OwningController == nullptr)
 	{
-		GEngine->GameViewport->GetViewportSize(ViewportSize);
+		return false;
+	}
+
+	if (const IShooterAimProvider* AimProvider = Cast<IShooterAimProvider>(OwningController))
+	{
+		return AimProvider->GetAimRay(this, OutStart, OutDirection);
+	}
+
+	// A local player aims through the crosshair in the middle of their own viewport
+	if (const APlayerController* PlayerController = Cast<APlayerController>(OwningController))
+	{
+		int32 ViewportX{ 0 };
+		int32 ViewportY{ 0 };
+		PlayerController->GetViewportSize(ViewportX, ViewportY);
+
+		if (ViewportX > 0 && ViewportY > 0)
+		{
+			return PlayerController->DeprojectScreenPositionToWorld(ViewportX / 2.f, ViewportY / 2.f, OutStart, OutDirection);
+		}
 	}
 
-	// Get screen space location of crosshairs
-	FVector2D CrosshairLocation(ViewportSize.X / 2.f, ViewportSize.Y / 2.f);
+	// No viewport: headless clients and AI aim from their view point
+	FRotator ViewRotation;
+	OwningController->GetPlayerViewPoint(OutStart, ViewRotation);
+	OutDirection = ViewRotation.Vector();
+
+	return true;
+}
+
+bool AShooterCharacter::TraceUnderCrosshair(FHitResult& OutHitResult, FVector& OutHitLocation)
+{
 	FVector CrosshairWorldPosition;
 	FVector CrosshairWorldDirection;
 
-	// Get world position and direction of crosshairs
-	bool bScreenToWorld = UGameplayStatics::DeprojectScreenToWorld(UGameplayStatics::GetPlayerController(this, 0), CrosshairLocation, CrosshairWorldPosition, CrosshairWorldDirection);
-
-	if (bScreenToWorld)
+	if (GetCrosshairRay(CrosshairWorldPosition, CrosshairWorldDirection))
 	{
 		// Trace from crosshair world location outward
 		const FVector Start{ CrosshairWorldPosition };
-		const FVector End{ Start + CrosshairWorldDirection * 5'000.f };
+		const FVector End{ Start + CrosshairWorldDirection * AimTraceDistance };
 		OutHitLocation = End;
 		GetWorld()->LineTraceSingleByChannel(OutHitResult, Start, End, ECollisionChannel::ECC_Visibility);
 				
@@ -600,7 +778,10 @@ void AShooterCharacter::TraceForItems()
 				{
 					// Different item hit this frame
 					// or AItem is null
-					TraceHitItemLastFrame->GetPickupWidget()->SetVisibility(false);
+					if (TraceHitItemLastFrame->GetPickupWidget())
+					{
+						TraceHitItemLastFrame->GetPickupWidget()->SetVisibility(false);
+					}
 					TraceHitItemLastFrame->DisableCustomDepth();
 				}
 			}
@@ -613,7 +794,10 @@ void AShooterCharacter::TraceForItems()
 	{
 		// No longer overlapping any item sphere
 		// Item should not display a widget
-		TraceHitItemLastFrame->GetPickupWidget()->SetVisibility(false);
+		if (TraceHitItemLastFrame->GetPickupWidget())
+		{
+			TraceHitItemLastFrame->GetPickupWidget()->SetVisibility(false);
+		}
 		TraceHitItemLastFrame->DisableCustomDepth();
 	}
 }
@@ -655,6 +839,12 @@ void AShooterCharacter::EquipWeapon(class AWeapon* WeaponToEquip, bool bIsSwappi
 
 		// Set equipped weapon to the newly spawned weapon
 		EquippedWeapon = WeaponToEquip;
+
+		if (HasAuthority())
+		{
+			EquippedWeapon->SetOwner(this);
+		}
+
 		EquippedWeapon->SetItemState(EItemState::EIS_Equipped);
 	}
 }
@@ -668,11 +858,13 @@ void AShooterCharacter::DropWeapon()
 			FDetachmentTransformRules DetachmentTransformRules(EDetachmentRule::KeepWorld, true);
 			EquippedWeapon->GetItemMesh()->DetachFromComponent(DetachmentTransformRules);
 
-			EquippedWeapon->SetItemState(EItemState::EIS_Falling);
-			EquippedWeapon->ThrowWeapon();
-
-			// Block additional throws of the previously thrown weapon
+			// Back to the world before the state change routes it there
+			AWeapon* ThrownWeapon{ EquippedWeapon };
 			EquippedWeapon = nullptr;
+			ThrownWeapon->SetOwner(nullptr);
+
+			ThrownWeapon->SetItemState(EItemState::EIS_Falling);
+			ThrownWeapon->ThrowWeapon();
 		}
 	}
 }
@@ -686,7 +878,16 @@ void AShooterCharacter::SelectButtonPressed()
 
 	if (TraceHitItem)
 	{
-		TraceHitItem->StartItemCurve(this, true);
+		if (HasAuthority())
+		{
+			TraceHitItem->StartItemCurve(this, true);
+		}
+		else
+		{
+			// The server moves the item to us; its position and state replicate back
+			ServerPickUpItem(TraceHitItem);
+		}
+
 		TraceHitItem = nullptr;
 	}
 }
@@ -737,7 +938,7 @@ void AShooterCharacter::PlayFireSound()
 	}
 }
 
-void AShooterCharacter::SendBullet()
+void AShooterCharacter::SendBullet(const FVector& AimStart, const FVector& AimDirection)
 {
 	// Send bullet
 	const USkeletalMeshSocket* MuzzleSocket = EquippedWeapon->GetItemMesh()->GetSocketByName("Muzzle");
@@ -746,64 +947,59 @@ void AShooterCharacter::SendBullet()
 	{
 		const FTransform SocketTransform = MuzzleSocket->GetSocketTransform(EquippedWeapon->GetItemMesh());
 
-		if (EquippedWeapon->GetMuzzleFlash())
+		const bool bCosmetics{ !ShooterCosmetics::AreStripped() };
+
+		if (bCosmetics && EquippedWeapon->GetMuzzleFlash())
 		{
 			UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), EquippedWeapon->GetMuzzleFlash(), SocketTransform);
 		}
 
 		FHitResult TrailHitResult;
-		bool bTrailEnd = GetTrailEndLocation(SocketTransform.GetLocation(), TrailHitResult);
+		bool bTrailEnd = GetTrailEndLocation(SocketTransform.GetLocation(), AimStart, AimDirection, TrailHitResult);
 
 		if (bTrailEnd)
 		{
 			// Does hit actor implement BulletHitInterface?
 			if (TrailHitResult.Actor.IsValid())
 			{
+				AEnemy* HitEnemy = Cast<AEnemy>(TrailHitResult.Actor.Get());
+
+				// Explosives change the world, so only the server sets them off; enemy hits only spawn effects
 				IBulletHitInterface* BulletHitInterface = Cast<IBulletHitInterface>(TrailHitResult.Actor.Get());
-				if (BulletHitInterface)
+				if (BulletHitInterface && (HasAuthority() || HitEnemy))
 				{
 					BulletHitInterface->BulletHit_Implementation(TrailHitResult, this, GetController());
 				}
 
-				AEnemy* HitEnemy = Cast<AEnemy>(TrailHitResult.Actor.Get());
 				if (HitEnemy)
 				{
-					int32 Damage{};
-					if (TrailHitResult.BoneName.ToString() == HitEnemy->GetHeadBone())
-					{
-						Damage = EquippedWeapon->GetHeadShotDamage();
-						// Head shot damage
-						UGameplayStatics::ApplyDamage(TrailHitResult.Actor.Get(), Damage, GetController(), this, UDamageType::StaticClass());
+					const bool bIsHeadShot{ TrailHitResult.BoneName.ToString() == HitEnemy->GetHeadBone() };
 
-						HitEnemy->ShowHitNumber(Damage, TrailHitResult.Location, true);
-					}
-					else
+					// Head shot or body shot damage
+					const int32 Damage = bIsHeadShot ? EquippedWeapon->GetHeadShotDamage() : EquippedWeapon->GetDamage();
+
+					if (HasAuthority() && !ShouldRewindHits())
 					{
-						Damage = EquippedWeapon->GetDamage();
-						// Body shot damage
 						UGameplayStatics::ApplyDamage(TrailHitResult.Actor.Get(), Damage, GetController(), this, UDamageType::StaticClass());
+					}
 
-						HitEnemy->ShowHitNumber(Damage, TrailHitResult.Location, false);
+					if (bCosmetics && IsLocallyControlled())
+					{
+						HitEnemy->ShowHitNumber(Damage, TrailHitResult.Location, bIsHeadShot);
 					}
 				}
 				else
 				{
 					// Spawn default particles
-					if (EquippedWeapon->GetImpactVFX())
+					if (bCosmetics && EquippedWeapon->GetImpactVFX())
 					{
 						UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), EquippedWeapon->GetImpactVFX(), TrailHitResult.Location);
 					}
 				}
 			}
-
-			UParticleSystemComponent* Trail = UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), TrailBulletVFX, SocketTransform);
-
-			if (Trail)
-			{
-				Trail->SetVectorParameter(FName("Target"), TrailHitResult.Location);
-			}
 		}
-		else
+
+		if (bCosmetics)
 		{
 			UParticleSystemComponent* Trail = UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), TrailBulletVFX, SocketTransform);
 
@@ -847,6 +1043,15 @@ void AShooterCharacter::ReloadWeapon()
 	if (CarryingAmmo() && !EquippedWeapon->IsMagazineFull())
 	{
 		CombatState = ECombatState::ECS_Reloading;
+		CombatStateStartTime = GetWorld()->GetTimeSeconds();
+		GetWorldTimerManager().ClearTimer(DeferredReloadTimer);
+
+		if (!HasAuthority())
+		{
+			// Shots fired before the reload have to get there first
+			SendShotBatch();
+			ServerReloadWeapon(RecordCombatInput());
+		}
 
 		UAnimInstance* AnimInstance = GetMesh()->GetAnimInstance();
 		if (AnimInstance && ReloadMontage)
@@ -854,9 +1059,27 @@ void AShooterCharacter::ReloadWeapon()
 			AnimInstance->Montage_Play(ReloadMontage);
 			AnimInstance->Montage_JumpToSection(EquippedWeapon->GetReloadMontageSection());
 		}
+
+		if (HasAuthority())
+		{
+			MulticastPlayMontage(ReloadMontage, EquippedWeapon->GetReloadMontageSection());
+		}
 	}
 }
 
+bool AShooterCharacter::ServerReloadWeapon_Validate(uint16 InputSequence)
+{
+	return true;
+}
+
+void AShooterCharacter::ServerReloadWeapon_Implementation(uint16 InputSequence)
+{
+	AcknowledgeInput(InputSequence);
+
+	CatchUpWithClient();
+	ReloadWeapon();
+}
+
 bool AShooterCharacter::CarryingAmmo()
 {
 	if (EquippedWeapon == nullptr)
@@ -1017,6 +1240,7 @@ void AShooterCharacter::ExchangeInventoryItems(int32 CurrentItemIndex, int32 New
 		NewWeapon->SetItemState(EItemState::EIS_Equipped);
 
 		CombatState = ECombatState::ECS_Equipping;
+		CombatStateStartTime = GetWorld()->GetTimeSeconds();
 		UAnimInstance* AnimInstance = GetMesh()->GetAnimInstance();
 
 		if (AnimInstance && EquipMontage)
@@ -1025,7 +1249,277 @@ void AShooterCharacter::ExchangeInventoryItems(int32 CurrentItemIndex, int32 New
 			AnimInstance->Montage_JumpToSection(FName("Equip"));
 		}
 
-		NewWeapon->PlayEquipSound(true);
+		if (!ShooterCosmetics::AreStripped())
+		{
+			NewWeapon->PlayEquipSound(true);
+		}
+
+		if (HasAuthority())
+		{
+			MulticastPlayMontage(EquipMontage, FName("Equip"));
+		}
+		else
+		{
+			SendShotBatch();
+			ServerExchangeInventoryItems(CurrentItemIndex, NewItemIndex, RecordCombatInput());
+		}
+	}
+}
+
+bool AShooterCharacter::ServerExchangeInventoryItems_Validate(int32 CurrentItemIndex, int32 NewItemIndex, uint16 InputSequence)
+{
+	return NewItemIndex >= 0 && NewItemIndex < INVENTORY_CAPACITY;
+}
+
+void AShooterCharacter::ServerExchangeInventoryItems_Implementation(int32 CurrentItemIndex, int32 NewItemIndex, uint16 InputSequence)
+{
+	AcknowledgeInput(InputSequence);
+
+	if (EquippedWeapon == nullptr || EquippedWeapon->GetSlotIndex() != CurrentItemIndex || !Inventory.IsValidIndex(NewItemIndex) || Cast<AWeapon>(Inventory[NewItemIndex]) == nullptr)
+	{
+		return;
+	}
+
+	CatchUpWithClient();
+	ExchangeInventoryItems(CurrentItemIndex, NewItemIndex);
+}
+
+bool AShooterCharacter::ServerPickUpItem_Validate(AItem* Item)
+{
+	return true;
+}
+
+void AShooterCharacter::ServerPickUpItem_Implementation(AItem* Item)
+{
+	if (Item == nullptr || bIsDead || Item->GetItemState() != EItemState::EIS_PickUp)
+	{
+		return;
+	}
+
+	if (FVector::DistSquared(Item->GetActorLocation(), GetActorLocation()) > FMath::Square(MaxPickUpDistance))
+	{
+		return;
+	}
+
+	CatchUpWithClient();
+
+	if (CombatState == ECombatState::ECS_Unoccupied)
+	{
+		Item->StartItemCurve(this, true);
+	}
+}
+
+void AShooterCharacter::MulticastPlayMontage_Implementation(UAnimMontage* Montage, FName Section)
+{
+	// Already playing on the server and on the owner
+	if (HasAuthority() || IsLocallyControlled())
+	{
+		return;
+	}
+
+	UAnimInstance* AnimInstance = GetMesh()->GetAnimInstance();
+
+	if (AnimInstance && Montage)
+	{
+		AnimInstance->Montage_Play(Montage);
+		AnimInstance->Montage_JumpToSection(Section);
+	}
+}
+
+void AShooterCharacter::CatchUpWithClient()
+{
+	if (EquippedWeapon == nullptr)
+	{
+		return;
+	}
+
+	// The client's timers run from when it acted, which is earlier than when the action reached us
+	const float TimeInState{ GetWorld()->GetTimeSeconds() - CombatStateStartTime };
+
+	if (CombatState == ECombatState::ECS_FireTimerInProgress && TimeInState >= EquippedWeapon->GetAutoFireRate() * ClientTimingTolerance)
+	{
+		GetWorldTimerManager().ClearTimer(AutomaticFireTimer);
+		CombatState = ECombatState::ECS_Unoccupied;
+	}
+	else if (CombatState == ECombatState::ECS_Equipping && TimeInState >= GetMontageSectionLength(EquipMontage, FName("Equip")) * ClientTimingTolerance)
+	{
+		CombatState = ECombatState::ECS_Unoccupied;
+	}
+	else if (CombatState == ECombatState::ECS_Reloading && TimeInState >= GetMontageSectionLength(ReloadMontage, EquippedWeapon->GetReloadMontageSection()) * ClientTimingTolerance)
+	{
+		// The client is past its reload; its finish reaches us before this input, but may have been refused
+		GetWorldTimerManager().ClearTimer(DeferredReloadTimer);
+		CompleteReload();
+	}
+}
+
+float AShooterCharacter::GetMontageSectionLength(const UAnimMontage* Montage, FName Section)
+{
+	if (Montage == nullptr)
+	{
+		return 0.f;
+	}
+
+	const int32 SectionIndex{ Montage->GetSectionIndex(Section) };
+
+	return SectionIndex == INDEX_NONE ? 0.f : Montage->GetSectionLength(SectionIndex);
+}
+
+uint16 AShooterCharacter::RecordCombatInput(int32 MagazineDelta, int32 CarriedDelta)
+{
+	FPredictedCombatInput& Input{ PendingCombatInputs.AddDefaulted_GetRef() };
+	Input.InputSequence = ++CombatInputSequence;
+	Input.EquippedSlot = EquippedWeapon ? EquippedWeapon->GetSlotIndex() : -1;
+	Input.AmmoType = EquippedWeapon ? EquippedWeapon->GetAmmoType() : EAmmoType::EAT_MAX;
+	Input.MagazineDelta = MagazineDelta;
+	Input.CarriedDelta = CarriedDelta;
+
+	if (PendingCombatInputs.Num() > MaxPendingCombatInputs)
+	{
+		PendingCombatInputs.RemoveAt(0);
+	}
+
+	return Input.InputSequence;
+}
+
+void AShooterCharacter::AcknowledgeInput(uint16 InputSequence)
+{
+	if (IsNewerSequence(InputSequence, CombatAck.InputSequence))
+	{
+		CombatAck.InputSequence = InputSequence;
+	}
+}
+
+void AShooterCharacter::UpdateCombatAck()
+{
+	CombatAck.EquippedSlot = EquippedWeapon ? EquippedWeapon->GetSlotIndex() : -1;
+
+	// Replication only sends the entries that changed
+	CombatAck.MagazineAmmo.SetNum(Inventory.Num());
+
+	for (int32 Slot = 0; Slot < Inventory.Num(); Slot++)
+	{
+		const AWeapon* Weapon{ Cast<AWeapon>(Inventory[Slot]) };
+		CombatAck.MagazineAmmo[Slot] = Weapon ? static_cast<uint16>(FMath::Clamp(Weapon->GetAmmo(), 0, static_cast<int32>(MAX_uint16))) : 0;
+	}
+
+	CombatAck.CarriedAmmo.SetNum(static_cast<int32>(EAmmoType::EAT_MAX));
+
+	for (int32 Type = 0; Type < CombatAck.CarriedAmmo.Num(); Type++)
+	{
+		const int32* Count{ AmmoMap.Find(static_cast<EAmmoType>(Type)) };
+		CombatAck.CarriedAmmo[Type] = Count ? static_cast<uint16>(FMath::Clamp(*Count, 0, static_cast<int32>(MAX_uint16))) : 0;
+	}
+}
+
+void AShooterCharacter::ReconcileCombatState()
+{
+	// Inputs the server has processed are part of its state now
+	int32 NumAcknowledged{ 0 };
+
+	while (NumAcknowledged < PendingCombatInputs.Num() && !IsNewerSequence(PendingCombatInputs[NumAcknowledged].InputSequence, CombatAck.InputSequence))
+	{
+		NumAcknowledged++;
+	}
+
+	PendingCombatInputs.RemoveAt(0, NumAcknowledged, false);
+
+	// Replay the rest on top of the server's state
+	int32 PredictedSlot{ CombatAck.EquippedSlot };
+	TArray<int32, TInlineAllocator<6>> MagazineAmmo(CombatAck.MagazineAmmo);
+	TArray<int32, TInlineAllocator<3>> CarriedAmmo(CombatAck.CarriedAmmo);
+
+	for (const FPredictedCombatInput& Input : PendingCombatInputs)
+	{
+		PredictedSlot = Input.EquippedSlot;
+
+		if (MagazineAmmo.IsValidIndex(Input.EquippedSlot))
+		{
+			MagazineAmmo[Input.EquippedSlot] += Input.MagazineDelta;
+		}
+
+		if (CarriedAmmo.IsValidIndex(static_cast<int32>(Input.AmmoType)))
+		{
+			CarriedAmmo[static_cast<int32>(Input.AmmoType)] += Input.CarriedDelta;
+		}
+	}
+
+	// Only values that differ are written, so a confirmed prediction changes nothing on screen
+	for (int32 Slot = 0; Slot < FMath::Min(MagazineAmmo.Num(), Inventory.Num()); Slot++)
+	{
+		AWeapon* Weapon{ Cast<AWeapon>(Inventory[Slot]) };
+
+		if (Weapon)
+		{
+			const int32 Ammo{ FMath::Clamp(MagazineAmmo[Slot], 0, Weapon->GetMagazineCapacity()) };
+
+			if (Weapon->GetAmmo() != Ammo)
+			{
+				Weapon->SetAmmo(Ammo);
+			}
+		}
+	}
+
+	for (int32 Type = 0; Type < CarriedAmmo.Num(); Type++)
+	{
+		const int32 Count{ FMath::Max(CarriedAmmo[Type], 0) };
+		const int32* Current{ AmmoMap.Find(static_cast<EAmmoType>(Type)) };
+
+		if (Current == nullptr || *Current != Count)
+		{
+			AmmoMap.Add(static_cast<EAmmoType>(Type), Count);
+		}
+	}
+
+	// Roll back a weapon switch the server refused, or follow one it made, like a swap on pick up
+	AWeapon* PredictedWeapon{ Inventory.IsValidIndex(PredictedSlot) ? Cast<AWeapon>(Inventory[PredictedSlot]) : nullptr };
+
+	if (PredictedWeapon && PredictedWeapon != EquippedWeapon)
+	{
+		if (EquippedWeapon && Inventory.Contains(EquippedWeapon))
+		{
+			EquippedWeapon->SetItemState(EItemState::EIS_PickedUp);
+		}
+
+		EquipWeapon(PredictedWeapon, EquippedWeapon && EquippedWeapon->GetSlotIndex() == PredictedSlot);
+	}
+
+	// Follows the reload the server starts when ammo is picked up for an empty weapon
+	if (PendingCombatInputs.Num() == 0 && !WeaponHasAmmo())
+	{
+		ReloadWeapon();
+	}
+}
+
+void AShooterCharacter::OnRep_CombatAck()
+{
+	if (IsLocallyControlled())
+	{
+		ReconcileCombatState();
+	}
+}
+
+void AShooterCharacter::OnRep_Inventory()
+{
+	// Weapons in the ack may only now have arrived
+	if (IsLocallyControlled())
+	{
+		ReconcileCombatState();
+	}
+}
+
+void AShooterCharacter::OnRep_EquippedWeapon(AWeapon* LastWeapon)
+{
+	if (EquippedWeapon == nullptr)
+	{
+		return;
+	}
+
+	const USkeletalMeshSocket* HandSocket = GetMesh()->GetSocketByName(FName("weapon_rSocket"));
+
+	if (HandSocket)
+	{
+		HandSocket->AttachActor(EquippedWeapon, GetMesh());
 	}
 }
 
@@ -1085,13 +1579,19 @@ void AShooterCharacter::Die()
 	}
 }
 
+void AShooterCharacter::OnRep_IsDead()
+{
+	if (bIsDead)
+	{
+		Die();
+	}
+}
+
 void AShooterCharacter::FinishDeath()
 {
 	GetMesh()->bPauseAnims = true;
 
-	APlayerController* PC = UGameplayStatics::GetPlayerController(this, 0);
-
-	if (PC)
+	if (APlayerController* PC = Cast<APlayerController>(GetController()))
 	{
 		DisableInput(PC);
 	}
@@ -1118,6 +1618,20 @@ void AShooterCharacter::Stun()
 	{
 		AnimInstance->Montage_Play(HitMontage);
 	}
+
+	// The owner runs its own combat state, so it has to be told
+	if (HasAuthority())
+	{
+		MulticastStun();
+	}
+}
+
+void AShooterCharacter::MulticastStun_Implementation()
+{
+	if (!HasAuthority())
+	{
+		Stun();
+	}
 }
 
 int32 AShooterCharacter::GetInterpLocationIndex()
@@ -1243,42 +1757,205 @@ void AShooterCharacter::FireWeapon()
 
 	if (WeaponHasAmmo())
 	{
-		PlayFireSound();
-		SendBullet();
-		PlayGunfireMontage();
-
-		// Start bullet fire timer for crosshair shooting factor
-		StartCrosshairBulletFire();
+		FVector AimStart;
+		FVector AimDirection;
 
-		// Subtract 1 from the weapon's ammo
-		EquippedWeapon->DecrementAmmo();
+		if (!GetCrosshairRay(AimStart, AimDirection))
+		{
+			return;
+		}
 
-		StartFireTimer();
+		FireShot(AimStart, AimDirection);
 
-		if (EquippedWeapon->GetWeaponType()==EWeaponType::EWT_PISTOL)
+		// The server applies the damage and confirms the ammo we spent
+		if (!HasAuthority())
 		{
-			// Start moving time slider
-			EquippedWeapon->StartSlideTimer();
+			BatchShot(AimStart, AimDirection);
 		}
+
+		StartFireTimer();
 	}
 	else
 	{
-		if (NoAmmoSound)
+		if (NoAmmoSound && !ShooterCosmetics::AreStripped())
 		{
 			UGameplayStatics::PlaySound2D(this, NoAmmoSound);
 		}
 	}
 }
 
-bool AShooterCharacter::GetTrailEndLocation(const FVector& MuzzleSocketLocation, FHitResult& OutHitResult)
+void AShooterCharacter::FireShot(const FVector& AimStart, const FVector& AimDirection)
+{
+	if (!ShooterCosmetics::AreStripped())
+	{
+		PlayFireSound();
+	}
+
+	SendBullet(AimStart, AimDirection);
+	PlayGunfireMontage();
+
+	// Start bullet fire timer for crosshair shooting factor
+	StartCrosshairBulletFire();
+
+	if (HasAuthority() || IsLocallyControlled())
+	{
+		// Subtract 1 from the weapon's ammo
+		EquippedWeapon->DecrementAmmo();
+	}
+
+	if (HasAuthority())
+	{
+		MulticastFireShot(AimStart, AimDirection);
+	}
+
+	if (EquippedWeapon->GetWeaponType()==EWeaponType::EWT_PISTOL)
+	{
+		// Start moving time slider
+		EquippedWeapon->StartSlideTimer();
+	}
+}
+
+void AShooterCharacter::BatchShot(const FVector& AimStart, const FVector& AimDirection)
+{
+	const AGameStateBase* GameState{ GetWorld()->GetGameState() };
+	const float FireTime{ GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds() };
+	const uint16 Sequence{ RecordCombatInput(-1) };
+
+	if (!PendingShotBatch.Add(Sequence, AimStart, AimDirection, FireTime))
+	{
+		SendShotBatch();
+		PendingShotBatch.Add(Sequence, AimStart, AimDirection, FireTime);
+	}
+
+	if (PendingShotBatch.Shots.Num() == 1)
+	{
+		PendingShotBatchTime = GetWorld()->GetTimeSeconds();
+	}
+
+	if (CVarShotBatchInterval.GetValueOnGameThread() <= 0.f)
+	{
+		SendShotBatch();
+	}
+}
+
+void AShooterCharacter::SendShotBatch()
+{
+	if (PendingShotBatch.IsEmpty())
+	{
+		return;
+	}
+
+	ServerFireShots(PendingShotBatch);
+	PendingShotBatch.Reset();
+}
+
+bool AShooterCharacter::ServerFireShots_Validate(const FShotBatch& Batch)
+{
+	return FMath::IsFinite(Batch.BaseTime);
+}
+
+void AShooterCharacter::ServerFireShots_Implementation(const FShotBatch& Batch)
+{
+	INC_DWORD_STAT(STAT_ShotBatchesReceived);
+
+	TArray<float, TInlineAllocator<ShotBatch::MaxShots>> ShotTimes;
+	Batch.GetShotTimes(ShotTimes);
+
+	for (int32 Index = 0; Index < Batch.Shots.Num(); Index++)
+	{
+		const uint16 Sequence{ static_cast<uint16>(Batch.FirstSequence + Index) };
+
+		// Late and duplicated shots were already given back to the client
+		if (!IsNewerSequence(Sequence, CombatAck.InputSequence))
+		{
+			continue;
+		}
+
+		// Lost batches, or reliable inputs still being resent
+		INC_DWORD_STAT_BY(STAT_InputSequenceGaps, static_cast<uint16>(Sequence - CombatAck.InputSequence) - 1);
+
+		// Refused shots are acknowledged too; the client then gets its round back
+		AcknowledgeInput(Sequence);
+
+		const FBatchedShot& Shot{ Batch.Shots[Index] };
+		FireClientShot(Shot.Start, ShotBatch::UnpackDirection(Shot.Direction), ShotTimes[Index]);
+	}
+}
+
+void AShooterCharacter::FireClientShot(const FVector& AimStart, const FVector& AimDirection, float ClientFireTime)
 {
-	FVector OutTrailLocation;
+	if (EquippedWeapon == nullptr || bIsDead || !WeaponHasAmmo())
+	{
+		return;
+	}
+
+	// The aim ray has to start around the camera
+	if (FVector::DistSquared(AimStart, GetActorLocation()) > FMath::Square(MaxAimStartDistance))
+	{
+		return;
+	}
+
+	// Shots of a batch arrive together, so the fire rate is checked against when the client fired them.
+	// The client cannot claim a shot in the future
+	ClientFireTime = FMath::Min(ClientFireTime, GetWorld()->GetTimeSeconds());
+
+	if (CombatState == ECombatState::ECS_FireTimerInProgress && ClientFireTime - LastClientFireTime >= EquippedWeapon->GetAutoFireRate() * ClientTimingTolerance)
+	{
+		GetWorldTimerManager().ClearTimer(AutomaticFireTimer);
+		CombatState = ECombatState::ECS_Unoccupied;
+	}
+
+	CatchUpWithClient();
+
+	if (CombatState != ECombatState::ECS_Unoccupied)
+	{
+		return;
+	}
+
+	LastClientFireTime = ClientFireTime;
+
+	// Weapon damage is read before FireShot, which may empty the magazine and start a reload
+	const float Damage{ EquippedWeapon->GetDamage() };
+	const float HeadShotDamage{ EquippedWeapon->GetHeadShotDamage() };
+
+	FireShot(AimStart, AimDirection);
+
+	StartFireTimer();
+
+	if (ShouldRewindHits())
+	{
+		GetWorld()->GetSubsystem<ULagCompensationSubsystem>()->QueueShot(this, AimStart, AimDirection, ClientFireTime, AimTraceDistance, Damage, HeadShotDamage);
+	}
+}
+
+bool AShooterCharacter::ShouldRewindHits() const
+{
+	// Shots from remote players are checked against where their targets were when they fired
+	const ULagCompensationSubsystem* LagCompensation{ GetWorld()->GetSubsystem<ULagCompensationSubsystem>() };
+
+	return !IsLocallyControlled() && LagCompensation && LagCompensation->IsRewindEnabled();
+}
+
+void AShooterCharacter::MulticastFireShot_Implementation(const FVector_NetQuantize& AimStart, const FVector_NetQuantizeNormal& AimDirection)
+{
+	// The server and the shooter have already played this shot
+	if (HasAuthority() || IsLocallyControlled() || EquippedWeapon == nullptr)
+	{
+		return;
+	}
+
+	FireShot(AimStart, AimDirection);
+}
+
+bool AShooterCharacter::GetTrailEndLocation(const FVector& MuzzleSocketLocation, const FVector& AimStart, const FVector& AimDirection, FHitResult& OutHitResult)
+{
+	FVector OutTrailLocation{ AimStart + AimDirection * AimTraceDistance };
 
 	// Check for crosshair trace hit
 	FHitResult CrosshairHitResult;
-	bool bCrosshairHit = TraceUnderCrosshair(CrosshairHitResult, OutTrailLocation);
+	GetWorld()->LineTraceSingleByChannel(CrosshairHitResult, AimStart, OutTrailLocation, ECollisionChannel::ECC_Visibility);
 
-	if (bCrosshairHit)
+	if (CrosshairHitResult.bBlockingHit)
 	{
 		// Tentative trail location - still need to trace from gun
 		OutTrailLocation = CrosshairHitResult.Location;
@@ -1310,7 +1987,7 @@ void AShooterCharacter::AimingButtonPressed()
 	{
 		bIsAiming = true;
 
-		if (EquippedWeapon->GetZoomInSound())
+		if (EquippedWeapon->GetZoomInSound() && !ShooterCosmetics::AreStripped())
 		{
 			UGameplayStatics::PlaySound2D(this, EquippedWeapon->GetZoomInSound());
 		}
@@ -1321,9 +1998,43 @@ void AShooterCharacter::AimingButtonReleased()
 {
 	bIsAiming = false;
 
-	if (EquippedWeapon->GetZoomOutSound())
+	if (EquippedWeapon->GetZoomOutSound() && !ShooterCosmetics::AreStripped())
 	{
 		UGameplayStatics::PlaySound2D(this, EquippedWeapon->GetZoomOutSound());
 	}
 }
 
+
+void AShooterCharacter::BotMove(float Forward, float Right)
+{
+	MoveForward(Forward);
+	MoveRight(Right);
+}
+
+void AShooterCharacter::BotSetFireButton(bool bPressed)
+{
+	if (bPressed == bIsFireButtonPressed)
+	{
+		return;
+	}
+
+	if (bPressed)
+	{
+		FireButtonPressed();
+	}
+	else
+	{
+		FireButtonReleased();
+	}
+}
+
+void AShooterCharacter::BotReload()
+{
+	ReloadButtonPressed();
+}
+
+void AShooterCharacter::BotPickUpItem(AItem* Item)
+{
+	TraceHitItem = Item;
+	SelectButtonPressed();
+}
@@ -0,0 +1,14 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShooterCosmetics.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+
+bool ShooterCosmetics::AreStripped()
+{
+	// Decided once for the process; class defaults create their components before any world exists
+	static const bool bStripped{ IsRunningDedicatedServer() && !FParse::Param(FCommandLine::Get(), TEXT("KeepCosmetics")) };
+
+	return bStripped;
+}
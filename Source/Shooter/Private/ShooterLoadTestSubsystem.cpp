@@ -0,0 +1,464 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShooterLoadTestSubsystem.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+#include "Engine/NetDriver.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/PlatformMisc.h"
+#include "ShooterCharacter.h"
+#include "Enemy.h"
+#include "Item.h"
+#include "Weapon.h"
+#include "LagCompensationSubsystem.h"
+#include "../Shooter.h"
+
+namespace
+{
+	/** Farthest a bot looks for enemies, players and items */
+	constexpr float BotSearchRadius{ 4'000.f };
+
+	/** Bots stop walking toward their target at this distance and strafe instead */
+	constexpr float BotFightDistance{ 900.f };
+
+	/** Close enough for the server to accept a pickup */
+	constexpr float BotPickUpDistance{ 250.f };
+
+	/** Chance a bot goes for an item in reach instead of fighting */
+	constexpr float BotPickUpChance{ 0.3f };
+
+	/** Interp speed of a bot turning toward its goal; about a player with a mouse */
+	constexpr float BotTurnSpeed{ 6.f };
+
+	/** Bots only fire when aiming within this many degrees of their target */
+	constexpr float BotFireAngle{ 10.f };
+
+	constexpr float BotGoalTimeMin{ 2.f };
+	constexpr float BotGoalTimeMax{ 6.f };
+
+	/** Nearest-rank percentile of a sorted array; Fraction 0.95 is p95 */
+	float Percentile(const TArray<float>& Sorted, float Fraction)
+	{
+		if (Sorted.Num() == 0)
+		{
+			return 0.f;
+		}
+
+		return Sorted[FMath::Clamp(FMath::CeilToInt(Fraction * Sorted.Num()) - 1, 0, Sorted.Num() - 1)];
+	}
+
+	/** "avg 1.23 p50 1.10 p95 2.40 p99 3.00 max 5.10" */
+	FString Distribution(TArray<float> Values)
+	{
+		if (Values.Num() == 0)
+		{
+			return TEXT("no samples");
+		}
+
+		Values.Sort();
+
+		double Sum{ 0.0 };
+		for (float Value : Values)
+		{
+			Sum += Value;
+		}
+
+		return FString::Printf(TEXT("avg %.2f p50 %.2f p95 %.2f p99 %.2f max %.2f (%d samples)"),
+			Sum / Values.Num(), Percentile(Values, 0.5f), Percentile(Values, 0.95f), Percentile(Values, 0.99f), Values.Last(), Values.Num());
+	}
+
+	float Average(const TArray<int32>& Values)
+	{
+		int64 Sum{ 0 };
+		for (int32 Value : Values)
+		{
+			Sum += Value;
+		}
+
+		return Values.Num() > 0 ? static_cast<float>(Sum) / Values.Num() : 0.f;
+	}
+
+	int32 Peak(const TArray<int32>& Values)
+	{
+		return Values.Num() > 0 ? FMath::Max(Values) : 0;
+	}
+}
+
+bool UShooterLoadTestSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer))
+	{
+		return false;
+	}
+
+	FString File;
+	return FParse::Param(FCommandLine::Get(), TEXT("LoadTestBot")) || FParse::Value(FCommandLine::Get(), TEXT("LoadTestReport="), File);
+}
+
+void UShooterLoadTestSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	const TCHAR* CommandLine{ FCommandLine::Get() };
+
+	int32 Seed{ 0 };
+	FParse::Value(CommandLine, TEXT("LoadTestSeed="), Seed);
+	BotStream.Initialize(Seed);
+
+	FParse::Value(CommandLine, TEXT("LoadTestReport="), ReportFile);
+	FParse::Value(CommandLine, TEXT("LoadTestClients="), ExpectedClients);
+	FParse::Value(CommandLine, TEXT("LoadTestSeconds="), SampleSeconds);
+
+	float WarmupSeconds{ 60.f };
+	FParse::Value(CommandLine, TEXT("LoadTestWarmup="), WarmupSeconds);
+	WarmupEndTime = WarmupSeconds;
+}
+
+void UShooterLoadTestSubsystem::Deinitialize()
+{
+	if (ULagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>())
+	{
+		LagCompensation->SetRecordLatencies(false);
+	}
+
+	Super::Deinitialize();
+}
+
+void UShooterLoadTestSubsystem::Tick(float DeltaTime)
+{
+	if (GetWorld()->GetNetMode() == NM_Client)
+	{
+		TickBot(DeltaTime);
+	}
+	else if (!ReportFile.IsEmpty())
+	{
+		TickServer();
+	}
+}
+
+TStatId UShooterLoadTestSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterLoadTestSubsystem, STATGROUP_Tickables);
+}
+
+void UShooterLoadTestSubsystem::TickBot(float DeltaTime)
+{
+	APlayerController* PlayerController{ GetWorld()->GetFirstPlayerController() };
+	AShooterCharacter* Character{ PlayerController ? Cast<AShooterCharacter>(PlayerController->GetPawn()) : nullptr };
+
+	if (Character == nullptr || Character->GetIsDead())
+	{
+		return;
+	}
+
+	const float Now{ GetWorld()->GetTimeSeconds() };
+
+	if (Now >= NextBotGoalTime || !IsBotGoalValid())
+	{
+		ChooseBotGoal(Character);
+		NextBotGoalTime = Now + BotStream.FRandRange(BotGoalTimeMin, BotGoalTimeMax);
+	}
+
+	const AActor* GoalActor{ BotGoalActor.Get() };
+	const FVector ToGoal{ (GoalActor ? GoalActor->GetActorLocation() : BotWanderLocation) - Character->GetActorLocation() };
+	const float Distance{ ToGoal.Size() };
+
+	// Turn toward the goal the way a player would, rather than snapping to it
+	const FRotator AimRotation{ FMath::RInterpTo(PlayerController->GetControlRotation(), ToGoal.Rotation(), DeltaTime, BotTurnSpeed) };
+	PlayerController->SetControlRotation(AimRotation);
+
+	bool bFire{ false };
+
+	switch (BotGoal)
+	{
+	case ELoadTestBotGoal::Fight:
+	{
+		Character->BotMove(Distance > BotFightDistance ? 1.f : 0.f, BotStrafe);
+
+		if (Now >= NextBotBurstTime)
+		{
+			bBotBurst = !bBotBurst;
+			NextBotBurstTime = Now + (bBotBurst ? BotStream.FRandRange(0.5f, 2.f) : BotStream.FRandRange(0.3f, 1.f));
+		}
+
+		const float AimError{ FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(FVector::DotProduct(AimRotation.Vector(), ToGoal.GetSafeNormal()), -1.f, 1.f))) };
+		bFire = bBotBurst && AimError <= BotFireAngle;
+		break;
+	}
+
+	case ELoadTestBotGoal::PickUp:
+		if (Distance <= BotPickUpDistance)
+		{
+			Character->BotPickUpItem(Cast<AItem>(BotGoalActor.Get()));
+			NextBotGoalTime = Now;
+		}
+		else
+		{
+			Character->BotMove(1.f, 0.f);
+		}
+		break;
+
+	case ELoadTestBotGoal::Wander:
+		Character->BotMove(FVector::DistSquared2D(BotWanderLocation, Character->GetActorLocation()) > FMath::Square(BotPickUpDistance) ? 1.f : 0.f, 0.f);
+		break;
+	}
+
+	Character->BotSetFireButton(bFire);
+
+	// Running dry reloads on its own; between bursts bots also top up a low magazine
+	const AWeapon* Weapon{ Character->GetEquippedWeapon() };
+
+	if (!bFire && Weapon && Weapon->GetAmmo() < Weapon->GetMagazineCapacity() / 4)
+	{
+		Character->BotReload();
+	}
+}
+
+void UShooterLoadTestSubsystem::ChooseBotGoal(AShooterCharacter* Character)
+{
+	const FVector Location{ Character->GetActorLocation() };
+
+	AActor* NearestTarget{ nullptr };
+	AItem* NearestItem{ nullptr };
+	float TargetDistanceSquared{ FMath::Square(BotSearchRadius) };
+	float ItemDistanceSquared{ FMath::Square(BotSearchRadius) };
+
+	for (TActorIterator<ACharacter> It(GetWorld()); It; ++It)
+	{
+		ACharacter* Other{ *It };
+		const AEnemy* Enemy{ Cast<AEnemy>(Other) };
+		const AShooterCharacter* Player{ Cast<AShooterCharacter>(Other) };
+
+		const bool bAlive{ (Enemy && !Enemy->GetIsDying()) || (Player && Player != Character && !Player->GetIsDead()) };
+		const float DistanceSquared{ FVector::DistSquared(Location, Other->GetActorLocation()) };
+
+		if (bAlive && !Other->IsHidden() && DistanceSquared < TargetDistanceSquared)
+		{
+			NearestTarget = Other;
+			TargetDistanceSquared = DistanceSquared;
+		}
+	}
+
+	for (TActorIterator<AItem> It(GetWorld()); It; ++It)
+	{
+		const float DistanceSquared{ FVector::DistSquared(Location, It->GetActorLocation()) };
+
+		if (It->GetItemState() == EItemState::EIS_PickUp && DistanceSquared < ItemDistanceSquared)
+		{
+			NearestItem = *It;
+			ItemDistanceSquared = DistanceSquared;
+		}
+	}
+
+	if (NearestItem && (NearestTarget == nullptr || BotStream.FRand() < BotPickUpChance))
+	{
+		BotGoal = ELoadTestBotGoal::PickUp;
+		BotGoalActor = NearestItem;
+	}
+	else if (NearestTarget)
+	{
+		BotGoal = ELoadTestBotGoal::Fight;
+		BotGoalActor = NearestTarget;
+		BotStrafe = BotStream.FRandRange(-1.f, 1.f);
+	}
+	else
+	{
+		BotGoal = ELoadTestBotGoal::Wander;
+		BotGoalActor = nullptr;
+
+		const float Angle{ BotStream.FRandRange(0.f, 2.f * PI) };
+		BotWanderLocation = Location + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.f) * BotStream.FRandRange(500.f, 2'000.f);
+	}
+}
+
+bool UShooterLoadTestSubsystem::IsBotGoalValid() const
+{
+	const AActor* GoalActor{ BotGoalActor.Get() };
+
+	switch (BotGoal)
+	{
+	case ELoadTestBotGoal::Fight:
+	{
+		const AEnemy* Enemy{ Cast<AEnemy>(GoalActor) };
+		const AShooterCharacter* Player{ Cast<AShooterCharacter>(GoalActor) };
+
+		return ((Enemy && !Enemy->GetIsDying()) || (Player && !Player->GetIsDead())) && !GoalActor->IsHidden();
+	}
+
+	case ELoadTestBotGoal::PickUp:
+	{
+		const AItem* Item{ Cast<AItem>(GoalActor) };
+
+		return Item && Item->GetItemState() == EItemState::EIS_PickUp;
+	}
+
+	default:
+		return true;
+	}
+}
+
+void UShooterLoadTestSubsystem::TickServer()
+{
+	if (bReportWritten)
+	{
+		return;
+	}
+
+	const UNetDriver* NetDriver{ GetWorld()->GetNetDriver() };
+	const int32 Connections{ NetDriver ? NetDriver->ClientConnections.Num() : 0 };
+
+	if (!bSampling)
+	{
+		if (Connections >= ExpectedClients || GetWorld()->GetTimeSeconds() >= WarmupEndTime)
+		{
+			StartSampling();
+		}
+
+		return;
+	}
+
+	const double Now{ FPlatformTime::Seconds() };
+	const float FrameSeconds{ static_cast<float>(FApp::GetDeltaTime()) };
+
+	Samples.FrameMs.Add(FrameSeconds * 1'000.f);
+	Samples.WorkMs.Add(FMath::Max(FrameSeconds - static_cast<float>(FApp::GetIdleTime()), 0.f) * 1'000.f);
+
+	if (ULagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>())
+	{
+		const int32 FirstNew{ Samples.HitValidationMs.Num() };
+		LagCompensation->TakeLatencies(Samples.HitValidationMs);
+
+		for (int32 Index = FirstNew; Index < Samples.HitValidationMs.Num(); Index++)
+		{
+			Samples.HitValidationMs[Index] *= 1'000.f;
+		}
+	}
+
+	// The net driver updates its rates once a second
+	if (Now >= NextNetSampleTime && NetDriver)
+	{
+		Samples.InBytesPerSecond.Add(NetDriver->InBytesPerSecond);
+		Samples.OutBytesPerSecond.Add(NetDriver->OutBytesPerSecond);
+		Samples.Connections.Add(Connections);
+		NextNetSampleTime = Now + 1.0;
+	}
+
+	if (Now - SampleStartTime >= SampleSeconds)
+	{
+		WriteReport();
+		bReportWritten = true;
+
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+void UShooterLoadTestSubsystem::StartSampling()
+{
+	bSampling = true;
+	SampleStartTime = FPlatformTime::Seconds();
+	NextNetSampleTime = SampleStartTime + 1.0;
+
+	if (ULagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<ULagCompensationSubsystem>())
+	{
+		LagCompensation->SetRecordLatencies(true);
+	}
+
+#if STATS
+	// Every cycle stat of every frame, for the session frontend or the stats viewer
+	GEngine->Exec(GetWorld(), TEXT("stat startfile"));
+#endif
+
+	UE_LOG(LogShooter, Display, TEXT("Load test: sampling for %.0f s"), SampleSeconds);
+}
+
+void UShooterLoadTestSubsystem::WriteReport()
+{
+#if STATS
+	GEngine->Exec(GetWorld(), TEXT("stat stopfile"));
+#endif
+
+	const double Seconds{ FPlatformTime::Seconds() - SampleStartTime };
+	const float MaxTickRate{ GEngine->GetMaxTickRate(0.f, false) };
+	const float BudgetMs{ MaxTickRate > 0.f ? 1'000.f / MaxTickRate : 0.f };
+
+	int32 FramesOverBudget{ 0 };
+	for (float WorkMs : Samples.WorkMs)
+	{
+		FramesOverBudget += BudgetMs > 0.f && WorkMs > BudgetMs;
+	}
+
+	// What ticks at the end of the run, by class
+	TMap<UClass*, TPair<int32, int32>> TicksByClass;
+	int32 TickingActors{ 0 };
+	int32 TickingComponents{ 0 };
+
+	for (TActorIterator<AActor> It(GetWorld()); It; ++It)
+	{
+		TPair<int32, int32>& Ticks{ TicksByClass.FindOrAdd(It->GetClass()) };
+
+		if (It->IsActorTickEnabled())
+		{
+			Ticks.Key++;
+			TickingActors++;
+		}
+
+		for (const UActorComponent* Component : It->GetComponents())
+		{
+			if (Component && Component->IsComponentTickEnabled())
+			{
+				Ticks.Value++;
+				TickingComponents++;
+			}
+		}
+	}
+
+	TicksByClass.ValueSort([](const TPair<int32, int32>& A, const TPair<int32, int32>& B) { return A.Key + A.Value > B.Key + B.Value; });
+
+	const float ClientsAverage{ FMath::Max(Average(Samples.Connections), 1.f) };
+
+	TArray<FString> Lines;
+	Lines.Add(TEXT("Shooter load test"));
+	Lines.Add(FString::Printf(TEXT("Clients: %d expected, %.1f average, %d peak"), ExpectedClients, Average(Samples.Connections), Peak(Samples.Connections)));
+	Lines.Add(FString::Printf(TEXT("Duration: %.1f s, %d frames, %.1f Hz (max tick rate %.0f Hz)"), Seconds, Samples.FrameMs.Num(), Samples.FrameMs.Num() / FMath::Max(Seconds, 1.0), MaxTickRate));
+	Lines.Add(FString::Printf(TEXT("Frame ms: %s"), *Distribution(Samples.FrameMs)));
+	Lines.Add(FString::Printf(TEXT("Work ms: %s"), *Distribution(Samples.WorkMs)));
+	Lines.Add(FString::Printf(TEXT("Frames over the %.1f ms budget: %d"), BudgetMs, FramesOverBudget));
+	Lines.Add(FString::Printf(TEXT("Ticking: %d actors, %d components"), TickingActors, TickingComponents));
+
+	int32 ClassesListed{ 0 };
+	for (const TPair<UClass*, TPair<int32, int32>>& Ticks : TicksByClass)
+	{
+		if (ClassesListed++ == 10 || Ticks.Value.Key + Ticks.Value.Value == 0)
+		{
+			break;
+		}
+
+		Lines.Add(FString::Printf(TEXT("  %s: %d actors, %d components"), *Ticks.Key->GetName(), Ticks.Value.Key, Ticks.Value.Value));
+	}
+
+	Lines.Add(FString::Printf(TEXT("In: %.1f KB/s average, %.1f KB/s peak"), Average(Samples.InBytesPerSecond) / 1024.f, Peak(Samples.InBytesPerSecond) / 1024.f));
+	Lines.Add(FString::Printf(TEXT("Out: %.1f KB/s average, %.1f KB/s peak, %.2f KB/s per client"),
+		Average(Samples.OutBytesPerSecond) / 1024.f, Peak(Samples.OutBytesPerSecond) / 1024.f, Average(Samples.OutBytesPerSecond) / 1024.f / ClientsAverage));
+	Lines.Add(FString::Printf(TEXT("Hit validation ms: %s"), *Distribution(Samples.HitValidationMs)));
+
+#if STATS
+	Lines.Add(FString::Printf(TEXT("Cycle stats: %s"), *FPaths::ConvertRelativePathToFull(FPaths::ProfilingDir() / TEXT("UnrealStats"))));
+#endif
+
+	for (const FString& Line : Lines)
+	{
+		UE_LOG(LogShooter, Display, TEXT("Load test: %s"), *Line);
+	}
+
+	if (!FFileHelper::SaveStringArrayToFile(Lines, *ReportFile))
+	{
+		UE_LOG(LogShooter, Error, TEXT("Load test: could not write %s"), *ReportFile);
+	}
+}
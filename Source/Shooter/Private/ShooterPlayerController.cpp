@@ -13,8 +13,8 @@ void AShooterPlayerController::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// Check the HUD overlay class TSubClassOf variable
-	if (HUDOverlayClass)
+	// Check the HUD overlay class TSubClassOf variable. The server has no HUD for remote players
+	if (HUDOverlayClass && IsLocalController())
 	{
 		HUDOverlay = CreateWidget<UUserWidget>(this, HUDOverlayClass);
 
@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShooterRandomSubsystem.h"
+#include "Engine/World.h"
+#include "Engine/Engine.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "../Shooter.h"
+
+namespace
+{
+	/** Switches the whole process to fixed-step simulation once, from -ShooterFixedStep=<Hz> */
+	void ApplyFixedStep()
+	{
+		static bool bApplied{ false };
+
+		if (bApplied)
+		{
+			return;
+		}
+
+		bApplied = true;
+
+		float StepRate{ 0.f };
+
+		if (FParse::Value(FCommandLine::Get(), TEXT("ShooterFixedStep="), StepRate) && StepRate > 0.f)
+		{
+			// Every frame simulates the same delta, however long it really took
+			FApp::SetUseFixedTimeStep(true);
+			FApp::SetFixedDeltaTime(1.0 / StepRate);
+
+			UE_LOG(LogShooter, Display, TEXT("Fixed-step simulation at %.0f Hz"), StepRate);
+		}
+	}
+}
+
+bool UShooterRandomSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World{ Cast<UWorld>(Outer) };
+
+	return World && World->IsGameWorld();
+}
+
+void UShooterRandomSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	ApplyFixedStep();
+
+	int32 InSeed{ 0 };
+
+	if (!FParse::Value(FCommandLine::Get(), TEXT("ShooterSeed="), InSeed) && !FApp::bUseFixedSeed)
+	{
+		InSeed = static_cast<int32>(FPlatformTime::Cycles());
+	}
+
+	Reseed(InSeed);
+}
+
+FRandomStream& UShooterRandomSubsystem::GetStream(const UObject* WorldContextObject, EShooterRandomStream Stream)
+{
+	const UWorld* World{ GEngine ? GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull) : nullptr };
+
+	if (UShooterRandomSubsystem* Random = World ? World->GetSubsystem<UShooterRandomSubsystem>() : nullptr)
+	{
+		return Random->Streams[static_cast<int32>(Stream)];
+	}
+
+	static FRandomStream FallbackStream{ static_cast<int32>(FPlatformTime::Cycles()) };
+	return FallbackStream;
+}
+
+void UShooterRandomSubsystem::Reseed(int32 InSeed)
+{
+	Seed = InSeed;
+
+	// Each stream gets its own seed, so they do not repeat each other's numbers
+	for (int32 Index = 0; Index < static_cast<int32>(EShooterRandomStream::Num); Index++)
+	{
+		Streams[Index].Initialize(static_cast<int32>(HashCombine(GetTypeHash(Seed), GetTypeHash(Index))));
+	}
+
+	UE_LOG(LogShooter, Log, TEXT("%s: gameplay random seed %d"), *GetWorld()->GetName(), Seed);
+}
+
+namespace
+{
+	void ReseedRandom(const TArray<FString>& Args, UWorld* World)
+	{
+		UShooterRandomSubsystem* Random{ World ? World->GetSubsystem<UShooterRandomSubsystem>() : nullptr };
+
+		if (Random)
+		{
+			Random->Reseed(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : Random->GetSeed());
+		}
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs ReseedRandomCommand(
+		TEXT("Shooter.Random.Reseed"),
+		TEXT("Restarts every gameplay random stream. Usage: Shooter.Random.Reseed [Seed=current seed]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&ReseedRandom));
+}
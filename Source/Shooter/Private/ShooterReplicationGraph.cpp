@@ -0,0 +1,381 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShooterReplicationGraph.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/UObjectIterator.h"
+#include "Item.h"
+#include "Explosive.h"
+#include "ShooterCharacter.h"
+#include "../Shooter.h"
+
+DECLARE_CYCLE_STAT(TEXT("Replicate Actors"), STAT_ShooterReplicateActors, STATGROUP_Shooter);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Replicated Actors"), STAT_ShooterReplicatedActors, STATGROUP_Shooter);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Routed Items"), STAT_RoutedItems, STATGROUP_Shooter);
+
+namespace
+{
+	/** Size of a grid cell; about the longest net cull distance, so few cells are gathered per connection */
+	constexpr float GridCellSize{ 10'000.f };
+
+	/** Grid origin; the maps fit well inside it */
+	constexpr float GridSpatialBias{ -200'000.f };
+}
+
+void UShooterReplicationGraph::InitGlobalActorClassSettings()
+{
+	Super::InitGlobalActorClassSettings();
+
+	// Cull distance and update rate come from each replicated class's defaults
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		UClass* Class{ *It };
+		const AActor* ActorCDO{ Cast<AActor>(Class->GetDefaultObject()) };
+
+		if (ActorCDO == nullptr || !ActorCDO->GetIsReplicated())
+		{
+			continue;
+		}
+
+		// Blueprint compile leftovers
+		if (Class->GetName().StartsWith(TEXT("SKEL_")) || Class->GetName().StartsWith(TEXT("REINST_")))
+		{
+			continue;
+		}
+
+		FClassReplicationInfo ClassInfo;
+		ClassInfo.SetCullDistanceSquared(ActorCDO->NetCullDistanceSquared);
+		ClassInfo.ReplicationPeriodFrame = GetReplicationPeriodFrameForFrequency(ActorCDO->NetUpdateFrequency);
+
+		GlobalActorReplicationInfoMap.SetClassInfo(Class, ClassInfo);
+	}
+}
+
+void UShooterReplicationGraph::InitGlobalGraphNodes()
+{
+	GridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D>();
+	GridNode->CellSize = GridCellSize;
+	GridNode->SpatialBias = FVector2D(GridSpatialBias, GridSpatialBias);
+	AddGlobalGraphNode(GridNode);
+
+	AlwaysRelevantNode = CreateNewNode<UReplicationGraphNode_ActorList>();
+	AddGlobalGraphNode(AlwaysRelevantNode);
+}
+
+void UShooterReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	Super::InitConnectionGraphNodes(RepGraphConnection);
+
+	// Adds the connection's player controller and view target by itself; inventory items are added to it
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* OwnerNode{ CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForConnection>() };
+	AddConnectionGraphNode(OwnerNode, RepGraphConnection);
+
+	OwnerNodes.Add(RepGraphConnection->NetConnection, OwnerNode);
+}
+
+void UShooterReplicationGraph::RemoveClientConnection(UNetConnection* NetConnection)
+{
+	OwnerNodes.Remove(NetConnection);
+
+	// The items stay in the inventory of a character nobody controls
+	for (TPair<AActor*, FItemReplicationRoute>& ItemRoute : ItemRoutes)
+	{
+		if (ItemRoute.Value.Route == EItemReplicationRoute::OwnerOnly && ItemRoute.Value.Connection.Get() == NetConnection)
+		{
+			ItemRoute.Value = FItemReplicationRoute();
+		}
+	}
+
+	Super::RemoveClientConnection(NetConnection);
+}
+
+void UShooterReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	AActor* Actor{ ActorInfo.Actor };
+
+	if (AItem* Item = Cast<AItem>(Actor))
+	{
+		const FItemReplicationRoute Route{ GetItemRoute(Item) };
+		AddItemToRoute(Item, Route);
+		ItemRoutes.Add(Item, Route);
+
+		INC_DWORD_STAT(STAT_RoutedItems);
+	}
+	else if (Actor->bOnlyRelevantToOwner)
+	{
+		// Player controllers; each connection's owner node gathers its own
+	}
+	else if (Actor->bAlwaysRelevant)
+	{
+		AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+	}
+	else if (Cast<AExplosive>(Actor))
+	{
+		// Explosives never move; they are only ever destroyed
+		GridNode->AddActor_Static(ActorInfo, GlobalInfo);
+	}
+	else
+	{
+		GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+	}
+}
+
+void UShooterReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	AActor* Actor{ ActorInfo.Actor };
+
+	if (AItem* Item = Cast<AItem>(Actor))
+	{
+		FItemReplicationRoute Route;
+
+		if (ItemRoutes.RemoveAndCopyValue(Item, Route))
+		{
+			RemoveItemFromRoute(Item, Route);
+
+			DEC_DWORD_STAT(STAT_RoutedItems);
+		}
+	}
+	else if (Actor->bOnlyRelevantToOwner)
+	{
+	}
+	else if (Actor->bAlwaysRelevant)
+	{
+		AlwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
+	}
+	else if (Cast<AExplosive>(Actor))
+	{
+		GridNode->RemoveActor_Static(ActorInfo);
+	}
+	else
+	{
+		GridNode->RemoveActor_Dynamic(ActorInfo);
+	}
+}
+
+void UShooterReplicationGraph::NotifyItemChanged(AItem* Item)
+{
+	UNetDriver* ItemNetDriver{ Item ? Item->GetNetDriver() : nullptr };
+	UShooterReplicationGraph* Graph{ ItemNetDriver ? ItemNetDriver->GetReplicationDriver<UShooterReplicationGraph>() : nullptr };
+
+	if (Graph)
+	{
+		Graph->RouteItem(Item);
+	}
+}
+
+void UShooterReplicationGraph::NotifyUpdateFrequencyChanged(AActor* Actor)
+{
+	UNetDriver* ActorNetDriver{ Actor ? Actor->GetNetDriver() : nullptr };
+	UShooterReplicationGraph* Graph{ ActorNetDriver ? ActorNetDriver->GetReplicationDriver<UShooterReplicationGraph>() : nullptr };
+
+	if (Graph == nullptr)
+	{
+		return;
+	}
+
+	if (FGlobalActorReplicationInfo* GlobalInfo = Graph->GlobalActorReplicationInfoMap.Find(Actor))
+	{
+		GlobalInfo->Settings.ReplicationPeriodFrame = Graph->GetReplicationPeriodFrameForFrequency(Actor->NetUpdateFrequency);
+	}
+}
+
+FItemReplicationRoute UShooterReplicationGraph::GetItemRoute(AItem* Item) const
+{
+	FItemReplicationRoute Route;
+
+	AShooterCharacter* Character{ Cast<AShooterCharacter>(Item->GetOwner()) };
+
+	if (Character == nullptr)
+	{
+		Route.Route = EItemReplicationRoute::World;
+	}
+	else if (Character->GetEquippedWeapon() == Item)
+	{
+		Route.Route = EItemReplicationRoute::WithOwner;
+		Route.Owner = Character;
+	}
+	else if (UNetConnection* Connection = Character->GetNetConnection())
+	{
+		Route.Route = EItemReplicationRoute::OwnerOnly;
+		Route.Owner = Character;
+		Route.Connection = Connection;
+	}
+
+	return Route;
+}
+
+void UShooterReplicationGraph::RouteItem(AItem* Item)
+{
+	// Items not added to the graph yet are routed when they are
+	FItemReplicationRoute* CurrentRoute{ ItemRoutes.Find(Item) };
+
+	if (CurrentRoute == nullptr)
+	{
+		return;
+	}
+
+	const FItemReplicationRoute NewRoute{ GetItemRoute(Item) };
+
+	if (NewRoute == *CurrentRoute)
+	{
+		return;
+	}
+
+	RemoveItemFromRoute(Item, *CurrentRoute);
+	AddItemToRoute(Item, NewRoute);
+	*CurrentRoute = NewRoute;
+}
+
+void UShooterReplicationGraph::AddItemToRoute(AItem* Item, const FItemReplicationRoute& Route)
+{
+	switch (Route.Route)
+	{
+	case EItemReplicationRoute::World:
+		GridNode->AddActor_Dormancy(FNewReplicatedActorInfo(Item), GlobalActorReplicationInfoMap.Get(Item));
+		break;
+
+	case EItemReplicationRoute::OwnerOnly:
+		if (UReplicationGraphNode_AlwaysRelevant_ForConnection* const* OwnerNode = OwnerNodes.Find(Route.Connection.Get()))
+		{
+			(*OwnerNode)->NotifyAddNetworkActor(FNewReplicatedActorInfo(Item));
+		}
+		break;
+
+	case EItemReplicationRoute::WithOwner:
+		if (Route.Owner.IsValid())
+		{
+			GlobalActorReplicationInfoMap.AddDependentActor(Route.Owner.Get(), Item);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void UShooterReplicationGraph::RemoveItemFromRoute(AItem* Item, const FItemReplicationRoute& Route)
+{
+	switch (Route.Route)
+	{
+	case EItemReplicationRoute::World:
+		GridNode->RemoveActor_Dormancy(FNewReplicatedActorInfo(Item));
+		break;
+
+	case EItemReplicationRoute::OwnerOnly:
+		if (UReplicationGraphNode_AlwaysRelevant_ForConnection* const* OwnerNode = OwnerNodes.Find(Route.Connection.Get()))
+		{
+			(*OwnerNode)->NotifyRemoveNetworkActor(FNewReplicatedActorInfo(Item));
+		}
+		break;
+
+	case EItemReplicationRoute::WithOwner:
+		if (Route.Owner.IsValid())
+		{
+			GlobalActorReplicationInfoMap.RemoveDependentActor(Route.Owner.Get(), Item);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+int32 UShooterReplicationGraph::ServerReplicateActors(float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterReplicateActors);
+
+	const uint64 StartCycles{ FPlatformTime::Cycles64() };
+
+	const int32 NumReplicated{ Super::ServerReplicateActors(DeltaSeconds) };
+
+	INC_DWORD_STAT_BY(STAT_ShooterReplicatedActors, NumReplicated);
+
+	if (ProfileFramesLeft > 0)
+	{
+		ProfileMs += FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+		ProfileReplicatedActors += NumReplicated;
+
+		for (UNetConnection* Connection : NetDriver->ClientConnections)
+		{
+			if (Connection == nullptr)
+			{
+				continue;
+			}
+
+			FConnectionReplicationProfile& ConnectionProfile{ ProfileConnections.FindOrAdd(Connection->LowLevelGetRemoteAddress(true)) };
+			ConnectionProfile.OutBytesPerSecond += Connection->OutBytesPerSecond;
+			ConnectionProfile.OutPacketsPerSecond += Connection->OutPacketsPerSecond;
+			ConnectionProfile.Frames++;
+
+			ProfileConnectionFrames++;
+		}
+
+		if (--ProfileFramesLeft == 0)
+		{
+			LogProfile();
+		}
+	}
+
+	return NumReplicated;
+}
+
+void UShooterReplicationGraph::StartProfiling(int32 Frames)
+{
+	ProfileFramesLeft = FMath::Max(Frames, 1);
+	ProfileFrames = ProfileFramesLeft;
+	ProfileMs = 0.0;
+	ProfileReplicatedActors = 0;
+	ProfileConnectionFrames = 0;
+	ProfileConnections.Reset();
+}
+
+void UShooterReplicationGraph::LogProfile()
+{
+	const double MsPerFrame{ ProfileMs / ProfileFrames };
+	const double AverageConnections{ static_cast<double>(ProfileConnectionFrames) / ProfileFrames };
+	const float FrameRate{ GetWorld() ? 1.f / FMath::Max(GetWorld()->GetDeltaSeconds(), KINDA_SMALL_NUMBER) : 0.f };
+
+	UE_LOG(LogShooter, Log, TEXT("Net.ReplicationReport: %d frames, %.1f connections, %.3f ms per frame, %.1f actors replicated per frame"),
+		ProfileFrames, AverageConnections, MsPerFrame, static_cast<double>(ProfileReplicatedActors) / ProfileFrames);
+
+	UE_LOG(LogShooter, Log, TEXT("Net.ReplicationReport: %.4f ms per connection per frame, %d routed items, %d dormant-capable"),
+		AverageConnections > 0.0 ? MsPerFrame / AverageConnections : 0.0, ItemRoutes.Num(),
+		ItemRoutes.FilterByPredicate([](const TPair<AActor*, FItemReplicationRoute>& ItemRoute) { return ItemRoute.Value.Route == EItemReplicationRoute::World; }).Num());
+
+	for (const TPair<FString, FConnectionReplicationProfile>& Connection : ProfileConnections)
+	{
+		const double BytesPerSecond{ static_cast<double>(Connection.Value.OutBytesPerSecond) / Connection.Value.Frames };
+
+		UE_LOG(LogShooter, Log, TEXT("Net.ReplicationReport: [%s] %.0f B/s out (%.1f B per frame at %.0f fps), %.1f packets/s"),
+			*Connection.Key, BytesPerSecond, FrameRate > 0.f ? BytesPerSecond / FrameRate : 0.0, FrameRate,
+			static_cast<double>(Connection.Value.OutPacketsPerSecond) / Connection.Value.Frames);
+	}
+}
+
+namespace
+{
+	void ReplicationReport(const TArray<FString>& Args, UWorld* World)
+	{
+		UNetDriver* NetDriver{ World ? World->GetNetDriver() : nullptr };
+		UShooterReplicationGraph* Graph{ NetDriver ? NetDriver->GetReplicationDriver<UShooterReplicationGraph>() : nullptr };
+
+		if (Graph == nullptr)
+		{
+			UE_LOG(LogShooter, Warning, TEXT("Net.ReplicationReport: run on a server using the Shooter replication graph"));
+			return;
+		}
+
+		const int32 Frames{ Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 300 };
+		Graph->StartProfiling(Frames);
+
+		UE_LOG(LogShooter, Log, TEXT("Net.ReplicationReport: sampling %d frames"), Frames);
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs ReplicationReportCommand(
+		TEXT("Shooter.Net.ReplicationReport"),
+		TEXT("Logs the replication cost per frame and per connection. Run on the server. Usage: Shooter.Net.ReplicationReport [Frames=300]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&ReplicationReport));
+}
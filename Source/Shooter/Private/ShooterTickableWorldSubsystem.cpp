@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShooterTickableWorldSubsystem.h"
+#include "Engine/World.h"
+
+bool UShooterTickableWorldSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World{ Cast<UWorld>(Outer) };
+
+	return World && World->IsGameWorld();
+}
+
+void UShooterTickableWorldSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	bIsInitialized = true;
+}
+
+void UShooterTickableWorldSubsystem::Deinitialize()
+{
+	bIsInitialized = false;
+
+	Super::Deinitialize();
+}
+
+void UShooterTickableWorldSubsystem::Tick(float DeltaTime)
+{
+
+}
+
+TStatId UShooterTickableWorldSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterTickableWorldSubsystem, STATGROUP_Tickables);
+}
+
+ETickableTickType UShooterTickableWorldSubsystem::GetTickableTickType() const
+{
+	// The CDO never ticks
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UShooterTickableWorldSubsystem::IsTickable() const
+{
+	return bIsInitialized && !IsTemplate();
+}
+
+UWorld* UShooterTickableWorldSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
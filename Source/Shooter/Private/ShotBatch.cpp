@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShotBatch.h"
+#include "Engine/NetSerialization.h"
+
+uint32 ShotBatch::PackDirection(const FVector& Direction)
+{
+	const FRotator Rotation{ Direction.Rotation() };
+
+	const uint32 Yaw{ FRotator::CompressAxisToShort(Rotation.Yaw) };
+	const uint32 Pitch{ static_cast<uint32>(FMath::RoundToInt((FMath::Clamp(Rotation.Pitch, -90.f, 90.f) + 90.f) / 180.f * MAX_uint16)) };
+
+	return (Yaw << 16) | Pitch;
+}
+
+FVector ShotBatch::UnpackDirection(uint32 PackedDirection)
+{
+	const float Yaw{ FRotator::DecompressAxisFromShort(static_cast<uint16>(PackedDirection >> 16)) };
+	const float Pitch{ static_cast<float>(PackedDirection & MAX_uint16) / MAX_uint16 * 180.f - 90.f };
+
+	return FRotator(Pitch, Yaw, 0.f).Vector();
+}
+
+bool FShotBatch::Add(uint16 Sequence, const FVector& Start, const FVector& Direction, float Time)
+{
+	float PreviousTime{ BaseTime };
+
+	if (Shots.Num() > 0)
+	{
+		if (Shots.Num() == ShotBatch::MaxShots || Sequence != static_cast<uint16>(FirstSequence + Shots.Num()))
+		{
+			return false;
+		}
+
+		TArray<float, TInlineAllocator<ShotBatch::MaxShots>> Times;
+		GetShotTimes(Times);
+		PreviousTime = Times.Last();
+	}
+
+	const int32 TimeOffset{ Shots.Num() > 0 ? FMath::RoundToInt(FMath::Max(Time - PreviousTime, 0.f) / ShotBatch::TimeStep) : 0 };
+
+	if (TimeOffset > ShotBatch::MaxTimeOffset)
+	{
+		return false;
+	}
+
+	if (Shots.Num() == 0)
+	{
+		FirstSequence = Sequence;
+		BaseTime = Time;
+	}
+
+	FBatchedShot& Shot{ Shots.AddDefaulted_GetRef() };
+	Shot.Start = FVector(FMath::RoundToFloat(Start.X), FMath::RoundToFloat(Start.Y), FMath::RoundToFloat(Start.Z));
+	Shot.Direction = ShotBatch::PackDirection(Direction);
+	Shot.TimeOffset = static_cast<uint8>(TimeOffset);
+
+	return true;
+}
+
+void FShotBatch::Reset()
+{
+	Shots.Reset();
+}
+
+void FShotBatch::GetShotTimes(TArray<float, TInlineAllocator<ShotBatch::MaxShots>>& OutTimes) const
+{
+	OutTimes.Reset();
+
+	float Time{ BaseTime };
+
+	for (const FBatchedShot& Shot : Shots)
+	{
+		Time += Shot.TimeOffset * ShotBatch::TimeStep;
+		OutTimes.Add(Time);
+	}
+}
+
+bool FShotBatch::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	bOutSuccess = true;
+
+	Ar << FirstSequence;
+	Ar << BaseTime;
+
+	uint32 NumShots{ static_cast<uint32>(Shots.Num()) };
+	Ar.SerializeInt(NumShots, ShotBatch::MaxShots + 1);
+
+	if (Ar.IsLoading())
+	{
+		Shots.SetNumUninitialized(NumShots);
+	}
+
+	FVector PreviousStart{ FVector::ZeroVector };
+
+	for (FBatchedShot& Shot : Shots)
+	{
+		// Shots of a batch start close together, so their deltas pack into few bits
+		FVector StartDelta{ Shot.Start - PreviousStart };
+		bOutSuccess &= SerializePackedVector<1, 24>(StartDelta, Ar);
+
+		if (Ar.IsLoading())
+		{
+			Shot.Start = PreviousStart + StartDelta;
+		}
+
+		PreviousStart = Shot.Start;
+
+		Ar << Shot.Direction;
+		Ar << Shot.TimeOffset;
+	}
+
+	return true;
+}
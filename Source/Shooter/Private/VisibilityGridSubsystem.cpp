@@ -0,0 +1,412 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VisibilityGridSubsystem.h"
+#include "Engine/World.h"
+#include "NavigationSystem.h"
+#include "NavigationData.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "../Shooter.h"
+
+namespace VisibilityGrid
+{
+	/** "SVIS" */
+	constexpr uint32 Magic{ 0x53495653 };
+	constexpr uint32 Version{ 1 };
+
+	/** Height of the trace end points above the navmesh */
+	constexpr float DefaultEyeHeight{ 120.f };
+
+	int64 AlignTo8(int64 Size)
+	{
+		return Align(Size, 8);
+	}
+}
+
+FVisibilityGrid::~FVisibilityGrid()
+{
+	Unload();
+}
+
+bool FVisibilityGrid::Load(const FString& Path)
+{
+	Unload();
+
+	IPlatformFile& PlatformFile{ FPlatformFileManager::Get().GetPlatformFile() };
+
+	if (!PlatformFile.FileExists(*Path))
+	{
+		return false;
+	}
+
+	MappedFile.Reset(PlatformFile.OpenMapped(*Path));
+
+	if (MappedFile)
+	{
+		MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	}
+
+	bool bValid{ false };
+
+	if (MappedRegion)
+	{
+		bValid = SetData(MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize());
+	}
+	else if (FFileHelper::LoadFileToArray(FileData, *Path))
+	{
+		bValid = SetData(FileData.GetData(), FileData.Num());
+	}
+
+	if (!bValid)
+	{
+		UE_LOG(LogShooter, Warning, TEXT("Visibility grid %s is invalid or out of date; bake it again"), *Path);
+		Unload();
+	}
+
+	return bValid;
+}
+
+void FVisibilityGrid::Unload()
+{
+	Header = nullptr;
+	CellIndices = nullptr;
+	VisibleBits = nullptr;
+	BlockedBits = nullptr;
+	DataSize = 0;
+
+	// The region must go before the file it maps
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	FileData.Empty();
+}
+
+bool FVisibilityGrid::SetData(const uint8* InData, int64 InDataSize)
+{
+	if (InData == nullptr || InDataSize < static_cast<int64>(sizeof(FVisibilityGridHeader)))
+	{
+		return false;
+	}
+
+	const FVisibilityGridHeader* InHeader{ reinterpret_cast<const FVisibilityGridHeader*>(InData) };
+
+	if (InHeader->Magic != VisibilityGrid::Magic || InHeader->Version != VisibilityGrid::Version
+		|| InHeader->SizeX <= 0 || InHeader->SizeY <= 0 || InHeader->NumCells < 0 || InHeader->CellSize <= 0.f
+		|| InHeader->WordsPerRow != FMath::DivideAndRoundUp(InHeader->NumCells, 64))
+	{
+		return false;
+	}
+
+	const int64 IndicesOffset{ VisibilityGrid::AlignTo8(sizeof(FVisibilityGridHeader)) };
+	const int64 VisibleOffset{ VisibilityGrid::AlignTo8(IndicesOffset + static_cast<int64>(InHeader->SizeX) * InHeader->SizeY * sizeof(int32)) };
+	const int64 BitsSize{ static_cast<int64>(InHeader->NumCells) * InHeader->WordsPerRow * sizeof(uint64) };
+	const int64 BlockedOffset{ VisibleOffset + BitsSize };
+
+	if (BlockedOffset + BitsSize > InDataSize)
+	{
+		return false;
+	}
+
+	Header = InHeader;
+	CellIndices = reinterpret_cast<const int32*>(InData + IndicesOffset);
+	VisibleBits = reinterpret_cast<const uint64*>(InData + VisibleOffset);
+	BlockedBits = reinterpret_cast<const uint64*>(InData + BlockedOffset);
+	DataSize = InDataSize;
+
+	return true;
+}
+
+int32 FVisibilityGrid::GetCellIndex(const FVector& Location) const
+{
+	const int32 X{ FMath::FloorToInt((Location.X - Header->OriginX) / Header->CellSize) };
+	const int32 Y{ FMath::FloorToInt((Location.Y - Header->OriginY) / Header->CellSize) };
+
+	if (X < 0 || Y < 0 || X >= Header->SizeX || Y >= Header->SizeY)
+	{
+		return INDEX_NONE;
+	}
+
+	return CellIndices[Y * Header->SizeX + X];
+}
+
+EGridVisibility FVisibilityGrid::GetVisibility(const FVector& From, const FVector& To) const
+{
+	if (Header == nullptr)
+	{
+		return EGridVisibility::Unknown;
+	}
+
+	const int32 FromCell{ GetCellIndex(From) };
+	const int32 ToCell{ GetCellIndex(To) };
+
+	if (FromCell == INDEX_NONE || ToCell == INDEX_NONE)
+	{
+		return EGridVisibility::Unknown;
+	}
+
+	const int64 Word{ static_cast<int64>(FromCell) * Header->WordsPerRow + ToCell / 64 };
+	const uint64 Bit{ 1ull << (ToCell % 64) };
+
+	const bool bVisible{ (VisibleBits[Word] & Bit) != 0 };
+	const bool bBlocked{ (BlockedBits[Word] & Bit) != 0 };
+
+	if (bVisible != bBlocked)
+	{
+		return bVisible ? EGridVisibility::Visible : EGridVisibility::Occluded;
+	}
+
+	return EGridVisibility::Unknown;
+}
+
+bool FVisibilityGrid::Bake(UWorld* World, float CellSize, int32 SamplesPerAxis, float EyeHeight, float MaxDistance, TArray<uint8>& OutData)
+{
+	UNavigationSystemV1* NavSys{ World ? FNavigationSystem::GetCurrent<UNavigationSystemV1>(World) : nullptr };
+	const ANavigationData* NavData{ NavSys ? NavSys->GetDefaultNavDataInstance() : nullptr };
+
+	if (NavData == nullptr || CellSize <= 0.f)
+	{
+		return false;
+	}
+
+	const FBox Bounds{ NavData->GetBounds() };
+
+	if (!Bounds.IsValid)
+	{
+		return false;
+	}
+
+	SamplesPerAxis = FMath::Clamp(SamplesPerAxis, 1, 4);
+
+	FVisibilityGridHeader NewHeader;
+	NewHeader.Magic = VisibilityGrid::Magic;
+	NewHeader.Version = VisibilityGrid::Version;
+	NewHeader.CellSize = CellSize;
+	NewHeader.OriginX = Bounds.Min.X;
+	NewHeader.OriginY = Bounds.Min.Y;
+	NewHeader.SizeX = FMath::Max(FMath::CeilToInt(Bounds.GetSize().X / CellSize), 1);
+	NewHeader.SizeY = FMath::Max(FMath::CeilToInt(Bounds.GetSize().Y / CellSize), 1);
+	NewHeader.Padding = 0;
+
+	// Eye points of each walkable cell, found by projecting a few points of the cell onto the navmesh
+	TArray<int32> Indices;
+	Indices.Init(INDEX_NONE, NewHeader.SizeX * NewHeader.SizeY);
+
+	TArray<TArray<FVector>> CellSamples;
+	TArray<FVector> CellCenters;
+
+	const FVector ProjectionExtent{ CellSize / (2.f * SamplesPerAxis), CellSize / (2.f * SamplesPerAxis), Bounds.GetSize().Z };
+
+	for (int32 Y = 0; Y < NewHeader.SizeY; Y++)
+	{
+		for (int32 X = 0; X < NewHeader.SizeX; X++)
+		{
+			TArray<FVector> Samples;
+
+			for (int32 SampleY = 0; SampleY < SamplesPerAxis; SampleY++)
+			{
+				for (int32 SampleX = 0; SampleX < SamplesPerAxis; SampleX++)
+				{
+					const FVector Point{
+						NewHeader.OriginX + (X + (SampleX + .5f) / SamplesPerAxis) * CellSize,
+						NewHeader.OriginY + (Y + (SampleY + .5f) / SamplesPerAxis) * CellSize,
+						Bounds.GetCenter().Z };
+
+					FNavLocation NavLocation;
+					if (NavSys->ProjectPointToNavigation(Point, NavLocation, ProjectionExtent, NavData))
+					{
+						Samples.Add(NavLocation.Location + FVector(0.f, 0.f, EyeHeight));
+					}
+				}
+			}
+
+			if (Samples.Num() > 0)
+			{
+				Indices[Y * NewHeader.SizeX + X] = CellSamples.Num();
+				CellCenters.Add(FVector(NewHeader.OriginX + (X + .5f) * CellSize, NewHeader.OriginY + (Y + .5f) * CellSize, 0.f));
+				CellSamples.Add(MoveTemp(Samples));
+			}
+		}
+	}
+
+	const int32 NumCells{ CellSamples.Num() };
+	NewHeader.NumCells = NumCells;
+	NewHeader.WordsPerRow = FMath::DivideAndRoundUp(NumCells, 64);
+
+	const int64 IndicesOffset{ VisibilityGrid::AlignTo8(sizeof(FVisibilityGridHeader)) };
+	const int64 VisibleOffset{ VisibilityGrid::AlignTo8(IndicesOffset + Indices.Num() * sizeof(int32)) };
+	const int64 BitsSize{ static_cast<int64>(NumCells) * NewHeader.WordsPerRow * sizeof(uint64) };
+
+	OutData.Reset();
+	OutData.AddZeroed(VisibleOffset + 2 * BitsSize);
+
+	FMemory::Memcpy(OutData.GetData(), &NewHeader, sizeof(FVisibilityGridHeader));
+	FMemory::Memcpy(OutData.GetData() + IndicesOffset, Indices.GetData(), Indices.Num() * sizeof(int32));
+
+	uint64* Visible{ reinterpret_cast<uint64*>(OutData.GetData() + VisibleOffset) };
+	uint64* Blocked{ reinterpret_cast<uint64*>(OutData.GetData() + VisibleOffset + BitsSize) };
+
+	auto SetBit = [&NewHeader](uint64* Bits, int32 Row, int32 Column)
+	{
+		Bits[static_cast<int64>(Row) * NewHeader.WordsPerRow + Column / 64] |= 1ull << (Column % 64);
+	};
+
+	// Only static geometry occludes; pawns and physics bodies move
+	const FCollisionObjectQueryParams ObjectParams(ECollisionChannel::ECC_WorldStatic);
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(VisibilityGridBake), false);
+	const float MaxDistanceSquared{ MaxDistance > 0.f ? FMath::Square(MaxDistance) : MAX_flt };
+
+	for (int32 i = 0; i < NumCells; i++)
+	{
+		for (int32 j = i + 1; j < NumCells; j++)
+		{
+			if (FVector::DistSquared2D(CellCenters[i], CellCenters[j]) > MaxDistanceSquared)
+			{
+				continue;
+			}
+
+			bool bAnyVisible{ false };
+			bool bAnyBlocked{ false };
+
+			for (const FVector& From : CellSamples[i])
+			{
+				for (const FVector& To : CellSamples[j])
+				{
+					if (World->LineTraceTestByObjectType(From, To, ObjectParams, QueryParams))
+					{
+						bAnyBlocked = true;
+					}
+					else
+					{
+						bAnyVisible = true;
+					}
+				}
+
+				if (bAnyVisible && bAnyBlocked)
+				{
+					break;
+				}
+			}
+
+			// Symmetric; both rows get the bits so queries need no ordering
+			if (bAnyVisible)
+			{
+				SetBit(Visible, i, j);
+				SetBit(Visible, j, i);
+			}
+
+			if (bAnyBlocked)
+			{
+				SetBit(Blocked, i, j);
+				SetBit(Blocked, j, i);
+			}
+		}
+
+		// Within a cell the grid cannot tell; both bits leave it to a trace
+		SetBit(Visible, i, i);
+		SetBit(Blocked, i, i);
+	}
+
+	return true;
+}
+
+FString FVisibilityGrid::GetGridPath(const FString& MapName)
+{
+	return FPaths::ProjectContentDir() / TEXT("VisibilityGrids") / MapName + TEXT(".vis");
+}
+
+bool UVisibilityGridSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	const UWorld* World{ Cast<UWorld>(Outer) };
+
+	return World && World->IsGameWorld();
+}
+
+void UVisibilityGridSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	LoadGrid();
+}
+
+void UVisibilityGridSubsystem::Deinitialize()
+{
+	UnloadGrid();
+
+	Super::Deinitialize();
+}
+
+void UVisibilityGridSubsystem::LoadGrid()
+{
+	const FString Path{ FVisibilityGrid::GetGridPath(GetMapName()) };
+
+	if (Grid.Load(Path))
+	{
+		UE_LOG(LogShooter, Log, TEXT("Loaded visibility grid %s: %d cells, %lld bytes"), *Path, Grid.GetNumCells(), Grid.GetDataSize());
+	}
+}
+
+void UVisibilityGridSubsystem::UnloadGrid()
+{
+	Grid.Unload();
+}
+
+const FVisibilityGrid* UVisibilityGridSubsystem::GetGrid() const
+{
+	return Grid.IsLoaded() ? &Grid : nullptr;
+}
+
+FString UVisibilityGridSubsystem::GetMapName() const
+{
+	return UWorld::RemovePIEPrefix(FPackageName::GetShortName(GetWorld()->GetOutermost()));
+}
+
+namespace
+{
+	void BakeVisibilityGrid(const TArray<FString>& Args, UWorld* World)
+	{
+		UVisibilityGridSubsystem* GridSubsystem{ World ? World->GetSubsystem<UVisibilityGridSubsystem>() : nullptr };
+
+		if (GridSubsystem == nullptr)
+		{
+			return;
+		}
+
+		const float CellSize{ Args.Num() > 0 ? FCString::Atof(*Args[0]) : 400.f };
+		const int32 SamplesPerAxis{ Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 2 };
+		const float MaxDistance{ Args.Num() > 2 ? FCString::Atof(*Args[2]) : 6'000.f };
+
+		const uint64 StartCycles{ FPlatformTime::Cycles64() };
+
+		TArray<uint8> Data;
+		if (!FVisibilityGrid::Bake(World, CellSize, SamplesPerAxis, VisibilityGrid::DefaultEyeHeight, MaxDistance, Data))
+		{
+			UE_LOG(LogShooter, Warning, TEXT("Visibility.Bake: the map has no navmesh to bake over"));
+			return;
+		}
+
+		const FString Path{ FVisibilityGrid::GetGridPath(GridSubsystem->GetMapName()) };
+
+		// A mapped file cannot be overwritten on every platform
+		GridSubsystem->UnloadGrid();
+
+		if (!FFileHelper::SaveArrayToFile(Data, *Path))
+		{
+			UE_LOG(LogShooter, Warning, TEXT("Visibility.Bake: could not write %s"), *Path);
+			return;
+		}
+
+		UE_LOG(LogShooter, Log, TEXT("Visibility.Bake: wrote %s (%d bytes) in %.1f s"),
+			*Path, Data.Num(), FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles));
+
+		GridSubsystem->LoadGrid();
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs BakeVisibilityGridCommand(
+		TEXT("Shooter.Visibility.Bake"),
+		TEXT("Bakes the cell-to-cell visibility grid of the current map. Usage: Shooter.Visibility.Bake [CellSize=400] [SamplesPerAxis=2] [MaxDistance=6000]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BakeVisibilityGrid));
+}
@@ -2,6 +2,8 @@
 
 
 #include "Weapon.h"
+#include "ShooterCosmetics.h"
+#include "ShooterRandomSubsystem.h"
 
 AWeapon::AWeapon() :
 	ThrowWeaponTime(1.f),
@@ -49,7 +51,7 @@ void AWeapon::ThrowWeapon()
 	// Direction in which the weapon is thrown
 	FVector ImpulseDirection = MeshRight.RotateAngleAxis(-20.f, MeshForward);
 
-	float RandomRotation{ FMath::FRandRange(0.f, 60.f) };
+	float RandomRotation{ UShooterRandomSubsystem::GetStream(this, EShooterRandomStream::WeaponThrow).FRandRange(0.f, 60.f) };
 	ImpulseDirection = ImpulseDirection.RotateAngleAxis(RandomRotation, FVector(0.f, 0.f, 1.f));
 	ImpulseDirection *= ImpulseAmplifier;
 	GetItemMesh()->AddImpulse(ImpulseDirection);
@@ -166,7 +168,7 @@ void AWeapon::OnConstruction(const FTransform& Transform)
 			HeadShotDamage = WeaponDataRow->Damage * 2.5f * GetDamageMultiplier();
 		}
 
-		if (GetMaterialInstance())
+		if (GetMaterialInstance() && !ShooterCosmetics::AreStripped())
 		{
 			SetDynamicMaterialInstance(UMaterialInstanceDynamic::Create(GetMaterialInstance(), this));
 			GetDynamicMaterialInstance()->SetVectorParameterValue(TEXT("EmissiveColor"), GetGlowColor());
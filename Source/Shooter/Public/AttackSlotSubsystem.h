@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShooterTickableWorldSubsystem.h"
+#include "WorldCollision.h"
+#include "AttackSlotSubsystem.generated.h"
+
+/** A place around a target one enemy can attack from */
+struct FAttackSlot
+{
+	FVector Location;
+
+	/** Checked against the navmesh and traced from the target */
+	bool bScored = false;
+
+	/** On the navmesh with a clear line to the target */
+	bool bValid = false;
+
+	TWeakObjectPtr<APawn> Occupant;
+};
+
+/** The ring of slots around one target, shared by every enemy attacking it */
+struct FAttackRing
+{
+	TWeakObjectPtr<AActor> Target;
+
+	/** Target location the slots were placed around */
+	FVector Center;
+
+	TArray<FAttackSlot> Slots;
+};
+
+/** An enemy asking for a slot */
+struct FAttackSlotRequest
+{
+	TWeakObjectPtr<AActor> Target;
+
+	/** Requests not renewed for a while are dropped along with their slot */
+	float LastRequestTime = 0.f;
+};
+
+/** A slot trace in flight */
+struct FPendingSlotTrace
+{
+	TWeakObjectPtr<AActor> Target;
+	int32 SlotIndex = INDEX_NONE;
+	FVector Location;
+};
+
+/**
+ * Spreads enemies around their target instead of letting them pile up on the same spot.
+ * Keeps one ring of candidate slots per target. Slots are checked against the navmesh and traced from
+ * the target asynchronously within a per-frame budget, once for every enemy using the ring, and enemies
+ * are assigned to the valid slots in bulk at a fixed rate.
+ */
+UCLASS()
+class SHOOTER_API UAttackSlotSubsystem : public UShooterTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/**
+	 * Asks for a slot around Target; call every frame while approaching it.
+	 * @return false until a slot is assigned to Pawn
+	 */
+	bool RequestSlot(APawn* Pawn, AActor* Target, FVector& OutLocation);
+
+	/** Gives up the slot of Pawn, if any */
+	void ReleaseSlot(APawn* Pawn);
+
+	FORCEINLINE const TArray<FAttackRing>& GetRings() const { return Rings; }
+
+private:
+	/** Drops stale requests, adds and removes rings, and moves rings whose target moved */
+	void UpdateRings();
+
+	/** Starts navmesh checks and traces of unscored slots within the frame budget */
+	void ScoreSlots();
+
+	/** Hands the valid slots of each ring to the enemies asking for it */
+	void AssignSlots();
+
+	void PlaceSlots(FAttackRing& Ring, const FVector& Center) const;
+
+	FAttackRing* FindRing(const AActor* Target);
+
+	void OnSlotTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum);
+
+	TArray<FAttackRing> Rings;
+
+	TMap<TWeakObjectPtr<APawn>, FAttackSlotRequest> Requests;
+
+	TMap<uint32, FPendingSlotTrace> PendingSlotTraces;
+
+	FTraceDelegate SlotTraceDelegate;
+
+	uint32 NextSlotTraceId;
+
+	/** Time since slots were last assigned */
+	float TimeSinceAssign;
+};
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BehaviorTree/BTService.h"
+#include "BehaviorTree/BlackboardComponent.h"
+#include "BTService_GruxCombat.generated.h"
+
+/**
+ * Keeps the enemy focused on Target and stops it when Stunned or Dead is set.
+ * Reacts to blackboard changes through observers; it never ticks.
+ */
+UCLASS()
+class SHOOTER_API UBTService_GruxCombat : public UBTService
+{
+	GENERATED_BODY()
+
+public:
+	UBTService_GruxCombat();
+
+	virtual void InitializeFromAsset(UBehaviorTree& Asset) override;
+
+protected:
+	virtual void OnBecomeRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+	virtual void OnCeaseRelevant(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+
+	EBlackboardNotificationResult OnBlackboardKeyChanged(const UBlackboardComponent& Blackboard, FBlackboard::FKey ChangedKeyID);
+
+	/** Applies the current blackboard values to the controller */
+	void UpdateFocus(const UBlackboardComponent& Blackboard) const;
+
+	UPROPERTY(EditAnywhere, Category = Blackboard)
+	FBlackboardKeySelector TargetKey;
+
+	UPROPERTY(EditAnywhere, Category = Blackboard)
+	FBlackboardKeySelector StunnedKey;
+
+	UPROPERTY(EditAnywhere, Category = Blackboard)
+	FBlackboardKeySelector DeadKey;
+};
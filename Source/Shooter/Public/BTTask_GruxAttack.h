@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BehaviorTree/BTTaskNode.h"
+#include "BTTask_GruxAttack.generated.h"
+
+/**
+ * Plays a random attack section when InAttackRange and CanAttack are both set.
+ * AEnemy clears CanAttack until its attack wait time has passed.
+ */
+UCLASS()
+class SHOOTER_API UBTTask_GruxAttack : public UBTTaskNode
+{
+	GENERATED_BODY()
+
+public:
+	UBTTask_GruxAttack();
+
+	virtual void InitializeFromAsset(UBehaviorTree& Asset) override;
+	virtual EBTNodeResult::Type ExecuteTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+
+protected:
+	UPROPERTY(EditAnywhere, Category = Blackboard)
+	FBlackboardKeySelector InAttackRangeKey;
+
+	UPROPERTY(EditAnywhere, Category = Blackboard)
+	FBlackboardKeySelector CanAttackKey;
+
+	/** Play rate of the attack montage */
+	UPROPERTY(EditAnywhere, Category = Node, meta = (ClampMin = "0.0"))
+	float PlayRate;
+};
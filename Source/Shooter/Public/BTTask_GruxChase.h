@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BehaviorTree/BTTaskNode.h"
+#include "BTTask_GruxChase.generated.h"
+
+/** Per-enemy state of the chase task */
+struct FBTGruxChaseMemory
+{
+	/** True while steering with the flow field or toward an attack slot, false while following a regular path */
+	bool bSteering;
+};
+
+/**
+ * Follows the actor in Target until within AcceptanceRadius.
+ * Steers with the target's shared flow field when the enemy is inside it, and falls back to a
+ * regular path request when it is not. Close to the target, heads for an attack slot around it
+ * instead so groups spread out.
+ */
+UCLASS()
+class SHOOTER_API UBTTask_GruxChase : public UBTTaskNode
+{
+	GENERATED_BODY()
+
+public:
+	UBTTask_GruxChase();
+
+	virtual void InitializeFromAsset(UBehaviorTree& Asset) override;
+	virtual EBTNodeResult::Type ExecuteTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+	virtual EBTNodeResult::Type AbortTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+	virtual uint16 GetInstanceMemorySize() const override;
+	virtual FString GetStaticDescription() const override;
+
+protected:
+	virtual void TickTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, float DeltaSeconds) override;
+
+	/** Requests a regular path to the target and waits for it to finish */
+	EBTNodeResult::Type StartPathFollowing(UBehaviorTreeComponent& OwnerComp, FBTGruxChaseMemory* Memory, AActor* Target);
+
+	AActor* GetTarget(const UBehaviorTreeComponent& OwnerComp) const;
+
+	/** Location of the attack slot assigned to Pawn, if it is close enough to Target to ask for one */
+	bool GetAttackSlot(const UBehaviorTreeComponent& OwnerComp, APawn* Pawn, AActor* Target, FVector& OutLocation) const;
+
+	UPROPERTY(EditAnywhere, Category = Blackboard)
+	FBlackboardKeySelector TargetKey;
+
+	UPROPERTY(EditAnywhere, Category = Node, meta = (ClampMin = "0.0"))
+	float AcceptanceRadius;
+
+	/** Use the shared flow field of the target when there is one */
+	UPROPERTY(EditAnywhere, Category = Node)
+	bool bUseFlowField;
+
+	/** Head for an attack slot around the target instead of the target itself */
+	UPROPERTY(EditAnywhere, Category = Node)
+	bool bUseAttackSlots;
+
+	/** Distance to the target at which the enemy starts asking for an attack slot */
+	UPROPERTY(EditAnywhere, Category = Node, meta = (ClampMin = "0.0", EditCondition = "bUseAttackSlots"))
+	float SlotApproachDistance;
+
+	/** Distance to the attack slot at which the chase succeeds */
+	UPROPERTY(EditAnywhere, Category = Node, meta = (ClampMin = "0.0", EditCondition = "bUseAttackSlots"))
+	float SlotAcceptanceRadius;
+};
@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BehaviorTree/BTTaskNode.h"
+#include "BTTask_GruxDead.generated.h"
+
+/**
+ * Stops the enemy for good. Never finishes and never ticks, so a dead enemy costs
+ * nothing in the behavior tree until it is destroyed.
+ */
+UCLASS()
+class SHOOTER_API UBTTask_GruxDead : public UBTTaskNode
+{
+	GENERATED_BODY()
+
+public:
+	UBTTask_GruxDead();
+
+	virtual EBTNodeResult::Type ExecuteTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+};
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BehaviorTree/BTTaskNode.h"
+#include "BTTask_GruxPatrol.generated.h"
+
+/** Per-enemy state of the patrol task */
+struct FBTGruxPatrolMemory
+{
+	/** True when the next move goes to the second patrol point */
+	bool bToSecondPoint;
+};
+
+/**
+ * Walks to PatrolPoint and PatrolPoint2 in turn, one point per execution.
+ * Follows the cached route between the points when there is one, and finishes when the
+ * path following component reports the move as finished.
+ */
+UCLASS()
+class SHOOTER_API UBTTask_GruxPatrol : public UBTTaskNode
+{
+	GENERATED_BODY()
+
+public:
+	UBTTask_GruxPatrol();
+
+	virtual void InitializeFromAsset(UBehaviorTree& Asset) override;
+	virtual EBTNodeResult::Type ExecuteTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+	virtual EBTNodeResult::Type AbortTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+	virtual uint16 GetInstanceMemorySize() const override;
+	virtual FString GetStaticDescription() const override;
+
+protected:
+	UPROPERTY(EditAnywhere, Category = Blackboard)
+	FBlackboardKeySelector PatrolPointKey;
+
+	UPROPERTY(EditAnywhere, Category = Blackboard)
+	FBlackboardKeySelector PatrolPoint2Key;
+
+	UPROPERTY(EditAnywhere, Category = Node, meta = (ClampMin = "0.0"))
+	float AcceptanceRadius;
+
+	/** How close to the other patrol point the enemy must be to reuse the cached route */
+	UPROPERTY(EditAnywhere, Category = Node, meta = (ClampMin = "0.0"))
+	float RouteStartTolerance;
+};
@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BehaviorTree/BTTaskNode.h"
+#include "BehaviorTree/BlackboardComponent.h"
+#include "BTTask_GruxStunned.generated.h"
+
+class AEnemy;
+
+/** Per-enemy state of the stunned task */
+struct FBTGruxStunnedMemory
+{
+	FTimerHandle StunTimer;
+};
+
+/**
+ * Stands still while Stunned is set. Finishes as soon as the key is cleared, through a blackboard
+ * observer rather than a tick. Clears the stun itself after MaxStunTime in case nothing else does.
+ */
+UCLASS()
+class SHOOTER_API UBTTask_GruxStunned : public UBTTaskNode
+{
+	GENERATED_BODY()
+
+public:
+	UBTTask_GruxStunned();
+
+	virtual void InitializeFromAsset(UBehaviorTree& Asset) override;
+	virtual EBTNodeResult::Type ExecuteTask(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory) override;
+	virtual void OnTaskFinished(UBehaviorTreeComponent& OwnerComp, uint8* NodeMemory, EBTNodeResult::Type TaskResult) override;
+	virtual uint16 GetInstanceMemorySize() const override;
+
+protected:
+	EBlackboardNotificationResult OnStunnedChanged(const UBlackboardComponent& Blackboard, FBlackboard::FKey ChangedKeyID);
+
+	void OnStunTimeElapsed(TWeakObjectPtr<AEnemy> Enemy);
+
+	UPROPERTY(EditAnywhere, Category = Blackboard)
+	FBlackboardKeySelector StunnedKey;
+
+	/** Longest time the enemy stays stunned. 0: wait for the key to be cleared */
+	UPROPERTY(EditAnywhere, Category = Node, meta = (ClampMin = "0.0"))
+	float MaxStunTime;
+};
@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShooterTickableWorldSubsystem.h"
+#include "DetonationQueueSubsystem.generated.h"
+
+class AExplosive;
+class AExplosiveField;
+
+/** Something a blast can set off: an AExplosive, or one instance of an AExplosiveField */
+struct FDetonationTarget
+{
+	TWeakObjectPtr<AActor> Owner;
+
+	/** Stable id of the AExplosiveField instance; INDEX_NONE for an AExplosive */
+	int32 InstanceId = INDEX_NONE;
+
+	FVector Location;
+};
+
+/** An explosive set off by another explosion, waiting for its turn */
+struct FPendingDetonation
+{
+	FDetonationTarget Target;
+
+	/** World time at which the explosive may go off */
+	float DetonateTime;
+
+	TWeakObjectPtr<AActor> Shooter;
+	TWeakObjectPtr<AController> ShooterController;
+
+	/** Earliest detonation on top of the heap */
+	bool operator<(const FPendingDetonation& Other) const { return DetonateTime < Other.DetonateTime; }
+};
+
+/** A VFX spawn that did not fit in the budget of the frame it was requested in */
+struct FPendingExplosionVFX
+{
+	TWeakObjectPtr<class UParticleSystem> Template;
+	FVector Location;
+};
+
+/** Cost of the detonation queue in a single frame */
+struct FDetonationFrameStats
+{
+	int32 Detonations = 0;
+	int32 Traces = 0;
+	int32 VFXSpawns = 0;
+	int32 Backlog = 0;
+	int32 VFXBacklog = 0;
+
+	/** Time spent resolving queued detonations */
+	double TimeMs = 0.0;
+};
+
+/**
+ * Spreads chain reactions between explosives over several frames.
+ * Explosives set off by other explosions are scheduled with a short delay and resolved
+ * under a per-frame budget of detonations, occlusion traces and VFX spawns.
+ */
+UCLASS()
+class SHOOTER_API UDetonationQueueSubsystem : public UShooterTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Called by explosives and explosive fields when they begin and end play */
+	void RegisterExplosive(AExplosive* Explosive);
+	void UnregisterExplosive(AExplosive* Explosive);
+	void RegisterExplosiveField(AExplosiveField* Field);
+	void UnregisterExplosiveField(AExplosiveField* Field);
+
+	/** Gathers explosives and field instances within Radius of Origin that are not already going off */
+	void GatherChainTargets(const FVector& Origin, float Radius, TArray<FDetonationTarget>& OutTargets) const;
+
+	/** Schedules a target to go off after a delay based on its distance from the blast */
+	void ScheduleDetonation(const FDetonationTarget& Target, float Distance, AActor* Shooter, AController* ShooterController);
+
+	/** Spawns the effect now if the frame budget allows it, otherwise on a later frame */
+	void RequestVFX(UParticleSystem* Template, const FVector& Location);
+
+	/** Charges work done outside of the queue (direct bullet hits) to this frame's budget */
+	void ChargeDetonation(int32 NumTraces);
+
+	FORCEINLINE int32 GetBacklog() const { return PendingDetonations.Num(); }
+	FORCEINLINE int32 GetVFXBacklog() const { return PendingVFX.Num(); }
+	FORCEINLINE const FDetonationFrameStats& GetLastFrameStats() const { return LastFrameStats; }
+	FORCEINLINE const FDetonationFrameStats& GetPeakFrameStats() const { return PeakFrameStats; }
+
+private:
+	void SpawnPendingVFX();
+
+	void ResetFrameStats();
+
+	/** Min-heap of scheduled detonations ordered by DetonateTime */
+	TArray<FPendingDetonation> PendingDetonations;
+
+	/** Effects deferred to a later frame, oldest first */
+	TArray<FPendingExplosionVFX> PendingVFX;
+
+	/** Every explosive in the world that can be chained */
+	TArray<TWeakObjectPtr<AExplosive>> Explosives;
+
+	/** Every instanced explosive field in the world */
+	TArray<TWeakObjectPtr<AExplosiveField>> ExplosiveFields;
+
+	/** Work done so far in the current frame */
+	FDetonationFrameStats FrameStats;
+
+	FDetonationFrameStats LastFrameStats;
+
+	/** Highest cost of any frame since the world started */
+	FDetonationFrameStats PeakFrameStats;
+};
@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
 #include "BulletHitInterface.h"
+#include "EnemyMovementSnapshot.h"
 #include "Enemy.generated.h"
 
 UCLASS()
@@ -20,6 +21,21 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
+	/** Resets the blackboard, starts patrolling and registers with perception and squads. Called again when leaving the pool */
+	void StartBehavior();
+
+	/** Unregisters from perception and squads */
+	void StopBehavior();
+
+	/** Writes the InAttackRange blackboard key if being in range and holding a token changed */
+	void UpdateAttackRangeKey();
+
 	UFUNCTION(BlueprintNativeEvent)
 	void ShowHealthBar();
 	void ShowHealthBar_Implementation();
@@ -29,6 +45,15 @@ protected:
 
 	void Die();
 
+	/** Death montage and no collision, on the server and on clients */
+	void PlayDeathVisuals();
+
+	/** Undoes the death visuals and the frozen pose for an enemy leaving the pool */
+	void ResetDeathVisuals();
+
+	UFUNCTION()
+	void OnRep_IsDying();
+
 	void PlayHitMontage(FName Section, float PlayRate = 1.f);
 
 	void ResetHitReactTimer();
@@ -41,26 +66,6 @@ protected:
 
 	void UpdateHitNumbers();
 
-	/** Called when player overlaps with agro sphere */
-	UFUNCTION()
-	void AgroSphereOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
-
-	UFUNCTION(BlueprintCallable)
-	void SetStunned(bool Stunned);
-
-	/** Called when player overlaps with combat sphere */
-	UFUNCTION()
-	void CombatSphereOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
-
-	UFUNCTION()
-	void CombatSphereEndOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
-
-	UFUNCTION(BlueprintCallable)
-	void PlayAttackMontage(FName Section, float PlayRate = 1.f);
-
-	UFUNCTION(BlueprintPure)
-	FName GetAttackSectionName();
-
 	UFUNCTION()
 	void OnLeftWeaponOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
 
@@ -90,6 +95,21 @@ protected:
 	UFUNCTION()
 	void DestroyEnemy();
 
+	/** Server: quantizes the current location and yaw into MovementSnapshot if they changed */
+	void UpdateMovementSnapshot();
+
+	/** Client: buffers the new snapshot for interpolation */
+	UFUNCTION()
+	void OnRep_MovementSnapshot();
+
+	/** Client: places the enemy between the buffered snapshots around the render time */
+	void InterpolateMovement();
+
+	/** Sets NetUpdateFrequency for the current movement tier */
+	void UpdateNetUpdateFrequency();
+
+	float GetServerTime() const;
+
 private:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
 	class UParticleSystem* ImpactVFX;
@@ -151,9 +171,9 @@ private:
 
 	class AEnemyController* EnemyController;
 
-	/** Overlap sphere for when the enemy becomes hostile */
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
-	class USphereComponent* AgroSphere;
+	/** Distance at which a player in sight makes the enemy hostile */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true", ClampMin = "0.0"))
+	float AgroRadius;
 
 	/** True when playing the hit animation */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
@@ -167,9 +187,22 @@ private:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
 	bool bIsInRange;
 
-	/** Overlap sphere for when the enemy may attack */
+	/** Distance to a player at which the enemy may attack */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true", ClampMin = "0.0"))
+	float CombatRange;
+
+	/** Last value written to the Target blackboard key */
+	TWeakObjectPtr<AActor> Target;
+
+	/** Enemies with the same name form one squad. Enemies without one are grouped with those nearby */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
-	USphereComponent* CombatRangeSphere;
+	FName SquadName;
+
+	/** Given by the squad coordinator; only enemies holding one may attack once in range */
+	bool bHasAttackToken;
+
+	/** Last value written to the InAttackRange blackboard key */
+	bool bAttackRangeKey;
 
 	/** Montage containing attack animations */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
@@ -206,6 +239,7 @@ private:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
 	UAnimMontage* DeathMontage;
 
+	UPROPERTY(ReplicatedUsing = OnRep_IsDying)
 	bool bIsDying;
 
 	FTimerHandle DeathTimer;
@@ -214,6 +248,34 @@ private:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
 	float DeathTime;
 
+	/** Seconds between movement updates while far from every player and off screen */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement, meta = (AllowPrivateAccess = "true", ClampMin = "0.0"))
+	float ReducedMovementTickInterval;
+
+	/** True while moving on the navmesh at the reduced rate instead of full walking physics */
+	bool bReducedMovement;
+
+	/** Snapshots sent per second while near a player or on screen */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement, meta = (AllowPrivateAccess = "true", ClampMin = "1.0"))
+	float FullNetUpdateFrequency;
+
+	/** Snapshots sent per second while on reduced movement */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement, meta = (AllowPrivateAccess = "true", ClampMin = "1.0"))
+	float ReducedNetUpdateFrequency;
+
+	/** Replaces the character movement replication */
+	UPROPERTY(ReplicatedUsing = OnRep_MovementSnapshot)
+	FEnemyMovementSnapshot MovementSnapshot;
+
+	/** Client: received snapshots, oldest first */
+	TArray<FEnemyMovementSample, TInlineAllocator<8>> MovementSamples;
+
+	/** Client: smoothed time between snapshots; the render delay follows it */
+	float SnapshotInterval;
+
+	/** Client: teleport count of the last snapshot */
+	uint8 LastTeleportCount;
+
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
@@ -231,4 +293,55 @@ public:
 	void ShowHitNumber(int32 Damage, FVector HitLocation, bool bIsHeadShot);
 
 	FORCEINLINE UBehaviorTree* GetBehaviorTree() const { return BehaviorTree; }
+
+	UFUNCTION(BlueprintCallable)
+	void SetStunned(bool Stunned);
+
+	UFUNCTION(BlueprintCallable)
+	void PlayAttackMontage(FName Section, float PlayRate = 1.f);
+
+	UFUNCTION(BlueprintPure)
+	FName GetAttackSectionName();
+
+	/** Writes the Target blackboard key if it changed */
+	void SetTarget(AActor* NewTarget);
+
+	/** Targets the actor and shares it with the squad */
+	void ReportTarget(AActor* NewTarget);
+
+	/** Sets whether a player is within CombatRange. The InAttackRange key is only set while holding an attack token */
+	void SetInAttackRange(bool bInRange);
+
+	void SetAttackToken(bool bHasToken);
+
+	/** Clears the target and sets the CharacterDead blackboard key */
+	void NotifyTargetDied();
+
+	FORCEINLINE AActor* GetTarget() const { return Target.Get(); }
+	FORCEINLINE bool GetIsInRange() const { return bIsInRange; }
+	FORCEINLINE bool GetHasAttackToken() const { return bHasAttackToken; }
+	FORCEINLINE FName GetSquadName() const { return SquadName; }
+	FORCEINLINE bool GetIsDying() const { return bIsDying; }
+	FORCEINLINE float GetAgroRadius() const { return AgroRadius; }
+	FORCEINLINE float GetCombatRange() const { return CombatRange; }
+
+	/**
+	 * Switches between full walking physics and nav walking at ReducedMovementTickInterval.
+	 * Only enemies on the ground are reduced, and switching back waits until there is room to stand.
+	 */
+	void SetReducedMovement(bool bReduced);
+
+	FORCEINLINE bool GetIsReducedMovement() const { return bReducedMovement; }
+
+	/** Seconds clients show an enemy behind the server when its snapshots arrive Interval apart */
+	static float GetInterpolationDelay(float Interval);
+
+	/** Server: the delay clients show this enemy with at its current net update frequency; shots at it are rewound that much further */
+	float GetClientInterpolationDelay() const;
+
+	/** Hides the enemy and stops everything it runs, until LeavePool */
+	void EnterPool();
+
+	/** Brings a pooled enemy back alive at SpawnTransform with full health */
+	void LeavePool(const FTransform& SpawnTransform);
 };
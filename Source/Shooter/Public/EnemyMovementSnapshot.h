@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "EnemyMovementSnapshot.generated.h"
+
+namespace EnemyMovement
+{
+	/** Bits of each offset inside a cell; offsets are whole centimeters */
+	constexpr int32 OffsetBits{ 10 };
+
+	/** Size of a cell in centimeters */
+	constexpr int32 CellSize{ 1 << OffsetBits };
+
+	/** Bits of the yaw; about 0.35 degrees of error */
+	constexpr int32 YawBits{ 10 };
+
+	/** Resolution of the time stamps in seconds */
+	constexpr float TimeStep{ 0.01f };
+
+	/** Time after which the 16-bit time stamps wrap around */
+	constexpr float TimeWrap{ (MAX_uint16 + 1) * TimeStep };
+
+	/** Number of distinct teleport counts before wrapping */
+	constexpr int32 MaxTeleports{ 4 };
+}
+
+/** Enemy location and yaw at a server time, decoded for interpolation */
+struct FEnemyMovementSample
+{
+	float Time = 0.f;
+	FVector Location = FVector::ZeroVector;
+	float Yaw = 0.f;
+};
+
+/**
+ * Replicated instead of the character movement of enemies.
+ * The location is sent as the cell it is in and a whole-centimeter offset inside it, with the yaw as the only rotation.
+ * Clients buffer the snapshots and interpolate between them a little behind the server.
+ */
+USTRUCT()
+struct FEnemyMovementSnapshot
+{
+	GENERATED_BODY()
+
+	FIntVector Cell = FIntVector::ZeroValue;
+
+	uint16 OffsetX = 0;
+	uint16 OffsetY = 0;
+	uint16 OffsetZ = 0;
+	uint16 Yaw = 0;
+
+	/** Server time in EnemyMovement::TimeStep units, wrapping */
+	uint16 TimeStamp = 0;
+
+	/** Changes when the enemy teleports, like leaving the pool, so clients do not interpolate across it */
+	uint8 TeleportCount = 0;
+
+	/** Quantizes the location and yaw; the client and the server decode the same values */
+	void Set(const FVector& Location, float InYaw, float ServerTime);
+
+	FVector GetLocation() const;
+	float GetYaw() const;
+
+	/** Time stamp unwrapped to the server time closest to NearServerTime */
+	float GetTime(float NearServerTime) const;
+
+	/** True when the location, yaw and teleport count are the same; the time stamp is ignored */
+	bool HasSameMovement(const FEnemyMovementSnapshot& Other) const;
+
+	/** Replication compares with this to find out whether to send the snapshot */
+	bool operator==(const FEnemyMovementSnapshot& Other) const;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FEnemyMovementSnapshot> : public TStructOpsTypeTraitsBase2<FEnemyMovementSnapshot>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithIdenticalViaEquality = true
+	};
+};
@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShooterTickableWorldSubsystem.h"
+#include "WorldCollision.h"
+#include "EnemyPerceptionSubsystem.generated.h"
+
+class AEnemy;
+class FVisibilityGrid;
+
+/** A line of sight trace in flight */
+struct FPendingSightTrace
+{
+	TWeakObjectPtr<AEnemy> Enemy;
+	TWeakObjectPtr<AActor> Player;
+};
+
+/** What the decision phase may read about one enemy; copied on the game thread before it starts */
+struct FEnemySnapshot
+{
+	/** Index into the player snapshot of the enemy's target, or INDEX_NONE if it has none or it is not a player */
+	int32 TargetPlayer = INDEX_NONE;
+
+	bool bHasTarget = false;
+	bool bAwaitingSight = false;
+	bool bReducedMovement = false;
+	bool bRecentlyRendered = false;
+};
+
+/** What the decision phase wants done to one enemy; applied on the game thread */
+struct FEnemyDecision
+{
+	/** Player to trace line of sight to before aggroing, or INDEX_NONE */
+	int32 SightPlayer = INDEX_NONE;
+
+	/** The visibility grid already says SightPlayer can be seen; aggro without a trace */
+	bool bSightFromGrid = false;
+
+	bool bInAttackRange = false;
+	bool bReducedMovement = false;
+	bool bDropTarget = false;
+};
+
+/**
+ * Decision phase for every enemy, in place of per-enemy overlap spheres and checks.
+ * At a fixed rate, snapshots the players and a slice of the enemies on the game thread, decides
+ * attack range, target loss, aggro and movement tier for the slice in parallel chunks on worker
+ * threads (four enemies at a time with SIMD distance checks), then applies the decisions on the
+ * game thread. Aggro waits for the baked visibility grid or, when it cannot tell, a batched async
+ * line of sight trace. The Target and
+ * InAttackRange blackboard keys are only written when they change. Large hordes are spread over
+ * several updates by the slice budget.
+ */
+UCLASS()
+class SHOOTER_API UEnemyPerceptionSubsystem : public UShooterTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Called by enemies when they begin and end play */
+	void RegisterEnemy(AEnemy* Enemy);
+	void UnregisterEnemy(AEnemy* Enemy);
+
+private:
+	void UpdatePerception();
+
+	/** Copies the players and the next slice of enemies into the arrays the decision phase reads. Game thread */
+	void GatherSnapshot();
+
+	/** Decides for the four enemies starting at Block. Any thread; reads the snapshot and writes only their decisions */
+	void DecideBlock(int32 Block);
+
+	/** Carries out the decisions of the slice. Game thread */
+	void ApplyDecisions();
+
+	void OnSightTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum);
+
+	TArray<TWeakObjectPtr<AEnemy>> Enemies;
+
+	/** Index into Enemies the next slice starts at */
+	int32 SliceCursor;
+
+	/** Enemies decided for in this update */
+	TArray<AEnemy*> SliceEnemies;
+
+	TArray<TWeakObjectPtr<AActor>> Players;
+
+	/** Enemy data of the slice, padded to a multiple of four */
+	TArray<float> EnemyX;
+	TArray<float> EnemyY;
+	TArray<float> EnemyZ;
+	TArray<float> AgroRadiusSquared;
+	TArray<float> CombatRangeSquared;
+	TArray<FEnemySnapshot> EnemySnapshots;
+
+	/** Player positions; players with no health left are moved out of reach */
+	TArray<float> PlayerX;
+	TArray<float> PlayerY;
+	TArray<float> PlayerZ;
+	TArray<bool> PlayerAlive;
+
+	TArray<FEnemyDecision> Decisions;
+
+	/** Baked visibility of the map, if any; lets most sight checks skip the trace */
+	const FVisibilityGrid* VisibilityGrid;
+
+	/** Settings read once per update on the game thread */
+	int32 ForceMovementTier;
+	float ReducedDistanceSquared;
+	float LoseTargetScaleSquared;
+
+	TMap<uint32, FPendingSightTrace> PendingSightTraces;
+
+	/** Enemies with a sight trace in flight */
+	TSet<TWeakObjectPtr<AEnemy>> EnemiesAwaitingSight;
+
+	FTraceDelegate SightTraceDelegate;
+
+	uint32 NextSightTraceId;
+
+	/** Time since the last update */
+	float TimeSinceUpdate;
+};
@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "EnemyPoolSubsystem.generated.h"
+
+class AEnemy;
+
+/**
+ * Corpse budget and enemy pool.
+ * Dead enemies register here once their death pose is frozen. Only a few corpses are kept at once;
+ * the oldest is taken away as soon as a new one goes over the budget. Corpses that leave are hidden
+ * and kept for AcquireEnemy to bring back, instead of being destroyed and spawned again.
+ */
+UCLASS()
+class SHOOTER_API UEnemyPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Deinitialize() override;
+
+	/** Adds a frozen corpse; takes the oldest corpses away if there are more than the budget allows */
+	void AddCorpse(AEnemy* Enemy);
+
+	/** Hides the enemy and keeps it for reuse, or destroys it if the pool is full */
+	void ReleaseEnemy(AEnemy* Enemy);
+
+	/** A pooled enemy of EnemyClass brought back at SpawnTransform, or a newly spawned one if there is none */
+	AEnemy* AcquireEnemy(TSubclassOf<AEnemy> EnemyClass, const FTransform& SpawnTransform);
+
+	FORCEINLINE int32 GetNumCorpses() const { return Corpses.Num(); }
+	FORCEINLINE int32 GetNumPooledEnemies() const { return PooledEnemies.Num(); }
+
+private:
+	/** Oldest first */
+	TArray<TWeakObjectPtr<AEnemy>> Corpses;
+
+	UPROPERTY()
+	TArray<AEnemy*> PooledEnemies;
+};
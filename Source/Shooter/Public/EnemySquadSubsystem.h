@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShooterTickableWorldSubsystem.h"
+#include "EnemySquadSubsystem.generated.h"
+
+class AEnemy;
+
+/** A group of enemies that share one target */
+struct FEnemySquad
+{
+	/** Squad name set on the enemies in the level; NAME_None for squads grouped by distance */
+	FName Name;
+
+	TArray<TWeakObjectPtr<AEnemy>> Members;
+
+	/** Members that reported losing the target since it was last shared, in the same order as Members */
+	TBitArray<> LostTarget;
+
+	TWeakObjectPtr<AActor> Target;
+
+	/** Target changed since it was last shared with the members */
+	bool bTargetDirty = false;
+};
+
+/**
+ * Coordinates enemies in squads.
+ * Each squad keeps one target: a member that sees or is hurt by a player reports it, and the next update
+ * shares it with every member. The target is dropped for the whole squad when it dies or when every
+ * member has lost it. At a fixed rate, also hands out attack tokens so that only a few enemies attack
+ * each player at once; the rest wait in range.
+ */
+UCLASS()
+class SHOOTER_API UEnemySquadSubsystem : public UShooterTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Adds the enemy to its named squad, or to the nearest squad with room, or to a new squad */
+	void JoinSquad(AEnemy* Enemy);
+
+	void LeaveSquad(AEnemy* Enemy);
+
+	/** The enemy saw or was hurt by Target. Applied to the enemy right away and shared with its squad on the next update */
+	void ReportTarget(AEnemy* Enemy, AActor* Target);
+
+	/** The enemy's target died or got out of reach. The squad drops it once every member has lost it */
+	void ReportTargetLost(AEnemy* Enemy);
+
+	/** Drops Player as the target of every squad and tells their members it died */
+	void NotifyCharacterDied(AActor* Player);
+
+	FORCEINLINE const TArray<FEnemySquad>& GetSquads() const { return Squads; }
+
+private:
+	/** Shares changed targets with the members of each squad */
+	void ShareTargets();
+
+	/** Gives attack tokens to the enemies nearest each player, up to the attacker cap */
+	void AssignAttackTokens();
+
+	FEnemySquad* FindSquad(const AEnemy* Enemy, int32* OutMemberIndex = nullptr);
+
+	/** Squads are kept when they empty out and reused by the next new squad */
+	TArray<FEnemySquad> Squads;
+
+	/** Time since attack tokens were last assigned */
+	float TimeSinceTokens;
+};
@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+
+/** A single explosion, shared by AExplosive and AExplosiveField */
+struct SHOOTER_API FExplosionBlast
+{
+	FVector Origin;
+
+	float Radius;
+
+	/** Damage at the center of the blast */
+	float Damage;
+
+	/** Victims closer than this take full damage */
+	float DamageInnerRadius;
+
+	/** Fraction of Damage applied at the edge of the blast */
+	float MinimumDamageScale;
+
+	/** Exponent of the falloff between the inner radius and the edge of the blast */
+	float DamageFalloff;
+
+	/** Impulse applied to simulating physics bodies at the center of the blast */
+	float RadialImpulse;
+
+	/** Channel traced from the blast center to each victim */
+	ECollisionChannel OcclusionChannel;
+
+	/** The actor that exploded; ignored by the overlap and occlusion queries */
+	AActor* ExplodingActor;
+
+	/** Who set the explosion off */
+	AActor* Shooter;
+	AController* ShooterController;
+
+	/** Scale applied to Damage for a victim at the given distance from the blast center */
+	float GetDamageScale(float Distance) const;
+
+	/**
+	 * Damages characters and pushes physics bodies in range with line of sight,
+	 * and hands other explosives in range to the detonation queue.
+	 * @return the number of occlusion traces used
+	 */
+	int32 Resolve(UWorld* World) const;
+};
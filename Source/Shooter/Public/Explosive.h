@@ -11,8 +11,8 @@ UCLASS()
 class SHOOTER_API AExplosive : public AActor, public IBulletHitInterface
 {
 	GENERATED_BODY()
-	
-public:	
+
+public:
 	// Sets default values for this actor's properties
 	AExplosive();
 
@@ -20,6 +20,14 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/**
+	 * Damages and pushes everything inside the blast radius, schedules nearby explosives
+	 * on the detonation queue, then destroys the explosive
+	 */
+	void Explode(const FVector& VFXLocation, AActor* Shooter, AController* ShooterController);
+
 private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Combat, meta = (AllowPrivateAccess = "true"))
 	class UStaticMeshComponent* ExplosiveMesh;
@@ -33,16 +41,55 @@ private:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
 	class USoundCue* ImpactSFX;
 
-	/** Used to determine which actors are overlapping when exploding */
+	/** Radius of this sphere is the blast radius; it does not generate overlaps */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
 	class USphereComponent* OverlapSphere;
 
+	/** Damage at the center of the blast */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
 	float Damage;
 
-public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+	/** Victims closer than this take full damage */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	float DamageInnerRadius;
+
+	/** Fraction of Damage applied at the edge of the blast. 0: no damage, 1: no falloff */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true", ClampMin = "0.0", ClampMax = "1.0", UIMin = "0.0", UIMax = "1.0"))
+	float MinimumDamageScale;
+
+	/** Exponent of the falloff between the inner radius and the edge of the blast. 1: linear */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true", ClampMin = "0.0"))
+	float DamageFalloff;
+
+	/** Impulse applied to physics bodies (dropped weapons etc) at the center of the blast */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	float RadialImpulse;
+
+	/** Channel traced from the blast center to each victim; a blocking hit shields the victim */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	TEnumAsByte<ECollisionChannel> OcclusionChannel;
+
+	/** True once the explosive has been scheduled or has gone off */
+	bool bIsDetonating;
 
+public:
 	virtual void BulletHit_Implementation(FHitResult HitResult, AActor* Shooter, AController* ShooterController) override;
+
+	/** Called by the detonation queue when a chained explosion is due */
+	void DetonateFromChain(AActor* Shooter, AController* ShooterController);
+
+	FORCEINLINE UStaticMeshComponent* GetExplosiveMesh() const { return ExplosiveMesh; }
+	FORCEINLINE UParticleSystem* GetExplodeVFX() const { return ExplodeVFX; }
+	FORCEINLINE USoundCue* GetExplodeSFX() const { return ExplodeSFX; }
+	FORCEINLINE USoundCue* GetImpactSFX() const { return ImpactSFX; }
+	FORCEINLINE float GetDamage() const { return Damage; }
+	FORCEINLINE float GetDamageInnerRadius() const { return DamageInnerRadius; }
+	FORCEINLINE float GetMinimumDamageScale() const { return MinimumDamageScale; }
+	FORCEINLINE float GetDamageFalloff() const { return DamageFalloff; }
+	FORCEINLINE float GetRadialImpulse() const { return RadialImpulse; }
+	FORCEINLINE ECollisionChannel GetOcclusionChannel() const { return OcclusionChannel; }
+	float GetBlastRadius() const;
+
+	FORCEINLINE bool IsDetonating() const { return bIsDetonating; }
+	FORCEINLINE void SetDetonating(bool bDetonating) { bIsDetonating = bDetonating; }
 };
@@ -0,0 +1,149 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "BulletHitInterface.h"
+#include "ExplosiveField.generated.h"
+
+struct FDetonationTarget;
+
+/** Gameplay data of one barrel instance, kept in the same order as the mesh instances */
+USTRUCT(BlueprintType)
+struct FExplosiveInstanceData
+{
+	GENERATED_BODY()
+
+	/** Blast damage the barrel can take from other explosions before it goes off. Bullets always set it off */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat)
+	float Health = 1.f;
+
+	/** Damage at the center of the blast */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat)
+	float Damage = 250.f;
+
+	/** Blast radius */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat)
+	float Radius = 300.f;
+};
+
+/**
+ * Many explosive barrels drawn by a single instanced mesh component.
+ * Behaves like a set of AExplosive actors: bullets set an instance off, blasts chain through the
+ * detonation queue, and instances are removed as they go off. Per-instance state lives in packed
+ * arrays instead of one actor, mesh and sphere component per barrel.
+ */
+UCLASS()
+class SHOOTER_API AExplosiveField : public AActor, public IBulletHitInterface
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	AExplosiveField();
+
+	virtual void OnConstruction(const FTransform& Transform) override;
+
+protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Removes the instance, plays its effects and resolves its blast */
+	void DetonateInstance(int32 InstanceIndex, const FVector& VFXLocation, AActor* Shooter, AController* ShooterController);
+
+	/** Removes a mesh instance and keeps the packed arrays in the same order as the component */
+	void RemoveInstance(int32 InstanceIndex);
+
+	/** Current index of the instance with the given id, or INDEX_NONE once it has gone off */
+	int32 FindInstanceIndex(int32 InstanceId) const;
+
+#if WITH_EDITOR
+	/** Replaces the AExplosive actors in the level that use this field's mesh with instances */
+	UFUNCTION(CallInEditor, Category = Combat)
+	void GatherExplosives();
+#endif
+
+private:
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	class UHierarchicalInstancedStaticMeshComponent* ExplosiveInstances;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	class UParticleSystem* ExplodeVFX;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	class USoundCue* ExplodeSFX;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	class USoundCue* ImpactSFX;
+
+	/** One entry per mesh instance */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	TArray<FExplosiveInstanceData> InstanceData;
+
+	/** Data given to instances added in the editor without an entry of their own */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	FExplosiveInstanceData DefaultInstanceData;
+
+	/** Victims closer than this take full damage */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	float DamageInnerRadius;
+
+	/** Fraction of Damage applied at the edge of the blast. 0: no damage, 1: no falloff */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true", ClampMin = "0.0", ClampMax = "1.0", UIMin = "0.0", UIMax = "1.0"))
+	float MinimumDamageScale;
+
+	/** Exponent of the falloff between the inner radius and the edge of the blast. 1: linear */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true", ClampMin = "0.0"))
+	float DamageFalloff;
+
+	/** Impulse applied to physics bodies (dropped weapons etc) at the center of the blast */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	float RadialImpulse;
+
+	/** Channel traced from the blast center to each victim; a blocking hit shields the victim */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	TEnumAsByte<ECollisionChannel> OcclusionChannel;
+
+	/** Ids that stay valid while instances are removed and the component reorders the rest */
+	TArray<int32> InstanceIds;
+
+	/** Current instance index of every id, kept in step with InstanceIds so lookups do not search */
+	TMap<int32, int32> InstanceIndices;
+
+	/** World location of every instance, for range queries without touching the component */
+	TArray<FVector> InstanceLocations;
+
+	/** Instances already scheduled on the detonation queue */
+	TBitArray<> PendingInstances;
+
+	/** Bounds of every instance at BeginPlay; lets blasts skip the whole field */
+	FBox InstanceBounds;
+
+	int32 NextInstanceId;
+
+public:
+	virtual void BulletHit_Implementation(FHitResult HitResult, AActor* Shooter, AController* ShooterController) override;
+
+	/** Called by the detonation queue when a chained explosion is due */
+	void DetonateFromChain(int32 InstanceId, AActor* Shooter, AController* ShooterController);
+
+	/** Adds instances within Radius of Origin that are not already going off */
+	void GatherInstancesInRadius(const FVector& Origin, float Radius, TArray<FDetonationTarget>& OutTargets) const;
+
+	/**
+	 * Applies blast damage to an instance.
+	 * @return true if the instance has no health left and should go off
+	 */
+	bool DamageInstance(int32 InstanceId, float Damage);
+
+	/**
+	 * Flags an instance as scheduled on the detonation queue.
+	 * @return false if it is already scheduled or has gone off
+	 */
+	bool MarkInstancePending(int32 InstanceId);
+
+	FORCEINLINE int32 GetNumInstances() const { return InstanceIds.Num(); }
+};
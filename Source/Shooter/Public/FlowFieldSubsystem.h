@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShooterTickableWorldSubsystem.h"
+#include "Async/Future.h"
+#include "FlowFieldSubsystem.generated.h"
+
+class ANavigationData;
+
+namespace FlowField
+{
+	/** Height of a cell with no navmesh */
+	constexpr float BlockedHeight{ -TNumericLimits<float>::Max() };
+
+	/** Direction value of a cell the target cannot be reached from */
+	constexpr uint8 NoDirection{ 255 };
+
+	/** Direction value of the target's own cell */
+	constexpr uint8 TargetDirection{ 254 };
+}
+
+/** Walkability of a square of cells around a target, handed to the worker thread */
+struct FFlowFieldBuildInput
+{
+	/** Cell coordinates of the first cell of the square */
+	FIntPoint MinCell;
+	int32 Size = 0;
+
+	FIntPoint TargetCell;
+
+	/** Navmesh height of every cell; FlowField::BlockedHeight where there is no navmesh */
+	TArray<float> Heights;
+
+	float MaxStepHeight = 0.f;
+};
+
+/** For every cell in a square around a target, the neighbour to walk to next */
+struct FFlowField
+{
+	FIntPoint MinCell;
+	int32 Size = 0;
+	float CellSize = 0.f;
+
+	/** Index into the eight neighbour offsets, NoDirection or TargetDirection */
+	TArray<uint8> Directions;
+
+	/** Builds the field with a Dijkstra search outward from the target cell. Any thread */
+	static TSharedPtr<FFlowField, ESPMode::ThreadSafe> Build(const FFlowFieldBuildInput& Input, float CellSize);
+};
+
+/** The field of one player and the state of its next build */
+struct FFlowFieldTarget
+{
+	TWeakObjectPtr<AActor> Target;
+
+	/** Last finished field; read by chasing enemies */
+	TSharedPtr<FFlowField, ESPMode::ThreadSafe> Field;
+
+	/** Field being built on a worker thread */
+	TFuture<TSharedPtr<FFlowField, ESPMode::ThreadSafe>> PendingBuild;
+
+	/** Cell the probe window is centered on */
+	FIntPoint WindowCenter{ TNumericLimits<int32>::Max(), 0 };
+
+	/** Height band the probe window is in; floors stacked above each other are probed separately */
+	int32 WindowLayer = 0;
+
+	/** Next offset of the probe order to check */
+	int32 ProbeCursor = 0;
+
+	/** Target cell of the last build started */
+	FIntPoint BuiltTargetCell{ TNumericLimits<int32>::Max(), 0 };
+
+	/** Cells probed inside the window since the last build started */
+	int32 ProbesSinceBuild = 0;
+
+	float LastBuildTime = -BIG_NUMBER;
+};
+
+/**
+ * Shared chase paths for enemies. Keeps one flow field per player over the navigable area around them.
+ * Navmesh walkability is probed a few cells per frame and cached, and the distance field itself is
+ * rebuilt on a worker thread when the player changes cell. Chasing enemies sample a direction in O(1)
+ * and fall back to regular pathfinding when they are outside the field.
+ */
+UCLASS()
+class SHOOTER_API UFlowFieldSubsystem : public UShooterTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/**
+	 * Direction to move in from Location to reach Target.
+	 * @return false if there is no field for Target or Location cannot reach it through the field
+	 */
+	bool SampleDirection(const AActor* Target, const FVector& Location, FVector& OutDirection) const;
+
+	FORCEINLINE int32 GetNumProbedCells() const { return ProbedHeights.Num(); }
+	FORCEINLINE const TArray<FFlowFieldTarget>& GetTargets() const { return Targets; }
+
+private:
+	/** Adds fields for new players and drops the ones whose pawn is gone */
+	void UpdateTargets();
+
+	/** Probes navmesh heights for cells around each target within the frame budget */
+	void ProbeCells(float CellSize, int32 HalfExtent);
+
+	/** Collects finished builds and starts new ones */
+	void UpdateBuilds(float CellSize, int32 HalfExtent);
+
+	void StartBuild(FFlowFieldTarget& FlowTarget, const FIntPoint& TargetCell, float CellSize, int32 HalfExtent);
+
+	/** Probed heights are stale once the navmesh changes */
+	UFUNCTION()
+	void OnNavigationGenerationFinished(ANavigationData* NavData);
+
+	FIntPoint GetCell(const FVector& Location, float CellSize) const;
+
+	/** Drops probed cells outside every target's window once there are too many */
+	void TrimProbedHeights();
+
+	TArray<FFlowFieldTarget> Targets;
+
+	/** Navmesh height of every cell probed so far, by cell coordinates and height band */
+	TMap<FIntVector, float> ProbedHeights;
+
+	/** Offsets from the window center sorted by distance, so cells near the target are probed first */
+	TArray<FIntPoint> ProbeOrder;
+
+	/** Cell size, extent and band height ProbedHeights and ProbeOrder were built for */
+	float CachedCellSize;
+	int32 CachedHalfExtent;
+	float CachedProbeHeight;
+
+	bool bBoundToNavigation;
+};
@@ -4,8 +4,22 @@
 
 #include "CoreMinimal.h"
 #include "Animation/AnimInstance.h"
+#include "Animation/AnimInstanceProxy.h"
 #include "GruxAnimInstance.generated.h"
 
+/** Runs the Grux animation update on a worker thread when parallel animation update is enabled */
+USTRUCT()
+struct FGruxAnimInstanceProxy : public FAnimInstanceProxy
+{
+	GENERATED_BODY()
+
+	FGruxAnimInstanceProxy() = default;
+	FGruxAnimInstanceProxy(UAnimInstance* InAnimInstance) : FAnimInstanceProxy(InAnimInstance) {}
+
+protected:
+	virtual void Update(float DeltaSeconds) override;
+};
+
 /**
  * 
  */
@@ -15,9 +29,19 @@ class SHOOTER_API UGruxAnimInstance : public UAnimInstance
 	GENERATED_BODY()
 	
 public:
-	UFUNCTION(BlueprintCallable)
+	/** Kept for Blueprints that still call it; the update now runs in NativeUpdateAnimation and the proxy */
+	UFUNCTION(BlueprintCallable, meta = (DeprecatedFunction, DeprecationMessage = "Animation properties are updated natively; remove this call."))
 	void UpdateAnimationProperties(float DeltaTime);
 
+	/** Copies the enemy velocity. Game thread */
+	virtual void NativeUpdateAnimation(float DeltaSeconds) override;
+
+	/** Computes the animation properties from the copied state. Called by the proxy, possibly on a worker thread */
+	void NativeThreadSafeUpdateAnimation(float DeltaSeconds);
+
+protected:
+	virtual FAnimInstanceProxy* CreateAnimInstanceProxy() override;
+
 private:
 	/** Lateral speed */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
@@ -25,4 +49,7 @@ private:
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 	class AEnemy* Enemy;
+
+	/** Velocity of the enemy, written on the game thread */
+	FVector EnemyVelocity;
 };
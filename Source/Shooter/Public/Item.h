@@ -70,6 +70,11 @@ public:
 	// Sets default values for this actor's properties
 	AItem();
 
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** Ignored while interping; each client flies the item to the character itself */
+	virtual void OnRep_ReplicatedMovement() override;
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
@@ -88,9 +93,21 @@ protected:
 	/** Sets properties of the item components based on state */
 	virtual void SetItemProperties(EItemState State);
 
+	UFUNCTION()
+	void OnRep_ItemState();
+
 	/** Called when item interp timer has finished */
 	void FinishInterping();
 
+	/** Starts flying the item to Character's interp location, on the server and on clients */
+	void StartItemFlight();
+
+	/** Client: ends the flight once the server picked the item up, or when the interp timer runs out */
+	void FinishItemFlight();
+
+	/** Puts the scale, glow and custom depth back after a flight */
+	void ResetFlightVisuals();
+
 	/** Handles item interpolation when in the equipped interping state */
 	void ItemInterp(float DeltaTime);
 
@@ -150,7 +167,7 @@ private:
 	int32 ItemCount;
 
 	/** State of the item */
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Item properties", meta = (AllowPrivateAccess = "true"))
+	UPROPERTY(ReplicatedUsing = OnRep_ItemState, VisibleAnywhere, BlueprintReadOnly, Category = "Item properties", meta = (AllowPrivateAccess = "true"))
 	EItemState ItemState;
 
 	/** The curve asset to use for the item's Z location when interping */
@@ -172,7 +189,8 @@ private:
 	/** Plays when we start interping */
 	FTimerHandle ItemInterpTimer;
 
-	/** Pointer to the character */
+	/** Pointer to the character; replicated so clients can fly the item to it */
+	UPROPERTY(Replicated)
 	class AShooterCharacter* Character;
 
 	/** Duration of the curve and timer */
@@ -252,7 +270,7 @@ private:
 	UTexture2D* IconType;
 	
 	/** Slot in inventory array */
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Inventory, meta = (AllowPrivateAccess = "true"))
+	UPROPERTY(Replicated, VisibleAnywhere, BlueprintReadOnly, Category = Inventory, meta = (AllowPrivateAccess = "true"))
 	int32 SlotIndex;
 
 	/** True when the character's inventory is full */
@@ -0,0 +1,145 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShooterTickableWorldSubsystem.h"
+#include "LagCompensationSubsystem.generated.h"
+
+class ACharacter;
+class AShooterCharacter;
+
+namespace LagCompensation
+{
+	/** Snapshots kept per character; enough for the longest rewind plus interpolation delay at a 60 Hz server tick */
+	constexpr int32 HistoryLength{ 64 };
+}
+
+/** Where a character's hitboxes were on one server tick */
+struct FHitboxSnapshot
+{
+	/** Server world time of the tick */
+	float Time;
+
+	/** Capsule center */
+	FVector Location;
+
+	/** Center of the head sphere; unused when the character has no head bone */
+	FVector HeadLocation;
+};
+
+/** Ring buffer of hitbox snapshots for one character */
+struct FHitboxHistory
+{
+	TWeakObjectPtr<ACharacter> Character;
+
+	/** Bone the head sphere follows. NAME_None: no head shots */
+	FName HeadBone;
+
+	float CapsuleRadius;
+	float CapsuleHalfHeight;
+
+	/** Seconds clients show the character behind the server, on top of their latency */
+	float DisplayDelay;
+
+	/** Slot the next snapshot is written to */
+	int32 Head;
+
+	/** Number of valid snapshots, up to HistoryLength */
+	int32 Num;
+
+	FHitboxSnapshot Snapshots[LagCompensation::HistoryLength];
+
+	/** Capsule and head location at Time, interpolated between the two snapshots around it */
+	bool Sample(float Time, FVector& OutLocation, FVector& OutHeadLocation) const;
+};
+
+/** A shot from a remote player, waiting to be checked against the past */
+struct FRewindShot
+{
+	TWeakObjectPtr<AShooterCharacter> Shooter;
+
+	/** History of the shooter, which the shot cannot hit */
+	int32 ShooterHistory;
+
+	FVector Start;
+	FVector Direction;
+
+	/** Server time the client saw when it fired, clamped to the rewind window. Each target is rewound a further DisplayDelay */
+	float Time;
+
+	/** Time as the client sent it, before clamping to the rewind window */
+	float ClientTime;
+
+	/** Distance to the first world geometry along the shot, now */
+	float MaxDistance;
+
+	float Damage;
+	float HeadShotDamage;
+};
+
+/** What a rewound shot hit */
+struct FRewindResult
+{
+	/** Index into the histories; INDEX_NONE on a miss */
+	int32 History = INDEX_NONE;
+
+	FVector Location;
+
+	bool bHeadShot = false;
+};
+
+/**
+ * Server-side hit validation for shots fired by remote players.
+ * Every server tick each registered character's capsule and head are written to a fixed-size ring buffer.
+ * Shots are queued as they arrive and validated together at the end of the frame: each one is tested in parallel
+ * against the hitboxes interpolated at the time the client fired, then damage is applied on the game thread.
+ */
+UCLASS()
+class SHOOTER_API ULagCompensationSubsystem : public UShooterTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Called on the server by characters that can be shot */
+	void RegisterCharacter(ACharacter* Character, FName HeadBone = NAME_None);
+	void UnregisterCharacter(ACharacter* Character);
+
+	/** Queues a shot fired by a remote player at ClientTime, for validation at the end of the frame */
+	void QueueShot(AShooterCharacter* Shooter, const FVector& Start, const FVector& Direction, float ClientTime, float Range, float Damage, float HeadShotDamage);
+
+	/** Tests every shot against the hitboxes at its time */
+	void ValidateShots(const TArray<FRewindShot>& Shots, TArray<FRewindResult>& OutResults) const;
+
+	/** True when this world serves remote players and rewinding is on */
+	bool IsRewindEnabled() const;
+
+	FORCEINLINE int32 GetNumHistories() const { return Histories.Num(); }
+
+	/** Starts or stops keeping the validation latency of every shot */
+	void SetRecordLatencies(bool bRecord);
+
+	/** Moves out the seconds from each client firing to the server validating the shot, since the last call */
+	void TakeLatencies(TArray<float>& OutLatencies);
+
+private:
+	/** True on dedicated and listen servers */
+	bool IsServing() const;
+
+	void RecordSnapshots();
+
+	FRewindResult ValidateShot(const FRewindShot& Shot) const;
+
+	void ApplyResults();
+
+	TArray<FHitboxHistory> Histories;
+
+	TArray<FRewindShot> PendingShots;
+	TArray<FRewindResult> Results;
+
+	bool bRecordLatencies = false;
+	TArray<float> Latencies;
+};
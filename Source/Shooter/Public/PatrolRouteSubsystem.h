@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AI/Navigation/NavigationTypes.h"
+#include "NavigationData.h"
+#include "PatrolRouteSubsystem.generated.h"
+
+/** A path between two patrol points, found once and reused */
+struct FPatrolRoute
+{
+	TArray<FVector> Points;
+
+	/** Id of the async path query while it is running; INVALID_NAVQUERYID once done */
+	uint32 QueryId = INVALID_NAVQUERYID;
+};
+
+/**
+ * Cache of the navmesh paths between enemy patrol points.
+ * Each route is found once with an async query and shared by every enemy patrolling the same
+ * points. Routes are dropped when the navmesh changes and found again on the next request.
+ */
+UCLASS()
+class SHOOTER_API UPatrolRouteSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Deinitialize() override;
+
+	/** Starts an async query for the route from Start to End unless it is cached or already running */
+	void RequestRoute(const FVector& Start, const FVector& End, const APawn* Pawn);
+
+	/**
+	 * A new path following the cached route from Start to End.
+	 * @return null if the route has not been found yet
+	 */
+	FNavPathSharedPtr MakeRoutePath(const FVector& Start, const FVector& End) const;
+
+	/** Counts a move that used a cached route instead of a path query */
+	void NotifyQueryAvoided();
+
+	FORCEINLINE int32 GetNumRoutes() const { return Routes.Num(); }
+	FORCEINLINE int32 GetNumQueriesAvoided() const { return NumQueriesAvoided; }
+
+private:
+	using FRouteKey = TPair<FIntVector, FIntVector>;
+
+	static FRouteKey MakeKey(const FVector& Start, const FVector& End);
+
+	void OnRouteFound(uint32 QueryId, ENavigationQueryResult::Type Result, FNavPathSharedPtr Path, FRouteKey Key);
+
+	/** Cached routes are stale once the navmesh changes */
+	UFUNCTION()
+	void OnNavigationGenerationFinished(ANavigationData* NavData);
+
+	TMap<FRouteKey, FPatrolRoute> Routes;
+
+	int32 NumQueriesAvoided;
+
+	bool bBoundToNavigation;
+};
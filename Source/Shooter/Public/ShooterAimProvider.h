@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+#include "ShooterAimProvider.generated.h"
+
+// This class does not need to be modified.
+UINTERFACE(MinimalAPI)
+class UShooterAimProvider : public UInterface
+{
+	GENERATED_BODY()
+};
+
+/**
+ * Implemented by controllers with no viewport to aim through, like AI and scripted shooters.
+ * A character controlled by one fires and traces for items along the ray it gives instead of the crosshair.
+ */
+class SHOOTER_API IShooterAimProvider
+{
+	GENERATED_BODY()
+
+public:
+	/** World-space start and direction of the aim ray of the pawn. False: the pawn cannot aim right now */
+	virtual bool GetAimRay(const APawn* Pawn, FVector& OutStart, FVector& OutDirection) const = 0;
+};
@@ -4,9 +4,12 @@
 
 #include "CoreMinimal.h"
 #include "Animation/AnimInstance.h"
+#include "Animation/AnimInstanceProxy.h"
 #include "WeaponType.h"
 #include "ShooterAnimInstance.generated.h"
 
+enum class ECombatState : uint8;
+
 UENUM(BlueprintType)
 enum class EOffsetState : uint8
 {
@@ -18,6 +21,40 @@ enum class EOffsetState : uint8
 	EOS_MAX UMETA(DisplayName = "DefaultMAX")
 };
 
+/** Character state copied on the game thread for the worker thread update */
+struct FShooterAnimSnapshot
+{
+	FVector Velocity{ FVector::ZeroVector };
+	FRotator AimRotation{ FRotator::ZeroRotator };
+	FRotator ActorRotation{ FRotator::ZeroRotator };
+	ECombatState CombatState{};
+	EWeaponType EquippedWeaponType{ EWeaponType::EWT_MAX };
+
+	/** Turn-in-place curves from the last evaluated pose; GetCurveValue is game thread only */
+	float TurningCurve{ 0.f };
+	float RotationCurve{ 0.f };
+
+	bool bHasCharacter{ false };
+	bool bHasEquippedWeapon{ false };
+	bool bIsFalling{ false };
+	bool bIsAccelerating{ false };
+	bool bIsAiming{ false };
+	bool bIsCrouching{ false };
+};
+
+/** Runs the shooter animation update on a worker thread when parallel animation update is enabled */
+USTRUCT()
+struct FShooterAnimInstanceProxy : public FAnimInstanceProxy
+{
+	GENERATED_BODY()
+
+	FShooterAnimInstanceProxy() = default;
+	FShooterAnimInstanceProxy(UAnimInstance* InAnimInstance) : FAnimInstanceProxy(InAnimInstance) {}
+
+protected:
+	virtual void Update(float DeltaSeconds) override;
+};
+
 /**
  * 
  */
@@ -29,12 +66,21 @@ class SHOOTER_API UShooterAnimInstance : public UAnimInstance
 public:
 	UShooterAnimInstance();
 
-	UFUNCTION(BlueprintCallable)
+	/** Kept for Blueprints that still call it; the update now runs in NativeUpdateAnimation and the proxy */
+	UFUNCTION(BlueprintCallable, meta = (DeprecatedFunction, DeprecationMessage = "Animation properties are updated natively; remove this call."))
 	void UpdateAnimationProperties(float DeltaTime);
 
 	virtual void NativeInitializeAnimation() override;
 
+	/** Copies the character state into Snapshot. Game thread */
+	virtual void NativeUpdateAnimation(float DeltaSeconds) override;
+
+	/** Computes every animation property from Snapshot. Called by the proxy, possibly on a worker thread */
+	void NativeThreadSafeUpdateAnimation(float DeltaSeconds);
+
 protected:
+	virtual FAnimInstanceProxy* CreateAnimInstanceProxy() override;
+
 	/** Handle turning in place variables */
 	void TurnInPlace();
 
@@ -42,6 +88,9 @@ protected:
 	void Lean(float DeltaTime);
 
 private:
+	/** Written on the game thread, read by the worker thread update */
+	FShooterAnimSnapshot Snapshot;
+
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Movement, meta = (AllowPrivateAccess = "true"))
 	class AShooterCharacter* ShooterCharacter;
 
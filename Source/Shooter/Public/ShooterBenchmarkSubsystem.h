@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShooterTickableWorldSubsystem.h"
+#include "ShooterBenchmarkSubsystem.generated.h"
+
+class AShooterCharacter;
+class FJsonObject;
+
+/** Scripted combat the benchmark runner measures */
+enum class EBenchmarkScenario : uint8
+{
+	/** Enemies spawned around the player, all chasing it */
+	EnemiesChasing,
+
+	/** The player firing full-auto into a crowd of enemies */
+	AutoFireCrowd,
+
+	/** The player walking through a field of pickups */
+	LootField,
+
+	/** A field of explosive barrels going off in one chain reaction */
+	BarrelField
+};
+
+/** One scenario to run and how much content it spawns */
+struct FBenchmarkScenarioRun
+{
+	EBenchmarkScenario Scenario;
+	int32 Count;
+};
+
+/** Average and maximum of one cycle or counter stat over the sampled frames */
+struct FBenchmarkStat
+{
+	double Sum = 0.0;
+	double Max = 0.0;
+	bool bIsCycle = false;
+};
+
+/** Everything measured while a scenario samples */
+struct FBenchmarkScenarioSamples
+{
+	TArray<float> GameThreadMs;
+	TArray<float> FrameMs;
+
+	/** Actors spawned while sampling, by class */
+	TMap<FString, int32> Spawns;
+
+	/** Stats of the Shooter and MemoryAllocator groups, by name */
+	TMap<FString, FBenchmarkStat> Stats;
+
+	uint64 StartUsedMemory = 0;
+	uint64 PeakUsedMemory = 0;
+};
+
+/**
+ * Headless benchmark runner, started with -ShooterBenchmark=<Scenario[:Count],...> on a game (usually -nullrhi).
+ * Each scenario spawns its content around the player in the loaded map, warms up, then samples a fixed number of
+ * frames: game thread time, STATGROUP_Shooter cycle and counter stats, allocations and actor spawns.
+ * The results go to a JSON file. Given -BenchmarkBaseline=<File> they are compared against an earlier run, and the
+ * process exits with status 1 when any metric got worse by more than the tolerance. Scripts/Benchmark.sh runs it.
+ */
+UCLASS()
+class SHOOTER_API UShooterBenchmarkSubsystem : public UShooterTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	enum class EPhase : uint8
+	{
+		WaitingForPlayer,
+		WarmingUp,
+		Sampling,
+		Finished
+	};
+
+	void StartScenario();
+	void FinishScenario();
+
+	/** Spawns the scenario's content and sets the player up */
+	void SetUpScenario(const FBenchmarkScenarioRun& Run);
+
+	/** Scripted player input for the frame */
+	void DriveScenario();
+
+	void SampleFrame();
+
+	void OnActorSpawned(AActor* Actor);
+
+	TSharedRef<FJsonObject> ScenarioToJson(const FBenchmarkScenarioRun& Run, const FBenchmarkScenarioSamples& ScenarioSamples) const;
+
+	/** Adds the metrics worse than in the baseline by more than the tolerance to OutRegressions */
+	void CompareWithBaseline(const TArray<TSharedPtr<FJsonObject>>& Scenarios, TArray<FString>& OutRegressions) const;
+
+	void WriteResults();
+
+	TArray<FBenchmarkScenarioRun> Runs;
+	int32 RunIndex = 0;
+
+	int32 Frames = 600;
+	int32 WarmupFrames = 60;
+	int32 FrameInPhase = 0;
+	EPhase Phase = EPhase::WaitingForPlayer;
+
+	FString OutputFile;
+	FString BaselineFile;
+
+	/** Percent a metric may grow by before it counts as a regression */
+	float Tolerance = 10.f;
+
+	TWeakObjectPtr<AShooterCharacter> Player;
+
+	/** Content of the current scenario, destroyed before the next one */
+	TArray<TWeakObjectPtr<AActor>> ScenarioActors;
+
+	/** Where the player aims or walks in the current scenario */
+	FVector ScenarioTarget = FVector::ZeroVector;
+
+	FBenchmarkScenarioSamples Samples;
+	TArray<TSharedPtr<FJsonObject>> Results;
+
+	double LastFrameTime = 0.0;
+
+	FDelegateHandle ActorSpawnedHandle;
+};
@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
 #include "AmmoType.h"
+#include "ShotBatch.h"
 #include "ShooterCharacter.generated.h"
 
 UENUM(BlueprintType)
@@ -33,6 +34,43 @@ struct FInterpLocation
 	int32 ItemCount;
 };
 
+/** The owner's combat state as the server has it, after the last owner input it processed */
+USTRUCT()
+struct FCombatAck
+{
+	GENERATED_BODY()
+
+	/** Sequence number of the last processed input */
+	UPROPERTY()
+	uint16 InputSequence = 0;
+
+	/** Inventory slot of the equipped weapon. -1: none */
+	UPROPERTY()
+	int8 EquippedSlot = -1;
+
+	/** Magazine ammo of the weapon in each inventory slot */
+	UPROPERTY()
+	TArray<uint16> MagazineAmmo;
+
+	/** Carried ammo indexed by EAmmoType */
+	UPROPERTY()
+	TArray<uint16> CarriedAmmo;
+};
+
+/** A combat input the owning client applied before the server acknowledged it */
+struct FPredictedCombatInput
+{
+	uint16 InputSequence;
+
+	/** Slot equipped after the input; the slot whose magazine changed */
+	int8 EquippedSlot;
+
+	EAmmoType AmmoType;
+
+	int16 MagazineDelta;
+	int16 CarriedDelta;
+};
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FEquipItemDelegate, int32, CurrentSlotIndex, int32, NewSlotIndex);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FHighlightIconDelegate, int32, SlotIndex, bool, bShouldStartAnimation);
 
@@ -48,9 +86,13 @@ public:
 	// Take combat damage
 	virtual float TakeDamage(float DamageAmount, struct FDamageEvent const& DamageEvent, class AController* EventInstigator, AActor* DamageCauser) override;
 
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	
 	/** Called for forwards/backwards input */
 	void MoveForward(float Value);
@@ -85,7 +127,32 @@ protected:
 	/** Called when the fire button is pressed */
 	void FireWeapon();
 
-	bool GetTrailEndLocation(const FVector& MuzzleSocketLocation, FHitResult& OutHitResult);
+	/** Fires one shot along the aim ray. The server and the owner spend ammo; only the server applies damage */
+	void FireShot(const FVector& AimStart, const FVector& AimDirection);
+
+	/** Owner: adds a shot to the batch sent to the server */
+	void BatchShot(const FVector& AimStart, const FVector& AimDirection);
+
+	void SendShotBatch();
+
+	/** Shots of a lost batch are never resent; the acknowledgement gives their ammo back */
+	UFUNCTION(Server, Unreliable, WithValidation)
+	void ServerFireShots(const FShotBatch& Batch);
+
+	/** ClientFireTime is the server time the client saw when firing, which hits are rewound to */
+	void FireClientShot(const FVector& AimStart, const FVector& AimDirection, float ClientFireTime);
+
+	/** Server: moves the acknowledged sequence forward. Inputs overtaken by a later one keep the newer sequence */
+	void AcknowledgeInput(uint16 InputSequence);
+
+	/** True when hits on characters are left to lag compensation instead of the trace at the time the shot arrived */
+	bool ShouldRewindHits() const;
+
+	/** Plays a shot fired on the server for everyone but the shooter */
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastFireShot(const FVector_NetQuantize& AimStart, const FVector_NetQuantizeNormal& AimDirection);
+
+	bool GetTrailEndLocation(const FVector& MuzzleSocketLocation, const FVector& AimStart, const FVector& AimDirection, FHitResult& OutHitResult);
 
 	/** Set bIsAiming to true or false with button press */
 	void AimingButtonPressed();
@@ -111,6 +178,9 @@ protected:
 	UFUNCTION()
 	void AutoFireReset();
 
+	/** Aim ray of the owning controller: from its aim provider, the crosshair of its viewport, or else its view point */
+	bool GetCrosshairRay(FVector& OutStart, FVector& OutDirection);
+
 	/** Line trace for items under crosshair */
 	bool TraceUnderCrosshair(FHitResult& OutHitResult, FVector& OutHitLocation);
 
@@ -140,7 +210,7 @@ protected:
 
 	/** Fire weapon functions */
 	void PlayFireSound();
-	void SendBullet();
+	void SendBullet(const FVector& AimStart, const FVector& AimDirection);
 	void PlayGunfireMontage();
 
 	/** Bound to R key and button face right on controller */
@@ -149,6 +219,19 @@ protected:
 	/** Handle reloading of the weapon */
 	void ReloadWeapon();
 
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerReloadWeapon(uint16 InputSequence);
+
+	/** Sent when the owner's reload montage finishes; the server completes remote players' reloads from this */
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerFinishReloading(uint16 InputSequence);
+
+	/** Moves carried ammo into the magazine. Returns the rounds moved, or INDEX_NONE when not reloading */
+	int32 CompleteReload();
+
+	/** Server: finishes a remote player's reload whose ServerFinishReloading arrived too early to accept */
+	void FinishDeferredReload();
+
 	/** Check if ammo for equipped weapon type is available */
 	bool CarryingAmmo();
 
@@ -175,6 +258,46 @@ protected:
 
 	void ExchangeInventoryItems(int32 CurrentItemIndex, int32 NewItemIndex);
 
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerExchangeInventoryItems(int32 CurrentItemIndex, int32 NewItemIndex, uint16 InputSequence);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerPickUpItem(class AItem* Item);
+
+	/** Plays a montage started on the server for everyone but the owner, who started it locally */
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastPlayMontage(class UAnimMontage* Montage, FName Section);
+
+	UFUNCTION(NetMulticast, Reliable)
+	void MulticastStun();
+
+	/** Lets a client action through when the client's fire timer, equip or reload montage ran out slightly before the server's */
+	void CatchUpWithClient();
+
+	/** Length of a montage section, for checking client timing */
+	static float GetMontageSectionLength(const UAnimMontage* Montage, FName Section);
+
+	/** Remembers an input the owner applied locally until the server acknowledges it. Returns its sequence number */
+	uint16 RecordCombatInput(int32 MagazineDelta = 0, int32 CarriedDelta = 0);
+
+	/** Takes the server's state from CombatAck and replays the unacknowledged inputs on top of it */
+	void ReconcileCombatState();
+
+	/** Server: writes the current state into CombatAck for the owner */
+	void UpdateCombatAck();
+
+	UFUNCTION()
+	void OnRep_EquippedWeapon(AWeapon* LastWeapon);
+
+	UFUNCTION()
+	void OnRep_CombatAck();
+
+	UFUNCTION()
+	void OnRep_Inventory();
+
+	UFUNCTION()
+	void OnRep_IsDead();
+
 	int32 GetEmptyInventorySlot();
 
 	void HighlightInventorySlot();
@@ -306,6 +429,21 @@ private:
 	/** Time between shots */
 	FTimerHandle AutomaticFireTimer;
 
+	/** Server: runs FinishDeferredReload when a remote player's reload may complete */
+	FTimerHandle DeferredReloadTimer;
+
+	/** Server time the current combat state was entered, for checking client timing */
+	float CombatStateStartTime;
+
+	/** Server: time the client claimed for its last accepted shot */
+	float LastClientFireTime;
+
+	/** Owner: shots waiting for the next send */
+	FShotBatch PendingShotBatch;
+
+	/** Owner: time the first shot of PendingShotBatch was added */
+	float PendingShotBatchTime;
+
 	/** True if we should trace every frame for items */
 	bool bShouldTraceForItems;
 
@@ -316,8 +454,8 @@ private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Items, meta = (AllowPrivateAccess = "true"))
 	class AItem* TraceHitItemLastFrame;
 
-	/** Currently equipped weapon */
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	/** Currently equipped weapon. The owner takes it from CombatAck */
+	UPROPERTY(ReplicatedUsing = OnRep_EquippedWeapon, VisibleAnywhere, BlueprintReadOnly, Category = Combat, meta = (AllowPrivateAccess = "true"))
 	AWeapon* EquippedWeapon;
 
 	/** Default weapon set in BP */
@@ -340,6 +478,16 @@ private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Items, meta = (AllowPrivateAccess = "true"))
 	TMap<EAmmoType, int32> AmmoMap;
 
+	/** Server state the owner's predictions are checked against */
+	UPROPERTY(ReplicatedUsing = OnRep_CombatAck)
+	FCombatAck CombatAck;
+
+	/** Sequence number of the owner's last combat input */
+	uint16 CombatInputSequence;
+
+	/** Owner inputs the server has not acknowledged yet, oldest first */
+	TArray<FPredictedCombatInput> PendingCombatInputs;
+
 	/** Starting amount of 9mm ammo */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Items, meta = (AllowPrivateAccess = "true"))
 	int32 Starting9mmAmmo;
@@ -352,8 +500,8 @@ private:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Items, meta = (AllowPrivateAccess = "true"))
 	int32 StartingSRAmmo;
 
-	/** Combat state can only fire or reload if unoccupied */
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	/** Combat state can only fire or reload if unoccupied. The owner runs its own copy from its input */
+	UPROPERTY(Replicated, VisibleAnywhere, BlueprintReadOnly, Category = Combat, meta = (AllowPrivateAccess = "true"))
 	ECombatState CombatState;
 
 	/** Montage for reloading the weapon */
@@ -428,7 +576,7 @@ private:
 	float EquipSoundResetTime;
 
 	/** Array of AItems for inventory */
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Inventory, meta = (AllowPrivateAccess = "true"))
+	UPROPERTY(ReplicatedUsing = OnRep_Inventory, VisibleAnywhere, BlueprintReadOnly, Category = Inventory, meta = (AllowPrivateAccess = "true"))
 	TArray<AItem*> Inventory;
 
 	const int32 INVENTORY_CAPACITY{ 6 };
@@ -446,7 +594,7 @@ private:
 	int32 HighlightedSlot;
 
 	/** Character health */
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	UPROPERTY(Replicated, EditAnywhere, BlueprintReadWrite, Category = Combat, meta = (AllowPrivateAccess = "true"))
 	float Health;
 
 	/** Character max health */
@@ -481,7 +629,7 @@ private:
 	UAnimMontage* DeathMontage;
 
 	/** True when character dies */
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Combat, meta = (AllowPrivateAccess = "true"))
+	UPROPERTY(ReplicatedUsing = OnRep_IsDead, VisibleAnywhere, BlueprintReadOnly, Category = Combat, meta = (AllowPrivateAccess = "true"))
 	bool bIsDead;
 
 public:
@@ -540,4 +688,14 @@ public:
 	void Stun();
 
 	FORCEINLINE float GetStunChance() const { return StunChance; }
+
+	FORCEINLINE bool GetIsDead() const { return bIsDead; }
+
+	/** Scripted input for load-test bots. Goes through the same code as the bound input */
+	void BotMove(float Forward, float Right);
+	void BotSetFireButton(bool bPressed);
+	void BotReload();
+
+	/** Picks the item up as if it were under the crosshair */
+	void BotPickUpItem(AItem* Item);
 };
@@ -0,0 +1,14 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace ShooterCosmetics
+{
+	/**
+	 * True on a dedicated server not started with -KeepCosmetics.
+	 * Cosmetic components are then never created, and effects, sounds and widgets are skipped where they are called.
+	 */
+	bool AreStripped();
+}
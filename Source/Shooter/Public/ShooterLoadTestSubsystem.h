@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShooterTickableWorldSubsystem.h"
+#include "ShooterLoadTestSubsystem.generated.h"
+
+class AShooterCharacter;
+
+/** What a load-test bot is doing until it picks its next goal */
+enum class ELoadTestBotGoal : uint8
+{
+	/** Walking to a random point */
+	Wander,
+
+	/** Shooting at an enemy or another player */
+	Fight,
+
+	/** Walking to an item to pick it up */
+	PickUp
+};
+
+/** Everything the server samples during a load test */
+struct FLoadTestSamples
+{
+	/** Whole frame, including the sleep that holds the server to its tick rate */
+	TArray<float> FrameMs;
+
+	/** Frame minus the sleep: the time the server actually worked */
+	TArray<float> WorkMs;
+
+	/** Client fire to server validation, for every shot rewound by lag compensation */
+	TArray<float> HitValidationMs;
+
+	/** Once per second */
+	TArray<int32> InBytesPerSecond;
+	TArray<int32> OutBytesPerSecond;
+	TArray<int32> Connections;
+};
+
+/**
+ * Drives a many-player load test on one machine; Scripts/LoadTest.sh starts the processes.
+ * On a client started with -LoadTestBot it plays the local character: it wanders, fights enemies and other players in
+ * bursts, reloads and picks up items, through the same input code a player uses.
+ * On a server started with -LoadTestReport=<File> it waits for -LoadTestClients=<N> players, samples the frame time,
+ * bandwidth and hit-validation latency for -LoadTestSeconds=<S>, writes the report and exits.
+ */
+UCLASS()
+class SHOOTER_API UShooterLoadTestSubsystem : public UShooterTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	void TickBot(float DeltaTime);
+
+	void ChooseBotGoal(AShooterCharacter* Character);
+
+	/** True while the goal actor is still worth walking to or shooting at */
+	bool IsBotGoalValid() const;
+
+	void TickServer();
+
+	void StartSampling();
+
+	void WriteReport();
+
+	/** The bot's decisions. Seeded from -LoadTestSeed, so a run can be repeated */
+	FRandomStream BotStream;
+
+	ELoadTestBotGoal BotGoal = ELoadTestBotGoal::Wander;
+	TWeakObjectPtr<AActor> BotGoalActor;
+	FVector BotWanderLocation = FVector::ZeroVector;
+	float BotStrafe = 0.f;
+	float NextBotGoalTime = 0.f;
+
+	/** Fire button held for a burst, then released for a pause */
+	bool bBotBurst = false;
+	float NextBotBurstTime = 0.f;
+
+	/** Server: where the report goes. Empty on bots */
+	FString ReportFile;
+
+	int32 ExpectedClients = 1;
+	float SampleSeconds = 120.f;
+
+	/** Sampling starts at this time even when not every client connected */
+	float WarmupEndTime = 0.f;
+
+	bool bSampling = false;
+	bool bReportWritten = false;
+	double SampleStartTime = 0.0;
+	double NextNetSampleTime = 0.0;
+
+	FLoadTestSamples Samples;
+};
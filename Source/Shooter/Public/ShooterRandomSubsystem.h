@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterRandomSubsystem.generated.h"
+
+/** Gameplay systems that draw random numbers. Each has its own stream, so a change in one does not shift the others */
+enum class EShooterRandomStream : uint8
+{
+	/** Whether hits stun enemies and enemy attacks stun players */
+	Stun,
+
+	/** Which attack an enemy plays */
+	EnemyAttack,
+
+	/** How long an enemy waits before it can react to a hit again */
+	HitReact,
+
+	/** Throw angle of dropped weapons */
+	WeaponThrow,
+
+	Num
+};
+
+/**
+ * Seeded random streams for gameplay, one per system.
+ * The seed comes from -ShooterSeed=<N>, or is 0 with the engine's -Deterministic. Otherwise a random seed is picked
+ * and logged, so any run can be repeated. Together with -ShooterFixedStep=<Hz>, which simulates every frame with the
+ * same delta time, two runs of the same scenario play out the same.
+ */
+UCLASS()
+class SHOOTER_API UShooterRandomSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	/** The world's stream for the system. Worlds without the subsystem, like editor previews, share an unseeded one */
+	static FRandomStream& GetStream(const UObject* WorldContextObject, EShooterRandomStream Stream);
+
+	/** Restarts every stream from Seed */
+	void Reseed(int32 InSeed);
+
+	FORCEINLINE int32 GetSeed() const { return Seed; }
+
+private:
+	int32 Seed = 0;
+
+	FRandomStream Streams[static_cast<int32>(EShooterRandomStream::Num)];
+};
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ReplicationGraph.h"
+#include "ShooterReplicationGraph.generated.h"
+
+class AItem;
+class UReplicationGraphNode_GridSpatialization2D;
+class UReplicationGraphNode_ActorList;
+class UReplicationGraphNode_AlwaysRelevant_ForConnection;
+
+/** Which node replicates an item, which follows its owner and state */
+enum class EItemReplicationRoute : uint8
+{
+	/** Nobody; an item of a listen server's own character */
+	None,
+
+	/** Lying in the world or moving to a character: the spatial grid, dormant while still */
+	World,
+
+	/** In a player's inventory: only that player's connection */
+	OwnerOnly,
+
+	/** Equipped: replicates together with the character holding it */
+	WithOwner
+};
+
+struct FItemReplicationRoute
+{
+	EItemReplicationRoute Route = EItemReplicationRoute::None;
+
+	TWeakObjectPtr<AActor> Owner;
+	TWeakObjectPtr<UNetConnection> Connection;
+
+	bool operator==(const FItemReplicationRoute& Other) const
+	{
+		return Route == Other.Route && Owner == Other.Owner && Connection == Other.Connection;
+	}
+};
+
+/** Replication cost sampled for one connection */
+struct FConnectionReplicationProfile
+{
+	int64 OutBytesPerSecond = 0;
+	int64 OutPacketsPerSecond = 0;
+	int32 Frames = 0;
+};
+
+/**
+ * Replication graph for servers with a lot of loot and large hordes.
+ * Characters, enemies and explosives are kept in a 2D spatial grid, so relevancy is gathered per cell instead of
+ * tested per actor. Pickups lying still are dormant in the grid and cost nothing until something changes them.
+ * Inventory items only go to their owner's connection, and the equipped weapon replicates with the character holding it.
+ */
+UCLASS(Transient)
+class SHOOTER_API UShooterReplicationGraph : public UReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	virtual void InitGlobalActorClassSettings() override;
+	virtual void InitGlobalGraphNodes() override;
+	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection) override;
+	virtual void RemoveClientConnection(UNetConnection* NetConnection) override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+	virtual int32 ServerReplicateActors(float DeltaSeconds) override;
+
+	/** Called on the server when an item's owner or state changed */
+	static void NotifyItemChanged(AItem* Item);
+
+	/** Called on the server after changing an actor's NetUpdateFrequency, which the graph otherwise reads only once */
+	static void NotifyUpdateFrequencyChanged(AActor* Actor);
+
+	/** Samples replication for Frames frames, then logs the cost per frame and per connection */
+	void StartProfiling(int32 Frames);
+
+private:
+	FItemReplicationRoute GetItemRoute(AItem* Item) const;
+
+	/** Moves the item to the node for its current owner and state */
+	void RouteItem(AItem* Item);
+
+	void AddItemToRoute(AItem* Item, const FItemReplicationRoute& Route);
+	void RemoveItemFromRoute(AItem* Item, const FItemReplicationRoute& Route);
+
+	void LogProfile();
+
+	UPROPERTY()
+	UReplicationGraphNode_GridSpatialization2D* GridNode;
+
+	UPROPERTY()
+	UReplicationGraphNode_ActorList* AlwaysRelevantNode;
+
+	/** Each connection's player controller, view target and inventory */
+	UPROPERTY()
+	TMap<UNetConnection*, UReplicationGraphNode_AlwaysRelevant_ForConnection*> OwnerNodes;
+
+	TMap<AActor*, FItemReplicationRoute> ItemRoutes;
+
+	int32 ProfileFramesLeft = 0;
+	int32 ProfileFrames = 0;
+	double ProfileMs = 0.0;
+	int64 ProfileReplicatedActors = 0;
+	int64 ProfileConnectionFrames = 0;
+	TMap<FString, FConnectionReplicationProfile> ProfileConnections;
+};
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShotBatch.generated.h"
+
+namespace ShotBatch
+{
+	/** Most shots sent in one batch; the owner sends early when it fills up */
+	constexpr int32 MaxShots{ 16 };
+
+	/** Largest gap between two shots of a batch, in TimeStep units */
+	constexpr int32 MaxTimeOffset{ MAX_uint8 };
+
+	/** Resolution of the time offsets in seconds */
+	constexpr float TimeStep{ 0.001f };
+
+	/** Yaw in 16 bits and pitch in 16 bits; about 0.005 degrees of error */
+	uint32 PackDirection(const FVector& Direction);
+	FVector UnpackDirection(uint32 PackedDirection);
+}
+
+/** One shot of a batch, already quantized so the client and the server use the same values */
+struct FBatchedShot
+{
+	/** Aim start, rounded to whole centimeters */
+	FVector Start;
+
+	/** Aim direction from ShotBatch::PackDirection */
+	uint32 Direction;
+
+	/** Time since the previous shot of the batch, in ShotBatch::TimeStep units */
+	uint8 TimeOffset;
+};
+
+/**
+ * Shots the owning client fired since its last send, packed for one unreliable RPC.
+ * Shots carry consecutive input sequence numbers from FirstSequence on, so the server can spot lost batches.
+ * Starts are sent as deltas from the previous shot and times as offsets from the previous shot.
+ */
+USTRUCT()
+struct FShotBatch
+{
+	GENERATED_BODY()
+
+	/** Input sequence number of the first shot */
+	uint16 FirstSequence = 0;
+
+	/** Server time the client saw when it fired the first shot */
+	float BaseTime = 0.f;
+
+	TArray<FBatchedShot, TInlineAllocator<ShotBatch::MaxShots>> Shots;
+
+	/** Adds a shot. False when the batch is full or the shot does not follow on; send the batch first */
+	bool Add(uint16 Sequence, const FVector& Start, const FVector& Direction, float Time);
+
+	void Reset();
+
+	FORCEINLINE bool IsEmpty() const { return Shots.Num() == 0; }
+
+	/** Server time of each shot, from BaseTime and the offsets */
+	void GetShotTimes(TArray<float, TInlineAllocator<ShotBatch::MaxShots>>& OutTimes) const;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FShotBatch> : public TStructOpsTypeTraitsBase2<FShotBatch>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
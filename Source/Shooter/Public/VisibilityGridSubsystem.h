@@ -0,0 +1,121 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "VisibilityGridSubsystem.generated.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/** What the baked grid knows about the line between two cells */
+enum class EGridVisibility : uint8
+{
+	/** Every sampled line between the cells is clear */
+	Visible,
+
+	/** Every sampled line between the cells is blocked by static geometry */
+	Occluded,
+
+	/** Partly visible, outside the grid, or not baked; needs an exact trace */
+	Unknown
+};
+
+/**
+ * Start of a baked visibility grid file. Followed, each part aligned to 8 bytes, by:
+ * int32 CellIndices[SizeX * SizeY], the compact index of each walkable cell or INDEX_NONE;
+ * uint64 Visible[NumCells * WordsPerRow], a bit per cell pair with at least one clear line;
+ * uint64 Blocked[NumCells * WordsPerRow], a bit per cell pair with at least one blocked line.
+ */
+struct FVisibilityGridHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	float CellSize;
+	float OriginX;
+	float OriginY;
+	int32 SizeX;
+	int32 SizeY;
+	int32 NumCells;
+	int32 WordsPerRow;
+	int32 Padding;
+};
+
+/**
+ * Coarse cell-to-cell visibility of a level, baked offline against static geometry.
+ * The file is mapped into memory as is; queries are two bit lookups and safe from any thread.
+ */
+class SHOOTER_API FVisibilityGrid
+{
+public:
+	~FVisibilityGrid();
+
+	/** Maps the file, or reads it when the platform cannot map files. @return false if missing or invalid */
+	bool Load(const FString& Path);
+
+	void Unload();
+
+	EGridVisibility GetVisibility(const FVector& From, const FVector& To) const;
+
+	FORCEINLINE bool IsLoaded() const { return Header != nullptr; }
+	FORCEINLINE int32 GetNumCells() const { return Header ? Header->NumCells : 0; }
+	FORCEINLINE int64 GetDataSize() const { return DataSize; }
+
+	/**
+	 * Bakes the grid over the navmesh of World with line traces between sample points of every pair of walkable cells.
+	 * Pairs farther apart than MaxDistance are left unknown. Game thread; slow, meant for offline use.
+	 */
+	static bool Bake(UWorld* World, float CellSize, int32 SamplesPerAxis, float EyeHeight, float MaxDistance, TArray<uint8>& OutData);
+
+	/** File of the grid baked for the map */
+	static FString GetGridPath(const FString& MapName);
+
+private:
+	/** Points Header and the arrays into the data. @return false if the data is not a valid grid */
+	bool SetData(const uint8* InData, int64 InDataSize);
+
+	int32 GetCellIndex(const FVector& Location) const;
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	/** The file contents when it could not be mapped */
+	TArray<uint8> FileData;
+
+	int64 DataSize{ 0 };
+
+	const FVisibilityGridHeader* Header{ nullptr };
+	const int32* CellIndices{ nullptr };
+	const uint64* VisibleBits{ nullptr };
+	const uint64* BlockedBits{ nullptr };
+};
+
+/**
+ * Loads the visibility grid baked for the current map, if there is one.
+ * Bake a grid with Shooter.Visibility.Bake while playing the map; it is written under Content/VisibilityGrids.
+ */
+UCLASS()
+class SHOOTER_API UVisibilityGridSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Reloads the grid of the current map, after a bake */
+	void LoadGrid();
+
+	/** Unmaps the grid so its file can be written */
+	void UnloadGrid();
+
+	/** The grid of the current map, or null if none was baked */
+	const FVisibilityGrid* GetGrid() const;
+
+	FString GetMapName() const;
+
+private:
+	FVisibilityGrid Grid;
+};
@@ -138,7 +138,7 @@ private:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Weapon properties", meta = (AllowPrivateAccess = "true"))
 	int32 MagazineCapacity;
 
-	/** Ammo count for this weapon */
+	/** Ammo count for this weapon. The character carrying it sends it to its owner */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Weapon properties", meta = (AllowPrivateAccess = "true"))
 	int32 Ammo;
 
@@ -234,6 +234,7 @@ public:
 
 	FORCEINLINE int32 GetMagazineCapacity() const { return MagazineCapacity; }
 	FORCEINLINE int32 GetAmmo() const { return Ammo; }
+	FORCEINLINE void SetAmmo(int32 Count) { Ammo = Count; }
 
 	/** Called from Character class when firing weapon */
 	void DecrementAmmo();
@@ -3,4 +3,6 @@
 #include "Shooter.h"
 #include "Modules/ModuleManager.h"
 
+DEFINE_LOG_CATEGORY(LogShooter);
+
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, Shooter, "Shooter" );
@@ -3,9 +3,14 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
 
 #define EPS_Metal EPhysicalSurface::SurfaceType1
 #define EPS_Stone EPhysicalSurface::SurfaceType2
 #define EPS_Tile EPhysicalSurface::SurfaceType3
 #define EPS_Grass EPhysicalSurface::SurfaceType4
-#define EPS_Water EPhysicalSurface::SurfaceType5
\ No newline at end of file
+#define EPS_Water EPhysicalSurface::SurfaceType5
+
+DECLARE_LOG_CATEGORY_EXTERN(LogShooter, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("Shooter"), STATGROUP_Shooter, STATCAT_Advanced);